@@ -59,6 +59,17 @@ public:
 
 public:
   virtual InstVector getTids();
+
+  // Return the direction the analysis has been performed along.
+  unsigned int getDirection() const;
+
+private:
+  // Select the direction according to the transformation that is going to
+  // consume the analysis.
+  unsigned int selectDirection(const Function *function) const;
+
+private:
+  unsigned int direction;
 };
 
 class MultiDimDivAnalysis : public FunctionPass, public DivergenceAnalysis {
@@ -2,6 +2,7 @@
 #define FEATURE_COLLECTOR_H
 
 #include "thrud/DivergenceAnalysis/DivergenceAnalysis.h"
+#include "thrud/Support/FeatureTable.h"
 #include "thrud/Support/NDRange.h"
 #include "thrud/Support/OCLEnv.h"
 
@@ -31,6 +32,29 @@ public:
 public:
   void dump();
 
+  // Batch extraction: -count-all-kernels analyzes every kernel, instead of
+  // the one named by kernelName. With -feature-table or -feature-columns
+  // the features are added to table as a row, instead of being dumped.
+  static bool isAnalyzed(const Function &function,
+                         const std::string &kernelName);
+  void output(const Function &function, FeatureTable &table);
+  static void writeTable(const FeatureTable &table);
+  // Module column of the rows of function: -feature-module if given, the
+  // module identifier otherwise.
+  static std::string getModuleName(const Function &function);
+
+  // Fixed set of features, the same for every kernel: the counters and the
+  // mean and maximum of the per block features.
+  static std::vector<std::string> getFeatureNames();
+  std::vector<float> getFeatureValues();
+
+  // Collect the features of the whole kernel, the ones -opencl-instcount
+  // extracts.
+  void collect(Function &function, DominatorTree *dt, PostDominatorTree *pdt,
+               MultiDimDivAnalysis *mdda, SingleDimDivAnalysis *sdda,
+               LoopInfo *loopInfo, ScalarEvolution *scalarEvolution,
+               NDRange *ndr);
+
 public:
   std::map<std::string, int> instTypes;
 
@@ -58,6 +82,10 @@ public:
   std::vector<int> blockInsts;
   void countInstsBlock(const BasicBlock &block);
 
+  // Number of instructions for each opcode, as the instruction visitor of
+  // opencl-instcount counts them.
+  void countOpcodes(const BasicBlock &block);
+
   // Function calls.
   void countBarriers(const BasicBlock &block);
   void countMathFunctions(const BasicBlock &block);
@@ -66,6 +94,33 @@ public:
   std::vector<int> aliveOutBlocks;
   std::vector<float> avgLiveRange;
   void livenessAnalysis(BasicBlock &block);
+
+  // Register pressure from the liveness of the SSA values. Only the blocks in
+  // loops are considered if loopInfo is given.
+  // Values live in and out of each block, in total and for each register
+  // class (liveInScalarInt, liveOutVectorFloat, ...). The kernel maxima go
+  // to maxLive, maxLiveRegisters and maxLive<class>.
+  std::vector<int> blockLiveIn;
+  std::vector<int> blockLiveOut;
+  std::map<std::string, std::vector<int> > classLiveness;
+  void computeRegisterPressure(Function &function, LoopInfo *loopInfo);
+
+  // Dynamic counts.
+  // Trip count of each loop, evaluated by scalar evolution on the first warp
+  // of the NDRange, with the kernel arguments bound by -kernel-args. Inner
+  // loops are evaluated halfway through the iterations of the outer ones.
+  std::map<const Loop *, float> tripCounts;
+  void computeTripCounts(Function &function, LoopInfo *loopInfo,
+                         ScalarEvolution *scalarEvolution, NDRange *ndr);
+  // The block counters (opcodes, type mix, local accesses, math functions
+  // and barriers) of the whole kernel, each block weighted with its
+  // estimated execution frequency: the product of the trip counts of its
+  // loops. Keys are prefixed with "dynamic" (dynamicInsts, dynamicFMul,
+  // dynamicF32Insts, ...). With loopsOnly the blocks outside loops are
+  // skipped.
+  std::map<std::string, float> dynamicInstTypes;
+  void countDynamicInsts(Function &function, LoopInfo *loopInfo,
+                         bool loopsOnly);
 //  void coalescingAnalysis(BasicBlock &block, ScalarEvolution *SE, OCLEnv *OCL,
 //                          int CoarseningDirection);
 
@@ -75,12 +130,30 @@ public:
   // Map block with phi.
   std::map<std::string, std::vector<std::string> > blockPhis;
   void countPhis(const BasicBlock &block);
-  // Average of arguments for a phi-node.
+  // Arguments of the phi-nodes of each block.
+  std::vector<int> countPhiArgs();
 
   // Constants.
   void countConstants(const BasicBlock &block);
   // Local memory usage.
   void countLocalMemoryUsage(const BasicBlock &block);
+  // Bytes of __local variables allocated by a work-group (localMemoryBytes).
+  void countLocalMemorySize(const Function &function);
+  // Type mix: number of instructions computing on each scalar type
+  // (i8Insts, i16Insts, ..., f64Insts).
+  void countTypeMix(const BasicBlock &block);
+  void countTypeMix(const Instruction &inst);
+  // Histogram of the instructions by opcode and full type: FMul.v4f32,
+  // Add.i32, memory accesses by address space (Load.global.f32) and math
+  // builtins by name (Call.sqrt.f32). The fixed counters get the
+  // instructions on vectors (vector2, ..., vector16), the global memory
+  // accesses and computeCycles, the issue cost of the block on the device
+  // profile (see DeviceProfile::getIssueCost).
+  std::map<std::string, int> typedInsts;
+  void countTypedInsts(const BasicBlock &block);
+  // Issue cost of the blocks counted so far, rounded into computeCycles only
+  // at the end of collect.
+  float computeCycles;
 
   // Function counters.
   //void countDimensions(NDRange *NDR);
@@ -90,6 +163,22 @@ public:
                      SingleDimDivAnalysis *sdda);
   void countArgs(const Function &function);
 
+  // Structure of the CFG and of the divergent regions: how much code
+  // coarsening replicates. The kernel counters are maxLoopDepth,
+  // maxDivNesting and outermostDivRegions; for each region, its
+  // instructions, its nesting among the divergent regions (1 for an
+  // outermost one), its loop depth, the acyclic paths from its header to its
+  // exiting block and the values alive out of it. Only the regions in loops
+  // are considered if loopsOnly is set.
+  std::vector<int> regionSizes;
+  std::vector<int> regionNesting;
+  std::vector<int> regionLoopDepths;
+  std::vector<float> regionPaths;
+  std::vector<int> regionAlive;
+  void countDivRegionStructure(const Function &function,
+                               MultiDimDivAnalysis *mdda, LoopInfo *loopInfo,
+                               bool loopsOnly);
+
   // Loop Function counters.
   void loopCountEdges(const Function &function, LoopInfo *LI);
   void loopCountBranches(const Function &function, LoopInfo *LI);
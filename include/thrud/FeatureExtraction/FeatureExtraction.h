@@ -3,7 +3,6 @@
 #include "FeatureCollector.h"
 
 #include "llvm/Pass.h"
-#include "llvm/InstVisitor.h"
 
 #include "llvm/Analysis/Passes.h"
 #include "llvm/Analysis/PostDominators.h"
@@ -22,24 +21,15 @@ class MultiDimDivAnalysis;
 
 /// Collect information about the kernel function.
 namespace {
-class OpenCLFeatureExtractor : public FunctionPass,
-                               public InstVisitor<OpenCLFeatureExtractor> {
-
-  friend class InstVisitor<OpenCLFeatureExtractor>;
-
-  // Visitor methods.
-  void visitBasicBlock(BasicBlock &block);
-  void visitFunction(Function &function);
-  void visitInstruction(Instruction &inst);
-#define HANDLE_INST(N, OPCODE, CLASS) void visit##OPCODE(CLASS &);
-#include "llvm/IR/Instruction.def"
-
+class OpenCLFeatureExtractor : public FunctionPass {
   // Function pass methods.
 public:
   static char ID; // Pass identification, replacement for typeid
-  OpenCLFeatureExtractor() : FunctionPass(ID) {}
+  OpenCLFeatureExtractor()
+      : FunctionPass(ID), table(FeatureCollector::getFeatureNames()) {}
 
   virtual bool runOnFunction(Function &F);
+  virtual bool doFinalization(Module &module);
   virtual void getAnalysisUsage(AnalysisUsage &AU) const;
   virtual void print(raw_ostream &out, const Module *module) const {}
 
@@ -47,9 +37,12 @@ private:
   MultiDimDivAnalysis *mdda;
   SingleDimDivAnalysis *sdda;
   FeatureCollector collector;
+  FeatureTable table;
   PostDominatorTree *pdt;
   DominatorTree *dt;
   ScalarEvolution *se;
+  LoopInfo *li;
+  NDRange *ndr;
   ValueVector TIds;
 };
 }
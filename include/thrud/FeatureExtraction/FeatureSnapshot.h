@@ -0,0 +1,52 @@
+#ifndef FEATURE_SNAPSHOT_H
+#define FEATURE_SNAPSHOT_H
+
+#include "thrud/Support/FeatureTable.h"
+
+#include "llvm/Pass.h"
+
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace llvm {
+class Function;
+}
+
+/// Features of a kernel before and after a transformation, in a single opt
+/// run. The pass is placed twice in the pipeline, around the transformation:
+///
+///   opt -feature-snapshot -be -tc -coarsening-factor 2 -feature-snapshot
+///
+/// The first run on a kernel records its features, the second one emits the
+/// recorded features, the current ones and their difference, either as YAML
+/// or, with -feature-table and -feature-columns, as three table rows whose
+/// configuration ends with "before", "after" and "delta".
+class FeatureSnapshot : public FunctionPass {
+public:
+  static char ID;
+  FeatureSnapshot();
+
+  virtual bool runOnFunction(Function &function);
+  virtual bool doFinalization(Module &module);
+  virtual void getAnalysisUsage(AnalysisUsage &au) const;
+
+public:
+  struct Delta {
+    std::string kernel;
+    std::string configuration;
+    std::vector<std::string> names;
+    std::vector<float> before;
+    std::vector<float> after;
+    std::vector<float> delta;
+  };
+
+private:
+  void output(const Function &function, Delta &delta);
+
+private:
+  FeatureTable table;
+};
+
+#endif
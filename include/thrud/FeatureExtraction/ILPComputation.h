@@ -5,6 +5,8 @@ namespace llvm { class BasicBlock; }
 
 using namespace llvm;
 
+// Instructions (or their latency with -ilp-latency) over the length of the
+// critical path of the dependencies within the block.
 float getILP(BasicBlock *block);
 
 #endif
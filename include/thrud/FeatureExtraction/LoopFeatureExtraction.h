@@ -42,9 +42,11 @@ class OpenCLLoopFeatureExtractor
   // Function pass methods.
 public:
   static char ID; // Pass identification, replacement for typeid
-  OpenCLLoopFeatureExtractor() : FunctionPass(ID) {}
+  OpenCLLoopFeatureExtractor()
+      : FunctionPass(ID), table(FeatureCollector::getFeatureNames()) {}
 
   virtual bool runOnFunction(Function &F);
+  virtual bool doFinalization(Module &module);
   virtual void getAnalysisUsage(AnalysisUsage &AU) const;
   virtual void print(raw_ostream &out, const Module *module) const {}
 
@@ -52,10 +54,12 @@ private:
   MultiDimDivAnalysis *MDDA;
   SingleDimDivAnalysis *SDDA;
   FeatureCollector collector;
+  FeatureTable table;
   PostDominatorTree *PDT;
   DominatorTree *DT;
   LoopInfo *LI;
   ScalarEvolution *SE;
+  NDRange *NDR;
   ValueVector TIds;
 };
 }
@@ -0,0 +1,77 @@
+#ifndef OCCUPANCY_ANALYSIS_H
+#define OCCUPANCY_ANALYSIS_H
+
+#include "llvm/Pass.h"
+
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace llvm {
+class Function;
+}
+
+class SingleDimDivAnalysis;
+
+/// Occupancy of a compute unit for a kernel on the device profile, before and
+/// after coarsening.
+/// A work-group is resident on a compute unit if its warps, its registers
+/// and its local memory fit next to the ones of the other resident groups.
+/// Registers per work-item come from the register pressure of the kernel:
+/// coarsening by a factor replicates the divergent values factor times and
+/// divides the local size in the coarsening direction by the factor.
+/// The occupancy is the ratio between the resident warps and the maximum
+/// the compute unit can hold. A factor is acceptable if the occupancy stays
+/// above the latency hiding threshold (-occupancy-threshold) and the
+/// registers of a work-item do not spill.
+class OccupancyAnalysis : public FunctionPass {
+public:
+  static char ID;
+  OccupancyAnalysis();
+
+  virtual bool runOnFunction(Function &function);
+  virtual void getAnalysisUsage(AnalysisUsage &au) const;
+
+public:
+  struct Configuration {
+    unsigned int factor;
+    unsigned int groupSize;
+    unsigned int warpsPerGroup;
+    unsigned int registers;
+    unsigned int residentGroups;
+    unsigned int residentWarps;
+    float occupancy;
+    // Resource limiting the resident groups: "warps", "groups",
+    // "registers", "local-memory" or "none".
+    std::string limiter;
+    bool spills;
+    bool acceptable;
+  };
+
+public:
+  // Configuration of the given coarsening factor, NULL if it was not
+  // analyzed.
+  const Configuration *getConfiguration(unsigned int factor) const;
+  // Largest analyzed factor that is acceptable, 1 if there is none.
+  unsigned int getMaxAcceptableFactor() const;
+
+public:
+  std::string kernel;
+  std::string deviceName;
+  unsigned int direction;
+  unsigned int localBytes;
+  // __local pointer arguments without a size in -kernel-args: localBytes
+  // leaves them out and is only a lower bound.
+  unsigned int unboundLocalArgs;
+  std::vector<Configuration> configurations;
+
+private:
+  Configuration analyzeFactor(Function &function, unsigned int factor);
+  void dump();
+
+private:
+  SingleDimDivAnalysis *sdda;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef PERFORMANCE_PREDICTION_H
+#define PERFORMANCE_PREDICTION_H
+
+#include "thrud/FeatureExtraction/SymbolicExecution.h"
+
+#include "llvm/Pass.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+
+#include <map>
+#include <string>
+
+using namespace llvm;
+
+namespace llvm {
+class BasicBlock;
+class Function;
+}
+
+/// Static runtime estimate of a kernel on the device profile.
+/// The kernel is placed on a roofline: the operations executed by the
+/// work items, from the issue cost of the instructions weighted with the
+/// trip counts of the loops, are bound by the compute throughput of the
+/// device; the global memory transactions and the local memory wavefronts
+/// (bank conflicts included) of the symbolic execution are bound by the
+/// bandwidths.
+/// The runtime is the largest of the three times.
+/// The trip counts are the ones of the dynamic features of
+/// FeatureCollector.
+class PerformancePrediction : public FunctionPass {
+public:
+  static char ID;
+  PerformancePrediction();
+
+  virtual bool runOnFunction(Function &function);
+  virtual void getAnalysisUsage(AnalysisUsage &au) const;
+
+public:
+  // Estimated runtime in seconds and its bound: "compute", "memory" or
+  // "local-memory".
+  float getRuntime() const;
+  const std::string &getBound() const;
+  bool isMemoryBound() const;
+
+public:
+  std::string kernel;
+  std::string deviceName;
+  std::string kernelArguments;
+
+  // Launch size.
+  double workItems;
+  double warps;
+
+  // Instructions executed by a work item, and their issue cost on the
+  // device: vectors, doubles and divisions take more than a simple
+  // operation.
+  float aluOps;
+  float mathCalls;
+  float barriers;
+  float branches;
+  float ops;
+
+  // Traffic of the whole NDRange in bytes.
+  double globalBytes;
+  double localBytes;
+  // Accesses the symbolic execution could not analyze are charged a
+  // transaction per lane, or a conflict with every other lane. The ones in
+  // loops with an unknown trip count are left out of the traffic and counted
+  // here.
+  int unknownAccesses;
+  float arithmeticIntensity;
+
+  // Times in seconds.
+  float computeTime;
+  float memoryTime;
+  float localMemoryTime;
+  float runtime;
+  std::string bound;
+
+private:
+  void countWarps();
+  void countOps(Function &function);
+  void countGlobalBytes();
+  void countLocalBytes();
+  float getBlockWeight(const BasicBlock *block);
+  void predict();
+  void dump();
+
+private:
+  LoopInfo *loopInfo;
+  std::map<const Loop *, float> tripCounts;
+  SymbolicExecution execution;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef REGISTER_PRESSURE_H
+#define REGISTER_PRESSURE_H
+
+#include "llvm/ADT/BitVector.h"
+
+#include <map>
+#include <vector>
+
+namespace llvm {
+class BasicBlock;
+class Function;
+class Instruction;
+class Type;
+class Value;
+}
+
+class DivergenceAnalysis;
+
+using namespace llvm;
+
+/// Register pressure of a function from the liveness of its SSA values.
+/// Liveness is a backward dataflow over the CFG: a value is live out of a
+/// block if it is live into a successor or it is an incoming value of a phi
+/// of a successor for the edge. The values live at each point of a block are
+/// then found walking the block backwards from its live out set.
+/// Counts are split by register class. Register counts assume 32 bit
+/// registers: wider values and vectors take more than one.
+/// Given a divergence analysis and a coarsening factor, the registers are
+/// the ones of the coarsened work-item: divergent values are replicated
+/// factor times, uniform ones are not.
+class RegisterPressure {
+public:
+  enum RegisterClass {
+    ScalarInt,
+    ScalarFloat,
+    VectorInt,
+    VectorFloat,
+    RegisterClassNumber
+  };
+
+public:
+  RegisterPressure(Function &function);
+  RegisterPressure(Function &function, DivergenceAnalysis *divergence,
+                   unsigned int coarseningFactor);
+
+public:
+  // Values live at the entry and at the exit of block, for each class.
+  std::vector<int> getLiveIn(const BasicBlock *block) const;
+  std::vector<int> getLiveOut(const BasicBlock *block) const;
+  // Largest number of values live at the same time in block, for each class
+  // and in total, and the registers they take.
+  std::vector<int> getMaxLive(const BasicBlock *block) const;
+  int getMaxLiveValues(const BasicBlock *block) const;
+  int getMaxLiveRegisters(const BasicBlock *block) const;
+  // Largest number of registers live at the same time in the function.
+  int getMaxLiveRegisters() const;
+
+  static const char *getClassName(RegisterClass registerClass);
+  // Class of the values of type, -1 if they are not kept in registers.
+  static int getClass(const Type *type);
+
+private:
+  struct BlockLiveness {
+    BitVector liveIn;
+    BitVector liveOut;
+    std::vector<int> maxLive;
+    int maxLiveValues;
+    int maxLiveRegisters;
+  };
+
+private:
+  void analyze(Function &function, DivergenceAnalysis *divergence,
+               unsigned int coarseningFactor);
+  void numberValues(Function &function, DivergenceAnalysis *divergence,
+                    unsigned int coarseningFactor);
+  int getIndex(const Value *value) const;
+  void computeLiveSets(Function &function);
+  void addPhiUses(const BasicBlock *block, const BasicBlock *successor,
+                  BitVector &live) const;
+  void computeMaxLive(const BasicBlock *block, BlockLiveness &liveness) const;
+  void addLive(const BitVector &live, std::vector<int> &classes,
+               int &values, int &registers) const;
+  std::vector<int> countClasses(const BitVector &live) const;
+
+private:
+  std::map<const Value *, int> indices;
+  std::vector<int> classes;
+  std::vector<int> registers;
+  std::map<const BasicBlock *, BlockLiveness> blocks;
+};
+
+#endif
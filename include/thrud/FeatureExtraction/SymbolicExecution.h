@@ -2,7 +2,6 @@
 #define SYMBOLIC_EXECUTION_H
 
 #include "llvm/Pass.h"
-#include "llvm/InstVisitor.h"
 
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/Passes.h"
@@ -14,6 +13,13 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include "thrud/Support/NDRangeSpace.h"
+#include "thrud/Support/OCLEnv.h"
+#include "thrud/Support/SCEVProgram.h"
+#include "thrud/Support/Warp.h"
+
+#include <map>
+#include <string>
+#include <vector>
 
 using namespace llvm;
 
@@ -25,16 +31,50 @@ class LoadInst;
 
 class MultiDimDivAnalysis;
 class NDRange;
-class OCLEnv;
 class SubscriptAnalysis;
 
-/// Collect information about the kernel function.
-namespace {
-class SymbolicExecution : public FunctionPass,
-                          public InstVisitor<SymbolicExecution> {
+/// Distribution of the result of a memory access over the sampled warps.
+/// Warps where the access could not be analyzed (negative results) are
+/// only counted in unknown; min, mean and max are -1 if all of them are.
+struct AccessStats {
+  int min;
+  float mean;
+  int max;
+  int unknown;
+  // Number of warps for each result value: histogram[value].
+  std::vector<int> histogram;
+  // For unbounded results, such as iteration counts, number of warps for each
+  // power of two instead: log2Histogram[0] counts 0, log2Histogram[k] counts
+  // the values in [2^(k-1), 2^k).
+  std::vector<int> log2Histogram;
+};
 
-  friend class InstVisitor<SymbolicExecution>;
+// Compute the distribution of the given samples.
+AccessStats aggregate(const std::vector<int> &samples, bool unbounded);
+
+/// Results of the memory accesses of a warp, in program order.
+struct WarpResults {
+  std::vector<int> loadTransactions;
+  std::vector<int> storeTransactions;
+  std::vector<int> loopLoadTransactions;
+  std::vector<int> loopStoreTransactions;
+  std::vector<int> loadBankConflicts;
+  std::vector<int> storeBankConflicts;
+  std::vector<int> loopLoadBankConflicts;
+  std::vector<int> loopStoreBankConflicts;
+  std::vector<int> loopLoadIterations;
+  std::vector<int> loopStoreIterations;
+  std::vector<int> loopLocalLoadIterations;
+  std::vector<int> loopLocalStoreIterations;
+  std::vector<int> loopLoadTotalTransactions;
+  std::vector<int> loopStoreTotalTransactions;
+};
 
+/// Collect information about the kernel function.
+/// The sampled warps are evaluated in parallel (-symbolic-threads): the
+/// address programs are compiled up front and each thread evaluates its
+/// warps on its own copy of the subscript analysis.
+class SymbolicExecution : public FunctionPass {
 public:
   static char ID;
   SymbolicExecution();
@@ -44,6 +84,19 @@ public:
   virtual void getAnalysisUsage(AnalysisUsage &AU) const;
 
 public:
+  // Analyze function for the given argument values, without dumping the
+  // results. Other passes use this to get the memory behavior of a kernel.
+  void analyze(Function &function, LoopInfo *loopInfo,
+               ScalarEvolution *scalarEvolution, NDRange *ndr,
+               const OCLEnv::ArgumentSet &arguments);
+  const NDRangeSpace &getNDRangeSpace() const;
+
+public:
+  std::string kernel;
+  // Values of the integer arguments the results refer to.
+  std::string kernelArguments;
+
+  // Results for each access, averaged over the sampled warps.
   std::vector<int> loadTransactions;
   std::vector<int> storeTransactions;
 
@@ -56,16 +109,90 @@ public:
   std::vector<int> loopLoadBankConflicts;
   std::vector<int> loopStoreBankConflicts;
 
+  // Accesses in loops: the per-iteration results above are averaged over the
+  // iterations. These are the iterations executed by the warp and the
+  // transactions summed over them.
+  std::vector<int> loopLoadIterations;
+  std::vector<int> loopStoreIterations;
+  std::vector<int> loopLoadTotalTransactions;
+  std::vector<int> loopStoreTotalTransactions;
+  // Iterations executed by the warp for the local memory accesses in loops.
+  std::vector<int> loopLocalLoadIterations;
+  std::vector<int> loopLocalStoreIterations;
+
+  // Distribution of the results for each access.
+  int sampledWarps;
+  std::vector<AccessStats> loadTransactionStats;
+  std::vector<AccessStats> storeTransactionStats;
+  std::vector<AccessStats> loopLoadTransactionStats;
+  std::vector<AccessStats> loopStoreTransactionStats;
+  std::vector<AccessStats> loadBankConflictStats;
+  std::vector<AccessStats> storeBankConflictStats;
+  std::vector<AccessStats> loopLoadBankConflictStats;
+  std::vector<AccessStats> loopStoreBankConflictStats;
+  std::vector<AccessStats> loopLoadIterationStats;
+  std::vector<AccessStats> loopStoreIterationStats;
+  std::vector<AccessStats> loopLocalLoadIterationStats;
+  std::vector<AccessStats> loopLocalStoreIterationStats;
+  std::vector<AccessStats> loopLoadTotalTransactionStats;
+  std::vector<AccessStats> loopStoreTotalTransactionStats;
+
+  // Cache simulation (-symbolic-cache) of the global memory accesses, in
+  // program order. DRAM bytes are scaled from the sampled warps to the whole
+  // NDRange.
+  bool cacheSimulated;
+  float l1HitRate;
+  float l2HitRate;
+  uint64_t dramBytes;
+  std::vector<float> accessL1HitRates;
+  std::vector<float> accessL2HitRates;
+  std::vector<uint64_t> accessDramBytes;
+
 private:
+  // For each access, the results on each of the sampled warps.
+  typedef std::vector<std::vector<int> > SampleMatrix;
+
+private:
+  std::vector<Warp> sampleWarps();
+  void analyzeWarps(Function &function, const std::vector<Warp> &warps);
+  void collectSamples(const WarpResults &results);
+  void collectSamples(const std::vector<int> &results, SampleMatrix &samples);
+  void aggregateSamples(const SampleMatrix &samples, std::vector<int> &means,
+                        std::vector<AccessStats> &stats, bool unbounded);
+
+  // A request of a warp to memory.
+  struct MemoryRequest {
+    int access;
+    bool isStore;
+    int unknownNumber;
+    double weight;
+    std::vector<uint64_t> addresses;
+    // Index in the warp of the work item of each address and of the work
+    // items whose address is unknown.
+    std::vector<int> workItems;
+    std::vector<int> unknownWorkItems;
+  };
+  typedef std::vector<MemoryRequest> MemoryTrace;
+
+  void simulateCaches(Function &function, const std::vector<Warp> &warps);
+  void traceBlocks(Function &function, const Loop *loop, double weight,
+                   const std::vector<char> &active,
+                   SCEVProgram::IterationMap &iterations, MemoryTrace &trace);
+  void traceLoop(Function &function, const Loop *loop, double weight,
+                 const std::vector<char> &active,
+                 SCEVProgram::IterationMap &iterations, MemoryTrace &trace);
+  void traceAccess(Instruction *inst, double weight,
+                   const std::vector<char> &active,
+                   const SCEVProgram::IterationMap &iterations,
+                   MemoryTrace &trace);
+  uint64_t getBaseAddress(Value *base);
+  void exportTrace(Function &function, const std::string &fileName);
+
   void memoryAccessAnalysis(BasicBlock &block, std::vector<int> &loadTrans,
                             std::vector<int> &storeTrans);
   void init();
   void initBuffers();
   void initOCLSpace();
-  void visitLoadInst(LoadInst &loadInst);
-  void visitStoreInst(StoreInst &storeInst);
-  void visitMemoryInst(Value *pointer, std::vector<int> &resultVector);
-  void visitLocalMemoryInst(Value *pointer, std::vector<int> &resultVector);
   void dump();
 
 private:
@@ -75,7 +202,32 @@ private:
   NDRange *ndr;
   LoopInfo *loopInfo;
   NDRangeSpace ndrSpace;
+
+  // Tracing state for the cache simulation and the trace export: the
+  // accesses traced with their ids, the iterations of each loop traced (0 for
+  // all of them) and the addresses given to the buffers.
+  std::map<Instruction *, int> traceAccesses;
+  unsigned int tracedIterations;
+  std::map<Value *, uint64_t> baseAddresses;
+
+  SampleMatrix loadTransactionSamples;
+  SampleMatrix storeTransactionSamples;
+  SampleMatrix loopLoadTransactionSamples;
+  SampleMatrix loopStoreTransactionSamples;
+  SampleMatrix loadBankConflictSamples;
+  SampleMatrix storeBankConflictSamples;
+  SampleMatrix loopLoadBankConflictSamples;
+  SampleMatrix loopStoreBankConflictSamples;
+  SampleMatrix loopLoadIterationSamples;
+  SampleMatrix loopStoreIterationSamples;
+  SampleMatrix loopLocalLoadIterationSamples;
+  SampleMatrix loopLocalStoreIterationSamples;
+  SampleMatrix loopLoadTotalTransactionSamples;
+  SampleMatrix loopStoreTotalTransactionSamples;
 };
-}
+
+// The NDRange space given on the command line with -localSizeX, ...,
+// -numberOfGroupsZ.
+NDRangeSpace getCommandLineNDRangeSpace();
 
 #endif
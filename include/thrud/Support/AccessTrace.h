@@ -0,0 +1,102 @@
+#ifndef ACCESS_TRACE_H
+#define ACCESS_TRACE_H
+
+#include "llvm/Support/DataTypes.h"
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_fd_ostream;
+}
+
+// Binary trace of the memory accesses of the evaluated work items.
+// The file is a header followed by fixed size records in the byte order of
+// the host, so that it can be mapped in memory and indexed directly.
+// The accesses, the buffers and the NDRange the records refer to are
+// described by a YAML index written next to the trace.
+
+struct AccessTraceHeader {
+  // "THRUDTRC".
+  char magic[8];
+  uint32_t version;
+  uint32_t recordSize;
+  uint64_t recordNumber;
+};
+
+// A memory access of a work item.
+struct AccessRecord {
+  enum Flags {
+    // The address could not be computed, address is 0.
+    UnknownAddress = 1
+  };
+
+  // Id of the access in the index.
+  uint32_t access;
+  int32_t globalId[3];
+  // Byte address: the offset from the base of the buffer (see the index)
+  // plus the base.
+  uint64_t address;
+  uint32_t size;
+  uint8_t isStore;
+  uint8_t addressSpace;
+  uint16_t flags;
+};
+
+// Description of an access in the index.
+struct TraceAccess {
+  int id;
+  std::string instruction;
+  std::string block;
+  bool isStore;
+  unsigned int addressSpace;
+  unsigned int size;
+  unsigned int loopDepth;
+};
+
+// Buffers are given disjoint address ranges.
+struct TraceBuffer {
+  std::string name;
+  uint64_t base;
+};
+
+struct AccessTraceIndex {
+  std::string trace;
+  std::string kernel;
+  std::string kernelArguments;
+  unsigned int recordSize;
+  uint64_t recordNumber;
+  std::vector<int> localSize;
+  std::vector<int> numberOfGroups;
+  // Iterations of each loop traced, 0 if all of them are.
+  unsigned int loopIterations;
+  std::vector<TraceAccess> accesses;
+  std::vector<TraceBuffer> buffers;
+};
+
+class AccessTraceWriter {
+public:
+  AccessTraceWriter();
+  ~AccessTraceWriter();
+
+public:
+  // Return false and set error if the file cannot be created.
+  bool open(const std::string &fileName, std::string &error);
+  void write(const AccessRecord &record);
+  // Write the number of records in the header and close the file.
+  void close();
+  uint64_t getRecordNumber() const;
+
+public:
+  static bool writeIndex(const std::string &fileName,
+                         AccessTraceIndex &index, std::string &error);
+
+private:
+  void writeHeader();
+
+private:
+  llvm::raw_fd_ostream *stream;
+  uint64_t recordNumber;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef CACHE_SIMULATOR_H
+#define CACHE_SIMULATOR_H
+
+#include "llvm/Support/DataTypes.h"
+
+#include <vector>
+
+// Set-associative cache with LRU replacement.
+class Cache {
+public:
+  Cache(unsigned int size, unsigned int lineSize, unsigned int ways);
+
+public:
+  // Access the line containing address. Return true on a hit. On a miss the
+  // line is inserted only if allocate is set.
+  bool access(uint64_t address, bool allocate);
+  unsigned int getLineSize() const;
+
+private:
+  unsigned int lineSize;
+  unsigned int ways;
+  // For each set, the lines it holds from the most to the least recently
+  // used.
+  std::vector<std::vector<uint64_t> > sets;
+};
+
+// Hits, misses and DRAM traffic of a memory access.
+struct CacheStats {
+  double l1Accesses;
+  double l1Hits;
+  double l2Accesses;
+  double l2Hits;
+  double dramBytes;
+
+  CacheStats();
+  float getL1HitRate() const;
+  float getL2HitRate() const;
+};
+
+// Two-level cache hierarchy fed with the requests of the warps.
+// Loads go through L1 and L2. Stores are write-through and do not allocate
+// in L1: they go straight to L2, which allocates on writes.
+// Write backs to DRAM are not modeled.
+class CacheSimulator {
+public:
+  CacheSimulator(const Cache &l1, const Cache &l2, int accessNumber);
+
+public:
+  // Simulate the request of a warp for an access.
+  // addresses: the addresses accessed by the work items of the warp.
+  // unknownNumber: work items whose address is not known, each one is
+  // counted as a miss in both levels.
+  // weight: number of requests the simulated one stands for.
+  void access(int accessIndex, bool isStore,
+              const std::vector<uint64_t> &addresses, int unknownNumber,
+              double weight);
+
+  const CacheStats &getStats(int accessIndex) const;
+  CacheStats getTotalStats() const;
+
+private:
+  void accessL2(uint64_t address, double weight, CacheStats &stats);
+
+private:
+  Cache l1;
+  Cache l2;
+  std::vector<CacheStats> stats;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef COARSENING_MODEL_H
+#define COARSENING_MODEL_H
+
+#include <string>
+#include <vector>
+
+// A trained model mapping the features of a kernel to its best coarsening
+// configuration. The model is a classifier over a list of configurations:
+// a decision tree, a forest of trees voting by majority, or a multilayer
+// perceptron whose largest output wins. Models are YAML files, for example:
+//
+//   kind:     tree
+//   features: [ insts, divInsts, localLoads ]
+//   configurations:
+//     - { factor: 1, stride: 1, direction: 0 }
+//     - { factor: 4, stride: 1, direction: 0 }
+//   trees:
+//     - nodes:
+//         - { feature: 1, threshold: 2.5, left: 1, right: 2 }
+//         - { configuration: 1 }
+//         - { configuration: 0 }
+//
+// Internal nodes go left if the feature is less than or equal to the
+// threshold, leaves have no feature. Features are indices in the features
+// list, which names the features of FeatureCollector the model reads.
+// A perceptron lists its layers instead of the trees:
+//
+//   mean:  [ ... ]
+//   scale: [ ... ]
+//   layers:
+//     - { activation: relu, weights: [ ... ], biases: [ ... ] }
+//
+// The inputs are normalized as (value - mean) * scale, the weights of a
+// layer are stored by output, one row of inputs after the other.
+// Activations are relu, tanh, sigmoid and linear.
+class CoarseningModel {
+public:
+  struct Configuration {
+    unsigned int factor;
+    unsigned int stride;
+    unsigned int direction;
+  };
+
+  struct TreeNode {
+    // -1 for a leaf.
+    int feature;
+    float threshold;
+    unsigned int left;
+    unsigned int right;
+    // Predicted configuration of a leaf.
+    unsigned int configuration;
+  };
+
+  struct Tree {
+    std::vector<TreeNode> nodes;
+  };
+
+  struct Layer {
+    std::string activation;
+    std::vector<float> weights;
+    std::vector<float> biases;
+  };
+
+public:
+  CoarseningModel();
+
+public:
+  // Read a model from a YAML file and bind its features to the ones in
+  // featureNames. Return false and set error on failure.
+  static bool loadFromFile(const std::string &fileName,
+                           const std::vector<std::string> &featureNames,
+                           CoarseningModel &model, std::string &error);
+
+public:
+  // Configuration predicted for the given feature values, in the order of
+  // the featureNames the model was loaded with.
+  const Configuration &predict(const std::vector<float> &values) const;
+
+public:
+  std::string kind;
+  std::vector<std::string> features;
+  std::vector<Configuration> configurations;
+  std::vector<Tree> trees;
+  std::vector<float> mean;
+  std::vector<float> scale;
+  std::vector<Layer> layers;
+
+private:
+  bool bindFeatures(const std::vector<std::string> &featureNames,
+                    std::string &error);
+  bool verify(std::string &error) const;
+  unsigned int evaluateTree(const Tree &tree,
+                            const std::vector<float> &inputs) const;
+  unsigned int evaluatePerceptron(std::vector<float> inputs) const;
+
+private:
+  // Position of each model feature in the values given to predict.
+  std::vector<unsigned int> featureIndices;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef DEVICE_PROFILE_H
+#define DEVICE_PROFILE_H
+
+#include <string>
+
+namespace llvm {
+class Instruction;
+class Type;
+}
+
+using namespace llvm;
+
+// Description of the target device used by the cost models.
+// A profile is either one of the built-in ones (see getBuiltinNames) or a
+// YAML file with the same fields, for example:
+//
+//   name:             my-device
+//   char_width:       16
+//   float_width:      4
+//   register_file:    512
+//   warp_size:        16
+//   cacheline_size:   64
+//   memory_bandwidth: 25.6
+//
+// Fields missing from the file keep the values of the default profile.
+class DeviceProfile {
+public:
+  // The default profile: a 32-wide NVIDIA warp.
+  DeviceProfile();
+
+public:
+  // Look up a built-in profile by name. Return false if there is none.
+  static bool getBuiltin(const std::string &name, DeviceProfile &profile);
+  // Read a profile from a YAML file. Return false and set error on failure.
+  static bool loadFromFile(const std::string &fileName,
+                           DeviceProfile &profile, std::string &error);
+  // Comma-separated list of the built-in profiles.
+  static std::string getBuiltinNames();
+
+public:
+  // Number of elements of the given scalar type the device processes with a
+  // single instruction for a single work-item. Return 1 for unknown types.
+  unsigned int getNativeWidth(const Type *type) const;
+  // Same as above, taking the short type name (i8, i16, i32, ...).
+  unsigned int getNativeWidth(const std::string &typeName) const;
+  // Issue slots a work-item takes to execute the instruction, in simple
+  // operations: vectors wider than the native width take several
+  // instructions, each weighted with the cost of its type and operation.
+  // Memory accesses, phis and allocas take none.
+  float getIssueCost(const Instruction *inst) const;
+
+public:
+  std::string name;
+
+  // Native vector width, in elements, for each scalar type.
+  unsigned int charWidth;
+  unsigned int shortWidth;
+  unsigned int intWidth;
+  unsigned int longWidth;
+  unsigned int halfWidth;
+  unsigned int floatWidth;
+  unsigned int doubleWidth;
+
+  // Size of the register file available to a single work-item, in bytes.
+  unsigned int registerFileSize;
+
+  // Memory model of the symbolic execution.
+  // Work items executing in lockstep.
+  unsigned int warpSize;
+  // Local memory banks and their width in bytes.
+  unsigned int bankNumber;
+  unsigned int bankWidth;
+  // Size of the global memory transactions in bytes.
+  unsigned int cachelineSize;
+  // Address spaces of local, global and constant memory.
+  unsigned int localAddressSpace;
+  unsigned int globalAddressSpace;
+  unsigned int constantAddressSpace;
+
+  // Roofline of the performance prediction.
+  // Peak throughput of simple arithmetic operations, in Gop/s.
+  float computeThroughput;
+  // Peak bandwidth of global and local memory, in GB/s.
+  float memoryBandwidth;
+  float localMemoryBandwidth;
+  // Cost of a call to a builtin math function and of a barrier, in simple
+  // operations.
+  float mathCost;
+  float barrierCost;
+  // Throughput table: cost of a native instruction on each type and of a
+  // division or remainder, relative to a 32-bit operation.
+  float halfCost;
+  float doubleCost;
+  float longCost;
+  float divisionCost;
+
+  // Resources of a compute unit shared by the resident work-groups, 0 if they
+  // do not limit them. Registers are 32 bit wide.
+  unsigned int computeUnitRegisters;
+  unsigned int maxWarpsPerComputeUnit;
+  unsigned int maxGroupsPerComputeUnit;
+  // Local memory in bytes.
+  unsigned int localMemorySize;
+};
+
+// Get the profile selected on the command line with -device-profile.
+const DeviceProfile &getDeviceProfile();
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef FEATURE_TABLE_H
+#define FEATURE_TABLE_H
+
+#include "llvm/Support/DataTypes.h"
+
+#include <string>
+#include <vector>
+
+// Table of features with a row for each kernel and configuration.
+// Every row has the module, the kernel and the configuration strings
+// followed by the same numeric features, so that tables of different runs
+// can be appended to each other.
+//
+// Two formats are written, both appending to the file if it exists:
+// - CSV, with the column names in the first line.
+// - A binary columnar file: a FeatureTableHeader and the column names,
+//   written once, followed by a sequence of row groups, each one a uint64_t
+//   number of rows, the string columns and the feature columns. Strings are
+//   a uint32_t length and the characters, features are floats. The byte
+//   order is the one of the host.
+// Appending fails if the columns of the file differ from the ones of the
+// table. Only the names at the top of the file are read, whatever its size.
+
+struct FeatureTableHeader {
+  // "THRUDTBL".
+  char magic[8];
+  uint32_t version;
+  // Number of feature columns, the string columns are not counted.
+  uint32_t featureNumber;
+};
+
+class FeatureTable {
+public:
+  FeatureTable(const std::vector<std::string> &featureNames);
+
+public:
+  void addRow(const std::string &module, const std::string &kernel,
+              const std::string &configuration,
+              const std::vector<float> &features);
+  unsigned int getRowNumber() const;
+
+  // Return false and set error if the file cannot be read or written, or if
+  // its columns do not match.
+  bool appendCSV(const std::string &fileName, std::string &error) const;
+  bool appendColumnar(const std::string &fileName, std::string &error) const;
+
+private:
+  std::vector<std::string> featureNames;
+  std::vector<std::string> modules;
+  std::vector<std::string> kernels;
+  std::vector<std::string> configurations;
+  // Row major.
+  std::vector<float> features;
+};
+
+#endif
@@ -6,9 +6,13 @@
 #include "thrud/Support/NDRangeSpace.h"
 
 #include <map>
+#include <string>
+#include <vector>
 
 namespace llvm {
+class Argument;
 class Function;
+class Module;
 }
 
 using namespace llvm;
@@ -16,24 +20,50 @@ using namespace llvm;
 class OCLEnv {
 
 public:
-  static const int BANK_NUMBER;
-  static const int BANK_WIDTH;
-  static const int WARP_SIZE;
-  static const int CACHELINE_SIZE;
+  // The device dependent constants are in DeviceProfile.
   static const int UNKNOWN_MEMORY_LOCATION;
-  static unsigned const int LOCAL_AS;
+
+  // Values of the integer arguments of the kernel, by name or by position
+  // (counted from 0). Unbound arguments take the value of -kernel-arg-default.
+  // __local pointer arguments are bound to the size in bytes of their
+  // buffer.
+  // Binding a name or position that is not an integer or __local pointer
+  // argument of any kernel of the module is an error.
+  typedef std::map<std::string, int> ArgumentSet;
 
 public:
+  // Bind the arguments with the first argument set.
   OCLEnv(Function &function, const NDRange *ndRange,
          const NDRangeSpace &ndRangeSpace);
+  OCLEnv(Function &function, const NDRange *ndRange,
+         const NDRangeSpace &ndRangeSpace, const ArgumentSet &arguments);
 
 public:
   const NDRange *getNDRange() const;
   const NDRangeSpace &getNDRangeSpace() const;
   int resolveValue(llvm::Value *) const;
 
+public:
+  // The argument sets given with -kernel-args, one per occurrence, followed
+  // by the ones in -kernel-args-file, one per line. A single empty set if
+  // there are none. Parsed on the first call.
+  static const std::vector<ArgumentSet> &getArgumentSets();
+  // Fail if a binding of the argument sets names no integer or __local
+  // pointer argument of the kernels of module. Done once per module when the
+  // first environment is built.
+  static void checkArgumentSets(const Module &module);
+  // Get the binding of argument, by name or else by position.
+  // Return false if it is unbound.
+  static bool getBinding(const ArgumentSet &arguments,
+                         const Argument *argument, int &value);
+  // Parse a set in the form "N=1024, pitch=2048, 3=16".
+  // Return false and set error if it is malformed.
+  static bool parseArgumentSet(const std::string &text, ArgumentSet &arguments,
+                               std::string &error);
+  static std::string toString(const ArgumentSet &arguments);
+
 private:
-  void setup(Function &function);
+  void setup(Function &function, const ArgumentSet &arguments);
 
 private:
   const NDRange *ndRange;
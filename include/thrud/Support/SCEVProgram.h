@@ -0,0 +1,117 @@
+#ifndef SCEV_PROGRAM_H
+#define SCEV_PROGRAM_H
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+
+#include "llvm/Support/DataTypes.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace llvm;
+
+class NDRangePoint;
+class OCLEnv;
+
+// An address SCEV compiled once into a straight-line program over the
+// coordinates of a work item.
+// The address must have the form base + offset, where base is a pointer
+// argument or a global variable and offset depends only on the coordinates,
+// the sizes of the NDRange and the integer arguments of the kernel.
+// The program computes offset and is evaluated on many work items at a time:
+// each operation is applied to all the points before moving to the next one.
+// Recurrences are evaluated on the iteration of their loop.
+// Values are 64 bit signed integers: integers narrower than that are sign
+// extended, zero extensions and truncations are computed on the bits of their
+// type.
+// Value programs compute integer values, such as trip counts, and have no
+// base.
+class SCEVProgram {
+public:
+  enum Kind {
+    AddressProgram,
+    ValueProgram
+  };
+
+  // Iteration of each loop, loops not in the map are at the first iteration.
+  typedef std::map<const Loop *, int64_t> IterationMap;
+
+public:
+  SCEVProgram();
+  SCEVProgram(const SCEV *scev, ScalarEvolution *scalarEvolution,
+              const OCLEnv *ocl, Kind kind = AddressProgram);
+
+public:
+  bool isValid() const;
+  const SCEVUnknown *getBase() const;
+
+  // Compute the offset in bytes of the address from its base for each of the
+  // points. Offsets that cannot be computed (invalid program, division by
+  // zero, overflow) are set to OCLEnv::UNKNOWN_MEMORY_LOCATION.
+  void evaluate(const std::vector<NDRangePoint> &points,
+                std::vector<int> &offsets) const;
+  void evaluate(const std::vector<NDRangePoint> &points,
+                const IterationMap &iterations,
+                std::vector<int> &offsets) const;
+
+private:
+  enum Opcode {
+    Constant,
+    LocalId,
+    GlobalId,
+    GroupId,
+    // Iteration of the loop in loops[value].
+    Iteration,
+    // Binomial coefficient (first choose value).
+    Binomial,
+    Add,
+    Mul,
+    SMax,
+    UMax,
+    UDiv,
+    SDiv,
+    URem,
+    // Low value bits of first, sign extended.
+    Trunc,
+    // Low value bits of first, zero extended.
+    ZExt
+  };
+
+  // The result of each operation is stored in the slot with its index.
+  // Operands refer to the slots of previous operations.
+  struct Operation {
+    Opcode opcode;
+    // Value of constants, direction of coordinates.
+    int64_t value;
+    int first;
+    int second;
+  };
+
+private:
+  int compile(const SCEV *scev, bool additive);
+  int compileAddRec(const SCEVAddRecExpr *expr, bool additive);
+  int compileNAry(const SCEVNAryExpr *expr, Opcode opcode, bool additive);
+  int compileUnknown(const SCEVUnknown *expr, bool additive);
+  int compileInstruction(Instruction *inst, bool additive);
+  int emit(Opcode opcode, int64_t value, int first, int second);
+  int invalidate();
+
+private:
+  ScalarEvolution *scalarEvolution;
+  const OCLEnv *ocl;
+
+  bool valid;
+  const SCEVUnknown *base;
+  std::vector<const Loop *> loops;
+  std::vector<Operation> operations;
+  int result;
+
+  // Compilation state.
+  std::map<const SCEV *, int> slots;
+  std::set<PHINode *> visitingPhis;
+};
+
+#endif
@@ -1,12 +1,17 @@
 #ifndef SUBSCRIPT_ANALYSIS_H
 #define SUBSCRIPT_ANALYSIS_H
 
+#include "thrud/Support/SCEVProgram.h"
 #include "thrud/Support/Utils.h"
 #include "thrud/Support/Warp.h"
 
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
 
+#include <map>
+#include <vector>
+
 class NDRangePoint;
 class OCLEnv;
 
@@ -14,47 +19,72 @@ class SubscriptAnalysis {
 public:
   SubscriptAnalysis(ScalarEvolution *se, OCLEnv *ocl, const Warp &warp);
 
+public:
+  // Change the warp the accesses are evaluated on.
+  void setWarp(const Warp &warp);
+  // Compile the address programs of the accesses of function and the trip
+  // count programs of its loops. After this the analysis of function does
+  // not touch scalar evolution any more: copies of the analysis can evaluate
+  // different warps concurrently.
+  void compilePrograms(Function &function, LoopInfo *loopInfo);
+
 public:
   bool isConsecutive(Value *value, int direction);
+  // Extra wavefronts a local memory access of the warp takes because of bank
+  // conflicts. Work items with an unknown address count as conflicting.
   int getBankConflictNumber(Value *value);
   int getTransactionNumber(Value *value);
 
+  // Accesses in the loop nest ending with loop are evaluated on the
+  // iterations of the nest, all of them or a sample of them.
+  // Return the number per iteration, averaged over the iterations, set
+  // iterations to the iterations the warp executes and total to the sum of
+  // the number over all of them.
+  int getLoopBankConflictNumber(Value *value, const Loop *loop,
+                                int &iterations, int &total);
+  int getLoopTransactionNumber(Value *value, const Loop *loop,
+                               int &iterations, int &total);
+
+  // Offsets of the access from its base for the work items of the warp at the
+  // given iterations. Return the base, NULL if the address is not known.
+  const SCEVUnknown *
+  getMemoryOffsets(Value *value, const SCEVProgram::IterationMap &iterations,
+                   std::vector<int> &offsets);
+  // Trip count of loop for the work items of the warp at the given
+  // iterations of the enclosing loops.
+  std::vector<int> getTripCounts(const Loop *loop,
+                                 const SCEVProgram::IterationMap &iterationMap);
+
 private:
   ScalarEvolution *scalarEvolution;
   OCLEnv *ocl;
   Warp warp;
-  typedef std::map<const SCEV*, const SCEV*> SCEVMap;
+  // Size in bytes of the element of the access being evaluated, 0 if
+  // unknown.
+  int accessWidth;
+  // Address programs, compiled once for each pointer.
+  std::map<const Value *, SCEVProgram> programs;
+  // Backedge taken count programs.
+  std::map<const Loop *, SCEVProgram> tripCountPrograms;
+
+  typedef int (SubscriptAnalysis::*ComputeFunction)(std::vector<int> &);
 
 private:
-  std::vector<int> getMemoryOffsets(std::vector<const SCEV *> scevs, const SCEV *unknown);
-  std::vector<const SCEV *> analyzeSubscript(const SCEV *scev);
-  int computeTransactionNumber(const std::vector<const SCEV*> &scevs);
-  int computeBankConflictNumber(const std::vector<const SCEV*> &scevs);
-  bool verifyUnknown(const SCEV* scev, const SCEV* unknown);
-  bool verifyUnknown(const std::vector<const SCEV*> &scevs, const SCEV* unknown);
-  const SCEVUnknown* getUnknownSCEV(const SCEV* scev);
-
-  // Replacing methods.
-  const SCEV *replaceInExpr(const SCEV *expr, const NDRangePoint &point,
-                            SCEVMap &processed);
-  const SCEV *replaceInExpr(const SCEVAddRecExpr *expr,
-                            const NDRangePoint &point,
-                            SCEVMap &processed);
-  const SCEV *replaceInExpr(const SCEVCommutativeExpr *expr,
-                            const NDRangePoint &point,
-                            SCEVMap &processed);
-  const SCEV *replaceInExpr(const SCEVConstant *expr, const NDRangePoint &point,
-                            SCEVMap &processed);
-  const SCEV *replaceInExpr(const SCEVUnknown *expr, const NDRangePoint &point,
-                            SCEVMap &processed);
-  const SCEV *replaceInExpr(const SCEVUDivExpr *expr, const NDRangePoint &point,
-                            SCEVMap &processed);
-  const SCEV *replaceInExpr(const SCEVCastExpr *expr, const NDRangePoint &point,
-                            SCEVMap &processed);
-  const SCEV *replaceInPhi(PHINode *Phi, const NDRangePoint &point,
-                           SCEVMap &processed);
-
-  const SCEV *resolveInstruction(llvm::Instruction *instruction, const NDRangePoint &point);
+  const SCEVProgram &getProgram(Value *value);
+  const SCEVProgram &getTripCountProgram(const Loop *loop);
+  std::vector<int> getMemoryOffsets(Value *value,
+                                    const std::vector<NDRangePoint> &points);
+  int evaluateInLoop(Value *value, const Loop *loop, ComputeFunction compute,
+                     int &iterations, int &total);
+  void evaluateNest(const SCEVProgram &program,
+                    const std::vector<const Loop *> &nest, unsigned int level,
+                    double weight, const std::vector<char> &active,
+                    SCEVProgram::IterationMap &iterationMap,
+                    ComputeFunction compute, double &iterations,
+                    double &total);
+  int computeTransactionNumber(std::vector<int> &offsets);
+  int computeBankConflictNumber(std::vector<int> &offsets);
+  int getBankWidth() const;
 };
 
 #endif
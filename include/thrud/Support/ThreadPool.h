@@ -0,0 +1,48 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+
+// Run a number of independent tasks on a set of worker threads.
+// Workers take the next task index from a shared counter, so tasks of
+// uneven cost are balanced. Each task is also given the index of the thread
+// running it, to let it use per thread state.
+class ThreadPool {
+public:
+  typedef void (*Task)(void *context, unsigned int task, unsigned int thread);
+
+public:
+  // A thread number of 0 uses a thread for each online processor.
+  ThreadPool(unsigned int threadNumber);
+  ~ThreadPool();
+
+public:
+  // Run task(context, index, thread) for index in [0, taskNumber) and wait
+  // for all of them to complete.
+  void run(unsigned int taskNumber, Task task, void *context);
+  unsigned int getThreadNumber() const;
+
+public:
+  static unsigned int getProcessorNumber();
+
+private:
+  struct Worker {
+    ThreadPool *pool;
+    unsigned int thread;
+  };
+
+  static void *work(void *argument);
+  bool getNextTask(unsigned int &task);
+
+private:
+  unsigned int threadNumber;
+  pthread_mutex_t mutex;
+
+  // State of the current run.
+  Task task;
+  void *context;
+  unsigned int taskNumber;
+  unsigned int nextTask;
+};
+
+#endif
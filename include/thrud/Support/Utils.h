@@ -21,6 +21,7 @@
 using namespace llvm;
 
 extern const char *BARRIER;
+extern const char *COARSENED_MD;
 
 // Loop management.
 bool isInLoop(const Instruction &inst, LoopInfo *loopInfo);
@@ -29,10 +30,37 @@ bool isInLoop(const BasicBlock *block, LoopInfo *loopInfo);
 
 // OpenCL management.
 bool isKernel(const Function *function);
+bool isInNamedMetadata(const Function *function, const char *name);
+
+// Transformation history.
+// Coarsened kernels are recorded in the module so that passes running later
+// in the same pipeline (eg: -tv after -tc) can find out about it.
+bool isCoarsened(const Function *function);
+void markAsCoarsened(Function *function);
+// So are the coarsening configurations chosen for a kernel (eg: by
+// -coarsening-prediction): the coarsening passes use them instead of the
+// command line options, which stay the same for all the kernels.
+void setCoarseningConfiguration(Function *function, unsigned int factor,
+                                unsigned int stride, unsigned int direction);
+// Leave the arguments unchanged if no configuration is recorded.
+void getCoarseningConfiguration(const Function *function,
+                                unsigned int &factor, unsigned int &stride,
+                                unsigned int &direction);
 
 void safeIncrement(std::map<std::string, int> &inputMap,
                    std::string key);
 
+// Type management.
+// Get the type an instruction computes on: the stored value for stores, the
+// compared values for comparisons, the element type for vectors.
+Type *getDataType(const Instruction *inst);
+// Short name of the given scalar type (i8, i16, i32, i64, f16, f32, f64).
+// Return the empty string for any other type.
+std::string getScalarTypeName(const Type *type);
+// Bytes a value of the given type takes in registers. Pointers are assumed to
+// be 64 bits wide, predicates take a full byte.
+unsigned int getRegisterBytes(const Type *type);
+
 // Map management.
 // Apply the given map to the given instruction.
 void applyMap(Instruction *Inst, Map &map);
@@ -145,6 +173,14 @@ bool isMathName(std::string fName);
 bool isLocalMemoryAccess(Instruction *inst);
 bool isLocalMemoryStore(Instruction *inst);
 bool isLocalMemoryLoad(Instruction *inst);
+// Pointer operand of the given load or store.
+Value *getMemoryPointer(Instruction *inst);
+// Bytes of the __local variables the function uses, allocated once per
+// work-group, plus the buffers passed as __local pointer arguments, with the
+// sizes bound by the first -kernel-args set. unboundArgs is set to the number
+// of __local pointer arguments without a size, which are not counted.
+unsigned int getLocalMemorySize(const Function *function,
+                                unsigned int &unboundArgs);
 bool IsIntCast(Instruction *inst);
 
 //------------------------------------------------------------------------------
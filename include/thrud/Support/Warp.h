@@ -11,10 +11,26 @@ public:
   // localGroupIndex: index of the local work group to which the warp belongs to.
   // warpIndex: index of the warp in the local group.
   // Both are counted starting from 0 in raw major order.
+  // The last warp of a group is partial if the group size is not a multiple
+  // of the warp size.
   Warp(int groupX, int groupY, int groupZ, int warpIndex,
        const NDRangeSpace &ndrSpace);
 
+  // Number of work items in the warp.
+  int size() const;
+
+  // The work items of the warp in local linear order.
+  const std::vector<NDRangePoint> &getPoints() const;
+
+  int getGroup(int direction) const;
+  int getWarpIndex() const;
+
+  // Number of warps in each work group.
+  static int getWarpsPerGroup(const NDRangeSpace &ndrSpace);
+
 private:
+  int group[3];
+  int warpIndex;
   std::vector<NDRangePoint> points; 
 
 //-----------------------------------------------------------------------------
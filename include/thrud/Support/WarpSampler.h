@@ -0,0 +1,51 @@
+#ifndef WARP_SAMPLER_H
+#define WARP_SAMPLER_H
+
+#include "thrud/Support/NDRangeSpace.h"
+#include "thrud/Support/Warp.h"
+
+#include "llvm/Support/DataTypes.h"
+
+#include <string>
+#include <vector>
+
+// Select the warps of the NDRange the memory accesses are evaluated on.
+class WarpSampler {
+public:
+  enum SamplingMode {
+    FirstWarp,
+    AllWarps,
+    StratifiedWarps,
+    ListedWarps
+  };
+
+public:
+  WarpSampler(const NDRangeSpace &ndrSpace);
+
+public:
+  // The first warp of the first group.
+  std::vector<Warp> getFirst() const;
+  // Every warp of every group. If there are more than maxWarps warps fall
+  // back to a stratified sample of maxWarps warps.
+  std::vector<Warp> getAll(unsigned int maxWarps) const;
+  // The given number of warps, spread evenly over the warp indices within a
+  // group and over the groups. The first and the last group, and the first
+  // and the last (possibly partial) warp are always included.
+  std::vector<Warp> getStratified(unsigned int samples) const;
+  // The warps in the given list: "gx,gy,gz,w;gx,gy,gz,w;...".
+  // Return false and set error if the list is malformed or out of range.
+  bool getListed(const std::string &list, std::vector<Warp> &warps,
+                 std::string &error) const;
+
+  uint64_t getGroupNumber() const;
+  uint64_t getWarpNumber() const;
+
+private:
+  Warp getWarp(uint64_t groupIndex, int warpIndex) const;
+
+private:
+  NDRangeSpace ndrSpace;
+  int warpsPerGroup;
+};
+
+#endif
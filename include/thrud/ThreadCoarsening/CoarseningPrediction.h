@@ -0,0 +1,44 @@
+#ifndef COARSENING_PREDICTION_H
+#define COARSENING_PREDICTION_H
+
+#include "thrud/Support/CoarseningModel.h"
+
+#include "llvm/Pass.h"
+
+using namespace llvm;
+
+namespace llvm {
+class Function;
+}
+
+/// Predict the coarsening configuration of a kernel with a trained model
+/// (-coarsening-model, see CoarseningModel) evaluated on the features of
+/// FeatureCollector, and record it in the module metadata of the kernel. It
+/// overrides -coarsening-factor, -coarsening-stride and -coarsening-direction
+/// for that kernel only. The pass goes before the coarsening ones:
+///
+///   opt -coarsening-prediction -coarsening-model model.yaml -be -tc
+///
+/// so that the divergence analysis, the branch extraction and the
+/// coarsening all see the predicted configuration. The divergence analysis
+/// along a single direction is not preserved: it is computed again along
+/// the predicted direction.
+class CoarseningPrediction : public FunctionPass {
+public:
+  static char ID;
+  CoarseningPrediction();
+
+  virtual bool doInitialization(Module &module);
+  virtual bool runOnFunction(Function &function);
+  virtual void getAnalysisUsage(AnalysisUsage &au) const;
+
+public:
+  // Configuration predicted for the last kernel.
+  const CoarseningModel::Configuration &getConfiguration() const;
+
+private:
+  CoarseningModel model;
+  CoarseningModel::Configuration configuration;
+};
+
+#endif
@@ -15,6 +15,7 @@ namespace llvm {
 class DominatorTree;
 class Instruction;
 class ScalarEvolution;
+class Loop;
 class LoopInfo;
 }
 
@@ -22,6 +23,29 @@ class DivergenceAnalysis;
 class OCLEnv;
 class SubscriptAnalysis;
 
+// Tree reduction through local memory:
+//   for (s = size / 2; s > 0; s >>= 1) {
+//     if (lid < s)
+//       l[lid] = l[lid] op l[lid + s];
+//     barrier(CLK_LOCAL_MEM_FENCE);
+//   }
+struct ReductionTree {
+  // Branch leaving the loop and the stride value it tests.
+  BranchInst *exitBranch;
+  Value *stride;
+  // Operands of the address of the updated element but the last index, and
+  // the type of the latter: the address of the first element of the local
+  // buffer is built from them in the exit block of the loop.
+  ValueVector baseOperands;
+  Type *indexType;
+  bool inBounds;
+  BasicBlock *exit;
+  Instruction::BinaryOps opcode;
+  unsigned int alignment;
+  CallInst *localId;
+  CallInst *barrier;
+};
+
 class ThreadVectorizing : public FunctionPass {
 public:
   enum DivRegionOption { 
@@ -49,6 +73,22 @@ public:
 private:
   void init();
 
+  // Automatic width selection.
+  // Pick the vectorizing width for the current kernel on the device
+  // selected with -device-profile. Return 1 if vectorizing does not pay off.
+  unsigned int selectWidth();
+  // Check if the given instruction is going to be replicated rather than
+  // vectorized.
+  bool isReplicated(Instruction *inst);
+  // Check if all the vector types created for the given width are legal.
+  bool isLegalWidth(unsigned int candidate);
+  // Estimate the registers, in bytes, a work-item needs with the given width.
+  unsigned int estimateRegisterUsage(unsigned int candidate);
+
+  // Scale the size of the NDRange in the vectorizing direction by the
+  // vectorization width.
+  void scaleSizes();
+
   // Shift and widen tid values into a vector.
   void widenTids();
 
@@ -99,9 +139,69 @@ private:
   // Return the vector value corresponding to the given vector value.
   Value *getVectorValue(Value *scalar_value);
 
-  // Vectorize the branch controlling a divergent loop.
+  // Divergent loops.
+  // Check if the given divergent region is a loop that can be executed in
+  // vector form under an active-lane mask.
+  bool isMaskableLoop(DivergentRegion *region);
+
+  // Vectorize a divergent loop: all the lanes iterate together while at least
+  // one of them is still active. Lanes that have left the loop keep the
+  // values of their last iteration.
+  void vectorizeLoop(DivergentRegion *region);
+
+  // Find the instructions of the loop whose values are used outside of it,
+  // and the uniform instructions after the loop that depend on them. These
+  // are different for each lane once the loop is executed in vector form.
+  // Return false if some of the latter cannot be vectorized.
+  bool findLiveOutChains(Loop *loop, InstVector &liveOuts, InstVector &users);
+
+  // Route the uses of the live-out values after the loop through phis in the
+  // exit block, which stand for the values frozen lane by lane.
+  void createLiveOutPhis(Loop *loop, InstVector &liveOuts);
+
+  // Keep the value of the last iteration of each lane in an accumulator:
+  // select(mask, new, old) at the end of the exiting block.
+  Value *freezeLiveOut(Instruction *inst, Loop *loop);
+
+  // Vectorize the branch controlling a divergent loop: update the active-lane
+  // mask and branch back while any lane is still active.
   BranchInst *vectorizeLoopBranch(BranchInst *inst);
 
+  // Reduce the given mask to a scalar i1, true if any lane is set.
+  Value *createAnyLaneActive(Value *mask);
+
+  // Replicate the masked memory instructions, guarding each replica with the
+  // corresponding lane of the mask.
+  void vectorizeMaskedInsts();
+  Value *replicateMaskedInst(Instruction *inst, Value *mask,
+                             ValueVector &operands);
+
+  // Induction variables.
+  // Find the phis of uniform and masked loops that vary only in their start
+  // value and are incremented by a uniform step. These are kept scalar: the
+  // value of each lane is the scalar phi plus a lane offset computed before
+  // the loop.
+  void findAffinePhis();
+  bool isAffinePhi(PHINode *phi);
+  // Make the affine phi start from the value of the first lane and compute
+  // the lane offset.
+  void initAffinePhi(PHINode *phi, Instruction *increment);
+  // Create the vector form of an affine value: scalar value plus offset.
+  Value *materializeAffineValue(Instruction *inst);
+  // Get the value of the first lane of the given scalar value.
+  Value *getLaneZeroValue(Value *scalar);
+
+  // Local-memory reductions.
+  // Find the reduction trees of the kernel, and report the scans that are
+  // left to the generic replication.
+  void findReductionTrees();
+  bool isReductionTree(Loop *loop, ReductionTree &tree);
+  bool isScanTree(Loop *loop);
+  // Stop the reduction loops when the stride gets below the width and
+  // reduce the last width elements within the first work item.
+  void vectorizeReductionTrees();
+  void vectorizeReductionTree(ReductionTree &tree);
+
   // Vectorize the instructions guarded by the given branch
   // instruction.
   void vectorizeShieldBranch(BranchInst *inst);
@@ -193,6 +293,31 @@ private:
   PhiVector vectorPhis;
   // Undef map.
   V2VMap phMap;
+
+  // Divergent loops executed under an active-lane mask.
+  RegionVector maskedLoops;
+  // Active-lane mask of the divergent loop being vectorized, and its value
+  // after the exit test.
+  PHINode *loopMask;
+  Value *nextLoopMask;
+  // Loop-carried phis of masked loops, blended on the back edge with the
+  // active-lane mask.
+  std::map<PHINode *, Value *> blendedPhis;
+  // Uniform instructions after masked loops that depend on their live-out
+  // values, computed in vector form as well.
+  InstSet promotedInsts;
+  InstVector liveOutUsers;
+  // Phis of the exit blocks of masked loops mapped to the live-out value
+  // they stand for, and the frozen vector form of the live-out values.
+  std::map<PHINode *, Instruction *> liveOutPhis;
+  std::map<Instruction *, Value *> frozenValues;
+  // Memory instructions of masked loops and the mask guarding them.
+  std::vector<std::pair<Instruction *, Value *> > maskedInsts;
+  // Affine phis and their increments, kept scalar, mapped to their lane
+  // offset vector.
+  std::map<Instruction *, Value *> affineOffsets;
+  // Local-memory reduction trees.
+  std::vector<ReductionTree> reductionTrees;
 };
 
 #endif
@@ -0,0 +1,110 @@
+#define DEBUG_TYPE "coarsening_prediction"
+
+#include "thrud/ThreadCoarsening/CoarseningPrediction.h"
+
+#include "thrud/DivergenceAnalysis/DivergenceAnalysis.h"
+
+#include "thrud/FeatureExtraction/FeatureCollector.h"
+
+#include "thrud/Support/NDRange.h"
+#include "thrud/Support/Utils.h"
+
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+
+#include "llvm/IR/Function.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+extern cl::opt<std::string> KernelNameCL;
+
+static cl::opt<std::string>
+    CoarseningModelCL("coarsening-model", cl::init(""), cl::Hidden,
+                      cl::desc("YAML model predicting the coarsening "
+                               "configuration from the kernel features"));
+
+char CoarseningPrediction::ID = 0;
+static RegisterPass<CoarseningPrediction>
+    X("coarsening-prediction",
+      "Predict the coarsening configuration with a trained model");
+
+//------------------------------------------------------------------------------
+CoarseningPrediction::CoarseningPrediction() : FunctionPass(ID) {
+  configuration.factor = 1;
+  configuration.stride = 1;
+  configuration.direction = 0;
+}
+
+//------------------------------------------------------------------------------
+bool CoarseningPrediction::doInitialization(Module &module) {
+  if (CoarseningModelCL.empty())
+    report_fatal_error("-coarsening-prediction requires -coarsening-model");
+
+  std::string error;
+  if (!CoarseningModel::loadFromFile(CoarseningModelCL,
+                                     FeatureCollector::getFeatureNames(), model,
+                                     error))
+    report_fatal_error("Invalid coarsening model: " + error);
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool CoarseningPrediction::runOnFunction(Function &function) {
+  // Same kernels as the coarsening.
+  if (!isKernel((const Function *)&function))
+    return false;
+  if (KernelNameCL != "" && function.getName() != KernelNameCL)
+    return false;
+
+  FeatureCollector collector;
+  collector.collect(function, &getAnalysis<DominatorTree>(),
+                    &getAnalysis<PostDominatorTree>(),
+                    &getAnalysis<MultiDimDivAnalysis>(),
+                    &getAnalysis<SingleDimDivAnalysis>(),
+                    &getAnalysis<LoopInfo>(),
+                    &getAnalysis<ScalarEvolution>(), &getAnalysis<NDRange>());
+
+  // The configuration is recorded for this kernel only: the features of the
+  // next one are collected with the command line options.
+  configuration = model.predict(collector.getFeatureValues());
+  setCoarseningConfiguration(&function, configuration.factor,
+                             configuration.stride, configuration.direction);
+
+  DEBUG(dbgs() << function.getName() << ": factor " << configuration.factor
+               << ", stride " << configuration.stride << ", direction "
+               << configuration.direction << "\n");
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void CoarseningPrediction::getAnalysisUsage(AnalysisUsage &au) const {
+  au.addRequired<MultiDimDivAnalysis>();
+  au.addRequired<SingleDimDivAnalysis>();
+  au.addRequired<PostDominatorTree>();
+  au.addRequired<DominatorTree>();
+  au.addRequired<ScalarEvolution>();
+  au.addRequired<LoopInfo>();
+  au.addRequired<NDRange>();
+  // The single direction analysis follows -coarsening-direction: it has to
+  // be computed again along the predicted one.
+  au.addPreserved<MultiDimDivAnalysis>();
+  au.addPreserved<PostDominatorTree>();
+  au.addPreserved<DominatorTree>();
+  au.addPreserved<ScalarEvolution>();
+  au.addPreserved<LoopInfo>();
+  au.addPreserved<NDRange>();
+}
+
+//------------------------------------------------------------------------------
+const CoarseningModel::Configuration &
+CoarseningPrediction::getConfiguration() const {
+  return configuration;
+}
@@ -28,7 +28,10 @@
 using namespace llvm;
 
 extern cl::opt<unsigned int> CoarseningDirectionCL;
+extern cl::opt<unsigned int> CoarseningFactorCL;
+extern cl::opt<unsigned int> CoarseningStrideCL;
 extern cl::opt<unsigned int> VectorizingDirectionCL;
+extern cl::opt<unsigned int> VectorizingWidthCL;
 
 // Support functions.
 // -----------------------------------------------------------------------------
@@ -255,7 +258,7 @@ bool isOutermost(DivergentRegion *region, RegionVector &regions) {
 
 // SingleDimDivAnalysis
 //------------------------------------------------------------------------------
-SingleDimDivAnalysis::SingleDimDivAnalysis() : FunctionPass(ID) {}
+SingleDimDivAnalysis::SingleDimDivAnalysis() : FunctionPass(ID), direction(0) {}
 
 void SingleDimDivAnalysis::getAnalysisUsage(AnalysisUsage &au) const {
   au.addRequired<LoopInfo>();
@@ -280,6 +283,8 @@ bool SingleDimDivAnalysis::runOnFunction(Function &functionRef) {
   ndr = &getAnalysis<NDRange>();
   cda = &getAnalysis<ControlDependenceAnalysis>();
 
+  direction = selectDirection(function);
+
   performAnalysis();
   findBranches();
   findRegions();
@@ -287,24 +292,45 @@ bool SingleDimDivAnalysis::runOnFunction(Function &functionRef) {
   return false;
 }
 
-InstVector SingleDimDivAnalysis::getTids() {
-  assert((CoarseningDirectionCL == 0 ||
+InstVector SingleDimDivAnalysis::getTids() { return ndr->getTids(direction); }
+
+unsigned int SingleDimDivAnalysis::getDirection() const { return direction; }
+
+// Coarsening and vectorization can be combined in the same pipeline
+// (-be -tc -be -tv): the kernel is coarsened first and the coarsened kernel is
+// then vectorized. The analysis is invalidated by -tc, so when it is
+// recomputed for the vectorizer the kernel is already marked as coarsened.
+unsigned int
+SingleDimDivAnalysis::selectDirection(const Function *function) const {
+  unsigned int coarseningFactor = CoarseningFactorCL;
+  unsigned int coarseningStride = CoarseningStrideCL;
+  unsigned int coarseningDirection = CoarseningDirectionCL;
+  getCoarseningConfiguration(function, coarseningFactor, coarseningStride,
+                             coarseningDirection);
+
+  bool coarsening = coarseningFactor > 1;
+  // Width 0 selects the vectorizing width automatically.
+  bool vectorizing = VectorizingWidthCL != 1;
+
+  if (coarsening && vectorizing)
+    return isCoarsened(function) ? VectorizingDirectionCL
+                                 : coarseningDirection;
+  if (coarsening)
+    return coarseningDirection;
+  if (vectorizing)
+    return VectorizingDirectionCL;
+
+  // No transformation: the analysis is used on its own (eg: by the feature
+  // extractors).
+  assert((coarseningDirection == 0 ||
          VectorizingDirectionCL == 0) &&
              "Both coarsening and vectorization direction are specified in "
              "command line");
 
-  unsigned int direction = 0; 
-
-  if(CoarseningDirectionCL == 0 && VectorizingDirectionCL == 0) 
-    direction = 0;
-
-  if(CoarseningDirectionCL != 0)
-    direction = CoarseningDirectionCL;
-
-  if(VectorizingDirectionCL != 0) 
-    direction = VectorizingDirectionCL;
+  if (VectorizingDirectionCL != 0)
+    return VectorizingDirectionCL;
 
-  return ndr->getTids(direction);
+  return coarseningDirection;
 }
 
 char SingleDimDivAnalysis::ID = 0;
@@ -1,34 +1,81 @@
 #include "thrud/FeatureExtraction/FeatureCollector.h"
 
 #include "thrud/Support/DataTypes.h"
+#include "thrud/Support/DeviceProfile.h"
 #include "thrud/Support/Graph.h"
 #include "thrud/Support/MathUtils.h"
-#include "thrud/Support/OCLEnv.h"
 #include "thrud/Support/Utils.h"
 #include "thrud/Support/SubscriptAnalysis.h"
 
 #include "thrud/FeatureExtraction/ILPComputation.h"
 #include "thrud/FeatureExtraction/MLPComputation.h"
+#include "thrud/FeatureExtraction/RegisterPressure.h"
+#include "thrud/FeatureExtraction/SymbolicExecution.h"
 
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
 
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/PostDominators.h"
 
 #include "llvm/Support/CFG.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/InstIterator.h"
 #include "llvm/Support/YAMLTraits.h"
 
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 #include <algorithm>
+#include <cctype>
 #include <functional>
 #include <iostream>
 #include <iterator>
+#include <numeric>
+#include <sstream>
+
+cl::opt<bool>
+    AllKernelsCL("count-all-kernels", cl::init(false), cl::Hidden,
+                 cl::desc("Extract the features of all the kernels of the "
+                          "module"));
+cl::opt<std::string>
+    FeatureTableCL("feature-table", cl::init(""), cl::Hidden,
+                   cl::desc("Append a row for each kernel to this CSV file "
+                            "instead of dumping YAML"));
+cl::opt<std::string>
+    FeatureColumnsCL("feature-columns", cl::init(""), cl::Hidden,
+                     cl::desc("Append a row for each kernel to this binary "
+                              "columnar file instead of dumping YAML"));
+cl::opt<std::string>
+    FeatureModuleCL("feature-module", cl::init(""), cl::Hidden,
+                    cl::desc("Module the table rows refer to, instead of "
+                             "the name of the input file"));
+cl::opt<std::string> FeatureConfigurationCL(
+    "feature-configuration", cl::init(""), cl::Hidden,
+    cl::desc("Configuration the table rows refer to, e.g. the coarsening "
+             "parameters"));
+
+// Per block and per divergent region features summarized in the table.
+static const char *BLOCK_FEATURES[] = {
+  "instsPerBlock", "phiArgs",      "ilpPerBlock",   "mlpPerBlock",
+  "avgLiveRange",  "aliveOut",     "liveIn",        "liveOut",
+  "regionSize",    "regionNesting", "regionLoopDepth", "regionPaths",
+  "regionAlive"
+};
+
+// Support functions.
+//------------------------------------------------------------------------------
+std::string getDynamicName(const std::string &name);
+std::string getOpcodeName(unsigned int opcode);
+std::string getTypeName(const Type *type);
+std::string getAddressSpaceName(unsigned int addressSpace);
+std::string getBuiltinName(const std::string &name);
+float countPaths(const BasicBlock *block, DivergentRegion &region,
+                 LoopInfo *loopInfo,
+                 std::map<const BasicBlock *, float> &paths);
 
 using namespace llvm;
 
@@ -53,28 +100,44 @@ template <> struct MappingTraits<FeatureCollector> {
     io.mapRequired("instsPerBlock", collector.blockInsts);
 
     // Dump Phi nodes.
-    std::vector<int> args;
-
-    for (std::map<std::string, std::vector<std::string> >::iterator
-             iter = collector.blockPhis.begin(),
-             end = collector.blockPhis.end();
-         iter != end; ++iter) {
-      std::vector<std::string> phis = iter->second;
-      int argSum = 0;
-      for (std::vector<std::string>::iterator phiIter = phis.begin(),
-                                              phiEnd = phis.end();
-           phiIter != phiEnd; ++phiIter) {
-        int argNumber = collector.phiArgs[*phiIter];
-        argSum += argNumber;
-      }
-      args.push_back(argSum);
-    }
-
+    std::vector<int> args = collector.countPhiArgs();
     io.mapRequired("phiArgs", args);
     io.mapRequired("ilpPerBlock", collector.blockILP);
     io.mapRequired("mlpPerBlock", collector.blockMLP);
     io.mapRequired("avgLiveRange", collector.avgLiveRange);
     io.mapRequired("aliveOut", collector.aliveOutBlocks);
+    io.mapRequired("liveIn", collector.blockLiveIn);
+    io.mapRequired("liveOut", collector.blockLiveOut);
+    io.mapRequired("regionSize", collector.regionSizes);
+    io.mapRequired("regionNesting", collector.regionNesting);
+    io.mapRequired("regionLoopDepth", collector.regionLoopDepths);
+    io.mapRequired("regionPaths", collector.regionPaths);
+    io.mapRequired("regionAlive", collector.regionAlive);
+    for (std::map<std::string, std::vector<int> >::iterator
+             iter = collector.classLiveness.begin(),
+             end = collector.classLiveness.end();
+         iter != end; ++iter) {
+      io.mapRequired(iter->first.c_str(), iter->second);
+    }
+    for (std::map<std::string, float>::iterator
+             iter = collector.dynamicInstTypes.begin(),
+             end = collector.dynamicInstTypes.end();
+         iter != end; ++iter) {
+      io.mapRequired(iter->first.c_str(), iter->second);
+    }
+    io.mapRequired("typedInsts", collector.typedInsts);
+  }
+};
+
+//------------------------------------------------------------------------------
+// Histogram with arbitrary keys, only written.
+template <> struct MappingTraits<std::map<std::string, int> > {
+  static void mapping(IO &io, std::map<std::string, int> &histogram) {
+    for (std::map<std::string, int>::iterator iter = histogram.begin(),
+                                              end = histogram.end();
+         iter != end; ++iter) {
+      io.mapRequired(iter->first.c_str(), iter->second);
+    }
   }
 };
 
@@ -131,7 +194,7 @@ template <> struct SequenceTraits<std::vector<std::pair<float, float> > > {
 }
 
 //------------------------------------------------------------------------------
-FeatureCollector::FeatureCollector() {
+FeatureCollector::FeatureCollector() : computeCycles(0) {
 // Instruction-specific counters.
 #define HANDLE_INST(N, OPCODE, CLASS) instTypes[#OPCODE] = 0;
 #include "llvm/IR/Instruction.def"
@@ -148,9 +211,16 @@ FeatureCollector::FeatureCollector() {
   instTypes["fps"] = 0;
   instTypes["vector2"] = 0;
   instTypes["vector4"] = 0;
+  instTypes["vector8"] = 0;
+  instTypes["vector16"] = 0;
+  instTypes["globalLoads"] = 0;
+  instTypes["globalStores"] = 0;
+  instTypes["computeCycles"] = 0;
   instTypes["vectorOperands"] = 0;
   instTypes["localLoads"] = 0;
   instTypes["localStores"] = 0;
+  instTypes["localMemoryBytes"] = 0;
+  instTypes["localMemoryUnboundArgs"] = 0;
   instTypes["mathFunctions"] = 0;
   instTypes["barriers"] = 0;
   instTypes["args"] = 0;
@@ -158,6 +228,38 @@ FeatureCollector::FeatureCollector() {
   instTypes["divInsts"] = 0;
   instTypes["divRegionInsts"] = 0;
   instTypes["uniformLoads"] = 0;
+  instTypes["maxLoopDepth"] = 0;
+  instTypes["maxDivNesting"] = 0;
+  instTypes["outermostDivRegions"] = 0;
+  instTypes["i8Insts"] = 0;
+  instTypes["i16Insts"] = 0;
+  instTypes["i32Insts"] = 0;
+  instTypes["i64Insts"] = 0;
+  instTypes["f16Insts"] = 0;
+  instTypes["f32Insts"] = 0;
+  instTypes["f64Insts"] = 0;
+  instTypes["maxLive"] = 0;
+  instTypes["maxLiveRegisters"] = 0;
+  for (int index = 0; index < RegisterPressure::RegisterClassNumber; ++index) {
+    std::string name = RegisterPressure::getClassName(
+        (RegisterPressure::RegisterClass)index);
+    instTypes["maxLive" + name] = 0;
+  }
+
+  // Dynamic counters.
+#define HANDLE_INST(N, OPCODE, CLASS) dynamicInstTypes["dynamic" #OPCODE] = 0;
+#include "llvm/IR/Instruction.def"
+  const char *dynamicCounters[] = {
+    "insts",    "localLoads", "localStores", "mathFunctions",
+    "barriers", "i8Insts",    "i16Insts",    "i32Insts",
+    "i64Insts", "f16Insts",   "f32Insts",    "f64Insts",
+    "globalLoads", "globalStores", "computeCycles"
+  };
+  for (unsigned int index = 0;
+       index < sizeof(dynamicCounters) / sizeof(dynamicCounters[0]);
+       ++index) {
+    dynamicInstTypes[getDynamicName(dynamicCounters[index])] = 0;
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -188,6 +290,21 @@ void FeatureCollector::countInstsBlock(const BasicBlock &block) {
   blockInsts.push_back(static_cast<int>(block.getInstList().size()));
 }
 
+//------------------------------------------------------------------------------
+void FeatureCollector::countOpcodes(const BasicBlock &block) {
+  for (BasicBlock::const_iterator iter = block.begin(), end = block.end();
+       iter != end; ++iter) {
+    switch (iter->getOpcode()) {
+#define HANDLE_INST(N, OPCODE, CLASS)                                          \
+  case N:                                                                      \
+    safeIncrement(instTypes, #OPCODE);                                         \
+    break;
+#include "llvm/IR/Instruction.def"
+    }
+    safeIncrement(instTypes, "insts");
+  }
+}
+
 //------------------------------------------------------------------------------
 void FeatureCollector::countEdges(const Function &function) {
   int edges = 0;
@@ -245,6 +362,25 @@ void FeatureCollector::countPhis(const BasicBlock &block) {
   blockPhis[block.getName()] = names;
 }
 
+//------------------------------------------------------------------------------
+std::vector<int> FeatureCollector::countPhiArgs() {
+  std::vector<int> args;
+  for (std::map<std::string, std::vector<std::string> >::iterator
+           iter = blockPhis.begin(),
+           end = blockPhis.end();
+       iter != end; ++iter) {
+    std::vector<std::string> &phis = iter->second;
+    int argSum = 0;
+    for (std::vector<std::string>::iterator phiIter = phis.begin(),
+                                            phiEnd = phis.end();
+         phiIter != phiEnd; ++phiIter) {
+      argSum += phiArgs[*phiIter];
+    }
+    args.push_back(argSum);
+  }
+  return args;
+}
+
 //------------------------------------------------------------------------------
 void FeatureCollector::countConstants(const BasicBlock &block) {
   int fourB = instTypes["fourB"];
@@ -310,20 +446,89 @@ void FeatureCollector::countMathFunctions(const BasicBlock &block) {
 
 //------------------------------------------------------------------------------
 void FeatureCollector::countLocalMemoryUsage(const BasicBlock &block) {
+  unsigned int localAddressSpace = getDeviceProfile().localAddressSpace;
   for (BasicBlock::const_iterator iter = block.begin(), end = block.end();
        iter != end; ++iter) {
     const Instruction *inst = iter;
     if (const LoadInst *loadInst = dyn_cast<LoadInst>(inst)) {
-      if (loadInst->getPointerAddressSpace() == OCLEnv::LOCAL_AS)
+      if (loadInst->getPointerAddressSpace() == localAddressSpace)
         safeIncrement(instTypes, "localLoads");
     }
     if (const StoreInst *storeInst = dyn_cast<StoreInst>(inst)) {
-      if (storeInst->getPointerAddressSpace() == OCLEnv::LOCAL_AS)
+      if (storeInst->getPointerAddressSpace() == localAddressSpace)
         safeIncrement(instTypes, "localStores");
     }
   }
 }
 
+//------------------------------------------------------------------------------
+void FeatureCollector::countTypedInsts(const BasicBlock &block) {
+  const DeviceProfile &device = getDeviceProfile();
+  float cycles = 0;
+  for (BasicBlock::const_iterator iter = block.begin(), end = block.end();
+       iter != end; ++iter) {
+    const Instruction *inst = iter;
+    cycles += device.getIssueCost(inst);
+
+    Type *type = inst->getType();
+    std::string key = getOpcodeName(inst->getOpcode());
+    if (const LoadInst *load = dyn_cast<LoadInst>(inst)) {
+      unsigned int addressSpace = load->getPointerAddressSpace();
+      key += "." + getAddressSpaceName(addressSpace);
+      if (addressSpace == device.globalAddressSpace)
+        safeIncrement(instTypes, "globalLoads");
+    } else if (const StoreInst *store = dyn_cast<StoreInst>(inst)) {
+      unsigned int addressSpace = store->getPointerAddressSpace();
+      key += "." + getAddressSpaceName(addressSpace);
+      type = store->getValueOperand()->getType();
+      if (addressSpace == device.globalAddressSpace)
+        safeIncrement(instTypes, "globalStores");
+    } else if (const CmpInst *cmp = dyn_cast<CmpInst>(inst)) {
+      type = cmp->getOperand(0)->getType();
+    } else if (const CallInst *call = dyn_cast<CallInst>(inst)) {
+      const Function *callee = call->getCalledFunction();
+      if (callee != NULL && isMathName(callee->getName()))
+        key += "." + getBuiltinName(callee->getName());
+    }
+
+    std::string typeName = getTypeName(type);
+    if (!typeName.empty())
+      key += "." + typeName;
+    safeIncrement(typedInsts, key);
+
+    if (type->isVectorTy()) {
+      std::stringstream vectorKey;
+      vectorKey << "vector" << type->getVectorNumElements();
+      if (instTypes.count(vectorKey.str()) != 0)
+        safeIncrement(instTypes, vectorKey.str());
+    }
+  }
+
+  computeCycles += cycles;
+}
+
+//------------------------------------------------------------------------------
+void FeatureCollector::countLocalMemorySize(const Function &function) {
+  unsigned int unboundArgs = 0;
+  instTypes["localMemoryBytes"] = getLocalMemorySize(&function, unboundArgs);
+  instTypes["localMemoryUnboundArgs"] = unboundArgs;
+}
+
+//------------------------------------------------------------------------------
+void FeatureCollector::countTypeMix(const BasicBlock &block) {
+  for (BasicBlock::const_iterator iter = block.begin(), end = block.end();
+       iter != end; ++iter) {
+    countTypeMix(*iter);
+  }
+}
+
+//------------------------------------------------------------------------------
+void FeatureCollector::countTypeMix(const Instruction &inst) {
+  std::string typeName = getScalarTypeName(getDataType(&inst));
+  if (typeName != "")
+    safeIncrement(instTypes, typeName + "Insts");
+}
+
 //------------------------------------------------------------------------------
 void FeatureCollector::countDivInsts(Function &function,
                                      MultiDimDivAnalysis *mdda,
@@ -357,6 +562,59 @@ void FeatureCollector::countArgs(const Function &function) {
   instTypes["args"] = function.arg_size();
 }
 
+//------------------------------------------------------------------------------
+void FeatureCollector::countDivRegionStructure(const Function &function,
+                                               MultiDimDivAnalysis *mdda,
+                                               LoopInfo *loopInfo,
+                                               bool loopsOnly) {
+  int maxLoopDepth = 0;
+  for (Function::const_iterator block = function.begin(), end = function.end();
+       block != end; ++block) {
+    maxLoopDepth =
+        std::max(maxLoopDepth, (int)loopInfo->getLoopDepth(block));
+  }
+  instTypes["maxLoopDepth"] = maxLoopDepth;
+
+  RegionVector &regions = mdda->getDivRegions();
+  int maxNesting = 0;
+  for (RegionVector::iterator iter = regions.begin(), iterEnd = regions.end();
+       iter != iterEnd; ++iter) {
+    DivergentRegion *region = *iter;
+    if (loopsOnly && !isInLoop(region->getHeader(), loopInfo))
+      continue;
+
+    // The regions containing this one, plus itself.
+    int nesting = 1;
+    for (RegionVector::iterator outer = regions.begin(),
+                                outerEnd = regions.end();
+         outer != outerEnd; ++outer) {
+      if (*outer != region && containsInternally(**outer, region))
+        ++nesting;
+    }
+    maxNesting = std::max(maxNesting, nesting);
+
+    std::map<const BasicBlock *, float> paths;
+    region->findAliveValues();
+
+    regionSizes.push_back(region->size());
+    regionNesting.push_back(nesting);
+    regionLoopDepths.push_back(loopInfo->getLoopDepth(region->getHeader()));
+    regionPaths.push_back(
+        countPaths(region->getHeader(), *region, loopInfo, paths));
+    regionAlive.push_back(region->getAlive().size());
+  }
+  instTypes["maxDivNesting"] = maxNesting;
+
+  int outermostRegions = 0;
+  RegionVector &outermost = mdda->getOutermostDivRegions();
+  for (RegionVector::iterator iter = outermost.begin(),
+                              iterEnd = outermost.end();
+       iter != iterEnd; ++iter) {
+    outermostRegions += !loopsOnly || isInLoop((*iter)->getHeader(), loopInfo);
+  }
+  instTypes["outermostDivRegions"] = outermostRegions;
+}
+
 //------------------------------------------------------------------------------
 int computeLiveRange(Instruction *inst) {
   Instruction *lastUser = findLastUser(inst);
@@ -364,8 +622,11 @@ int computeLiveRange(Instruction *inst) {
   if (lastUser == NULL)
     return inst->getParent()->size();
 
-  assert(lastUser->getParent() == inst->getParent() &&
-         "Different basic blocks");
+  // A user in another block keeps the value alive up to the end of the
+  // block.
+  if (lastUser->getParent() != inst->getParent())
+    return std::distance(BasicBlock::iterator(inst),
+                         inst->getParent()->end());
 
   BasicBlock::iterator begin(inst), end(lastUser);
 
@@ -396,6 +657,108 @@ void FeatureCollector::livenessAnalysis(BasicBlock &block) {
   aliveOutBlocks.push_back(aliveValues);
 }
 
+//------------------------------------------------------------------------------
+void FeatureCollector::computeRegisterPressure(Function &function,
+                                               LoopInfo *loopInfo) {
+  RegisterPressure pressure(function);
+
+  for (Function::iterator iter = function.begin(), end = function.end();
+       iter != end; ++iter) {
+    BasicBlock *block = iter;
+    if (loopInfo != NULL && !isInLoop(block, loopInfo))
+      continue;
+
+    std::vector<int> liveIn = pressure.getLiveIn(block);
+    std::vector<int> liveOut = pressure.getLiveOut(block);
+    std::vector<int> maxLive = pressure.getMaxLive(block);
+    blockLiveIn.push_back(std::accumulate(liveIn.begin(), liveIn.end(), 0));
+    blockLiveOut.push_back(std::accumulate(liveOut.begin(), liveOut.end(), 0));
+
+    for (int index = 0; index < RegisterPressure::RegisterClassNumber;
+         ++index) {
+      std::string name = RegisterPressure::getClassName(
+          (RegisterPressure::RegisterClass)index);
+      classLiveness["liveIn" + name].push_back(liveIn[index]);
+      classLiveness["liveOut" + name].push_back(liveOut[index]);
+      instTypes["maxLive" + name] =
+          std::max(instTypes["maxLive" + name], maxLive[index]);
+    }
+
+    instTypes["maxLive"] =
+        std::max(instTypes["maxLive"], pressure.getMaxLiveValues(block));
+    instTypes["maxLiveRegisters"] = std::max(
+        instTypes["maxLiveRegisters"], pressure.getMaxLiveRegisters(block));
+  }
+}
+
+//------------------------------------------------------------------------------
+void FeatureCollector::computeTripCounts(Function &function,
+                                         LoopInfo *loopInfo,
+                                         ScalarEvolution *scalarEvolution,
+                                         NDRange *ndr) {
+  NDRangeSpace ndrSpace = getCommandLineNDRangeSpace();
+  OCLEnv ocl(function, ndr, ndrSpace);
+  SubscriptAnalysis subscripts(scalarEvolution, &ocl,
+                               Warp(0, 0, 0, 0, ndrSpace));
+
+  // Outer loops come first: the iterations of the enclosing loops are known
+  // when a loop is evaluated.
+  std::vector<Loop *> worklist(loopInfo->begin(), loopInfo->end());
+  while (!worklist.empty()) {
+    Loop *loop = worklist.back();
+    worklist.pop_back();
+
+    SCEVProgram::IterationMap iterations;
+    for (const Loop *parent = loop->getParentLoop(); parent != NULL;
+         parent = parent->getParentLoop()) {
+      iterations[parent] = (int64_t)tripCounts[parent] / 2;
+    }
+
+    std::vector<int> counts = subscripts.getTripCounts(loop, iterations);
+    double sum = std::accumulate(counts.begin(), counts.end(), 0.0);
+    tripCounts[loop] = counts.empty() ? 0 : sum / counts.size();
+
+    worklist.insert(worklist.end(), loop->begin(), loop->end());
+  }
+}
+
+//------------------------------------------------------------------------------
+void FeatureCollector::countDynamicInsts(Function &function,
+                                         LoopInfo *loopInfo, bool loopsOnly) {
+  for (Function::iterator iter = function.begin(), end = function.end();
+       iter != end; ++iter) {
+    BasicBlock *block = iter;
+    if (loopsOnly && !isInLoop(block, loopInfo))
+      continue;
+
+    float weight = 1;
+    for (const Loop *loop = loopInfo->getLoopFor(block); loop != NULL;
+         loop = loop->getParentLoop()) {
+      weight *= tripCounts[loop];
+    }
+
+    FeatureCollector blockCollector;
+    blockCollector.countOpcodes(*block);
+    blockCollector.countTypeMix(*block);
+    blockCollector.countLocalMemoryUsage(*block);
+    blockCollector.countMathFunctions(*block);
+    blockCollector.countBarriers(*block);
+    blockCollector.countTypedInsts(*block);
+
+    for (std::map<std::string, int>::iterator
+             counter = blockCollector.instTypes.begin(),
+             counterEnd = blockCollector.instTypes.end();
+         counter != counterEnd; ++counter) {
+      std::map<std::string, float>::iterator dynamicCounter =
+          dynamicInstTypes.find(getDynamicName(counter->first));
+      if (dynamicCounter != dynamicInstTypes.end())
+        dynamicCounter->second += weight * counter->second;
+    }
+    dynamicInstTypes[getDynamicName("computeCycles")] +=
+        weight * blockCollector.computeCycles;
+  }
+}
+
 ////------------------------------------------------------------------------------
 //void FeatureCollector::countDimensions(NDRange *NDR) {
 //  InstVector dir0 = NDR->getTids(0);
@@ -414,6 +777,167 @@ void FeatureCollector::dump() {
   yout << *this;
 }
 
+//------------------------------------------------------------------------------
+bool FeatureCollector::isAnalyzed(const Function &function,
+                                  const std::string &kernelName) {
+  if (AllKernelsCL)
+    return isKernel(&function);
+  return function.getName() == kernelName;
+}
+
+//------------------------------------------------------------------------------
+std::string FeatureCollector::getModuleName(const Function &function) {
+  if (!FeatureModuleCL.empty())
+    return FeatureModuleCL;
+  return function.getParent()->getModuleIdentifier();
+}
+
+//------------------------------------------------------------------------------
+void FeatureCollector::output(const Function &function, FeatureTable &table) {
+  if (FeatureTableCL.empty() && FeatureColumnsCL.empty()) {
+    dump();
+    return;
+  }
+
+  table.addRow(getModuleName(function), function.getName(),
+               FeatureConfigurationCL, getFeatureValues());
+}
+
+//------------------------------------------------------------------------------
+void FeatureCollector::writeTable(const FeatureTable &table) {
+  if (table.getRowNumber() == 0)
+    return;
+
+  std::string error;
+  if (!FeatureTableCL.empty() && !table.appendCSV(FeatureTableCL, error))
+    report_fatal_error("Cannot write " + FeatureTableCL + ": " + error);
+  if (!FeatureColumnsCL.empty() &&
+      !table.appendColumnar(FeatureColumnsCL, error))
+    report_fatal_error("Cannot write " + FeatureColumnsCL + ": " + error);
+}
+
+//------------------------------------------------------------------------------
+std::vector<std::string> FeatureCollector::getFeatureNames() {
+  // The counters are the ones every collector starts with.
+  FeatureCollector collector;
+  std::vector<std::string> names;
+  for (std::map<std::string, int>::iterator
+           iter = collector.instTypes.begin(),
+           end = collector.instTypes.end();
+       iter != end; ++iter) {
+    names.push_back(iter->first);
+  }
+  for (std::map<std::string, float>::iterator
+           iter = collector.dynamicInstTypes.begin(),
+           end = collector.dynamicInstTypes.end();
+       iter != end; ++iter) {
+    names.push_back(iter->first);
+  }
+
+  unsigned int blockFeatureNumber =
+      sizeof(BLOCK_FEATURES) / sizeof(BLOCK_FEATURES[0]);
+  for (unsigned int index = 0; index < blockFeatureNumber; ++index) {
+    names.push_back(std::string(BLOCK_FEATURES[index]) + "Mean");
+    names.push_back(std::string(BLOCK_FEATURES[index]) + "Max");
+  }
+
+  return names;
+}
+
+//------------------------------------------------------------------------------
+// Mean and maximum of a per block feature.
+template <typename dataType>
+void summarize(const std::vector<dataType> &elements,
+               std::vector<float> &values) {
+  float sum = 0;
+  float max = 0;
+  for (typename std::vector<dataType>::const_iterator iter = elements.begin(),
+                                                      end = elements.end();
+       iter != end; ++iter) {
+    sum += *iter;
+    max = std::max(max, (float)*iter);
+  }
+
+  values.push_back(elements.empty() ? 0 : sum / elements.size());
+  values.push_back(max);
+}
+
+//------------------------------------------------------------------------------
+std::vector<float> FeatureCollector::getFeatureValues() {
+  FeatureCollector collector;
+  std::vector<float> values;
+  for (std::map<std::string, int>::iterator
+           iter = collector.instTypes.begin(),
+           end = collector.instTypes.end();
+       iter != end; ++iter) {
+    values.push_back(instTypes[iter->first]);
+  }
+  for (std::map<std::string, float>::iterator
+           iter = collector.dynamicInstTypes.begin(),
+           end = collector.dynamicInstTypes.end();
+       iter != end; ++iter) {
+    values.push_back(dynamicInstTypes[iter->first]);
+  }
+
+  // Same order as BLOCK_FEATURES.
+  summarize(blockInsts, values);
+  summarize(countPhiArgs(), values);
+  summarize(blockILP, values);
+  summarize(blockMLP, values);
+  summarize(avgLiveRange, values);
+  summarize(aliveOutBlocks, values);
+  summarize(blockLiveIn, values);
+  summarize(blockLiveOut, values);
+  summarize(regionSizes, values);
+  summarize(regionNesting, values);
+  summarize(regionLoopDepths, values);
+  summarize(regionPaths, values);
+  summarize(regionAlive, values);
+
+  return values;
+}
+
+//------------------------------------------------------------------------------
+void FeatureCollector::collect(Function &function, DominatorTree *dt,
+                               PostDominatorTree *pdt,
+                               MultiDimDivAnalysis *mdda,
+                               SingleDimDivAnalysis *sdda, LoopInfo *loopInfo,
+                               ScalarEvolution *scalarEvolution,
+                               NDRange *ndr) {
+  countBranches(function);
+  countEdges(function);
+  countDivInsts(function, mdda, sdda);
+  countArgs(function);
+  countDivRegionStructure(function, mdda, loopInfo, false);
+  countLocalMemorySize(function);
+  computeRegisterPressure(function, NULL);
+  computeTripCounts(function, loopInfo, scalarEvolution, ndr);
+  countDynamicInsts(function, loopInfo, false);
+
+  for (Function::iterator iter = function.begin(), end = function.end();
+       iter != end; ++iter) {
+    BasicBlock *block = iter;
+    instTypes["blocks"] += 1;
+    countOpcodes(*block);
+    computeILP(block);
+    computeMLP(block, dt, pdt);
+    countInstsBlock(*block);
+    countConstants(*block);
+    countBarriers(*block);
+    countMathFunctions(*block);
+    countOutgoingEdges(*block);
+    countIncomingEdges(*block);
+    countLocalMemoryUsage(*block);
+    countTypeMix(*block);
+    countTypedInsts(*block);
+    countPhis(*block);
+    livenessAnalysis(*block);
+  }
+
+  // The issue cost is rounded once for the whole kernel, not per block.
+  instTypes["computeCycles"] = (int)(computeCycles + 0.5f);
+}
+
 //------------------------------------------------------------------------------
 void FeatureCollector::loopCountEdges(const Function &function, LoopInfo *LI) {
   int edges = 0;
@@ -515,3 +1039,106 @@ void FeatureCollector::loopCountDivInsts(Function &function,
 
   instTypes["uniformLoads"] = uniformLoads;
 }
+
+//------------------------------------------------------------------------------
+// Name of the dynamic counter of a block counter: insts -> dynamicInsts.
+std::string getDynamicName(const std::string &name) {
+  std::string result = name;
+  if (!result.empty())
+    result[0] = toupper(result[0]);
+  return "dynamic" + result;
+}
+
+//------------------------------------------------------------------------------
+// Opcode as the instTypes counters name it: FMul, Load, ...
+std::string getOpcodeName(unsigned int opcode) {
+  switch (opcode) {
+#define HANDLE_INST(N, OPCODE, CLASS)                                          \
+  case N:                                                                      \
+    return #OPCODE;
+#include "llvm/IR/Instruction.def"
+  }
+  return "Unknown";
+}
+
+//------------------------------------------------------------------------------
+// Short name of a type: i32, f64, v4f32. Empty for void.
+std::string getTypeName(const Type *type) {
+  if (type->isVoidTy())
+    return "";
+  if (type->isPointerTy())
+    return "ptr";
+
+  std::string scalarName = getScalarTypeName(type->getScalarType());
+  if (scalarName.empty())
+    scalarName = "other";
+  if (!type->isVectorTy())
+    return scalarName;
+
+  std::stringstream stream;
+  stream << "v" << type->getVectorNumElements() << scalarName;
+  return stream.str();
+}
+
+//------------------------------------------------------------------------------
+std::string getAddressSpaceName(unsigned int addressSpace) {
+  const DeviceProfile &device = getDeviceProfile();
+  if (addressSpace == device.localAddressSpace)
+    return "local";
+  if (addressSpace == device.globalAddressSpace)
+    return "global";
+  if (addressSpace == device.constantAddressSpace)
+    return "constant";
+  return "private";
+}
+
+//------------------------------------------------------------------------------
+// Name of a builtin without the Itanium mangling: _Z4sqrtf -> sqrt.
+std::string getBuiltinName(const std::string &name) {
+  if (name.compare(0, 2, "_Z") != 0)
+    return name;
+
+  unsigned int position = 2;
+  unsigned int length = 0;
+  while (position < name.size() && isdigit(name[position])) {
+    length = length * 10 + (name[position] - '0');
+    ++position;
+  }
+  if (length == 0 || position + length > name.size())
+    return name;
+  return name.substr(position, length);
+}
+
+//------------------------------------------------------------------------------
+// Acyclic paths from block to the exiting block of the region. Back edges of
+// the loops in the region are not followed. Counts are floats: they grow
+// exponentially with the sequential branches.
+float countPaths(const BasicBlock *block, DivergentRegion &region,
+                 LoopInfo *loopInfo,
+                 std::map<const BasicBlock *, float> &paths) {
+  if (block == region.getExiting())
+    return 1;
+
+  std::map<const BasicBlock *, float>::iterator known = paths.find(block);
+  if (known != paths.end())
+    return known->second;
+  // Guard against cycles the loop information does not explain.
+  paths[block] = 0;
+
+  float result = 0;
+  for (succ_const_iterator iter = succ_begin(block), end = succ_end(block);
+       iter != end; ++iter) {
+    const BasicBlock *successor = *iter;
+    if (!contains(region, successor))
+      continue;
+
+    Loop *loop = loopInfo->getLoopFor(successor);
+    bool isBackEdge = loop != NULL && loop->getHeader() == successor &&
+                      loop->contains(block);
+    if (!isBackEdge)
+      result += countPaths(successor, region, loopInfo, paths);
+  }
+
+  paths[block] = result;
+  return result;
+}
@@ -16,7 +16,7 @@ static RegisterPass<OpenCLFeatureExtractor> X("opencl-instcount",
 
 //------------------------------------------------------------------------------
 bool OpenCLFeatureExtractor::runOnFunction(Function &function) {
-  if (function.getName() != kernelName)
+  if (!FeatureCollector::isAnalyzed(function, kernelName))
     return false;
 
   pdt = &getAnalysis<PostDominatorTree>();
@@ -24,9 +24,18 @@ bool OpenCLFeatureExtractor::runOnFunction(Function &function) {
   mdda = &getAnalysis<MultiDimDivAnalysis>();
   sdda = &getAnalysis<SingleDimDivAnalysis>();
   se = &getAnalysis<ScalarEvolution>();
+  li = &getAnalysis<LoopInfo>();
+  ndr = &getAnalysis<NDRange>();
  
-  visit(function);
-  collector.dump();
+  collector = FeatureCollector();
+  collector.collect(function, dt, pdt, mdda, sdda, li, se, ndr);
+  collector.output(function, table);
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool OpenCLFeatureExtractor::doFinalization(Module &module) {
+  FeatureCollector::writeTable(table);
   return false;
 }
 
@@ -37,46 +46,7 @@ void OpenCLFeatureExtractor::getAnalysisUsage(AnalysisUsage &au) const {
   au.addRequired<PostDominatorTree>();
   au.addRequired<DominatorTree>();
   au.addRequired<ScalarEvolution>();
+  au.addRequired<LoopInfo>();
+  au.addRequired<NDRange>();
   au.setPreservesAll();
 }
-
-//------------------------------------------------------------------------------
-// Count all instruction types.
-#define HANDLE_INST(N, OPCODE, CLASS)                                          \
-  void OpenCLFeatureExtractor::visit##OPCODE(CLASS &) {                        \
-    collector.instTypes[#OPCODE] += 1;                                         \
-    collector.instTypes["insts"] += 1;                                         \
-  }
-#include "llvm/IR/Instruction.def"
-
-//------------------------------------------------------------------------------
-void OpenCLFeatureExtractor::visitInstruction(Instruction &inst) {
-  errs() << "Unknown instruction: " << inst;
-  llvm_unreachable(0);
-}
-
-//------------------------------------------------------------------------------
-void OpenCLFeatureExtractor::visitBasicBlock(BasicBlock &basicBlock) {
-  BasicBlock *block = (BasicBlock *)&basicBlock;
-  collector.instTypes["blocks"] += 1;
-  collector.computeILP(block);
-  collector.computeMLP(block, dt, pdt);
-  collector.countInstsBlock(basicBlock);
-  collector.countConstants(basicBlock);
-  collector.countBarriers(basicBlock);
-  collector.countMathFunctions(basicBlock);
-  collector.countOutgoingEdges(basicBlock);
-  collector.countIncomingEdges(basicBlock);
-  collector.countLocalMemoryUsage(basicBlock);
-  collector.countPhis(basicBlock);
-  collector.livenessAnalysis(basicBlock);
-}
-
-//------------------------------------------------------------------------------
-void OpenCLFeatureExtractor::visitFunction(Function &function) {
-  // Extract ThreadId values. 
-  collector.countBranches(function);
-  collector.countEdges(function);
-  collector.countDivInsts(function, mdda, sdda);
-  collector.countArgs(function);
-}
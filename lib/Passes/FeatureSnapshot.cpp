@@ -0,0 +1,158 @@
+#include "thrud/FeatureExtraction/FeatureSnapshot.h"
+
+#include "thrud/DivergenceAnalysis/DivergenceAnalysis.h"
+
+#include "thrud/FeatureExtraction/FeatureCollector.h"
+
+#include "thrud/Support/NDRange.h"
+
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+
+using namespace llvm;
+
+extern cl::opt<std::string> FeatureTableCL;
+extern cl::opt<std::string> FeatureColumnsCL;
+extern cl::opt<std::string> FeatureConfigurationCL;
+
+static cl::opt<std::string>
+    snapshotKernelName("snapshot-kernel-name", cl::init(""), cl::Hidden,
+                       cl::desc("Name of the kernel to snapshot the features "
+                                "of"));
+
+char FeatureSnapshot::ID = 0;
+static RegisterPass<FeatureSnapshot>
+    X("feature-snapshot", "Compare the features of a kernel before and after "
+                          "a transformation", false, true);
+
+// Features recorded by the first snapshot of each kernel, by module and
+// kernel name. The two snapshots are different pass instances.
+static std::map<std::pair<std::string, std::string>, std::vector<float> >
+    snapshots;
+
+using yaml::MappingTraits;
+using yaml::IO;
+using yaml::Output;
+
+// A feature vector, mapped as name: value.
+struct FeatureValues {
+  const std::vector<std::string> *names;
+  std::vector<float> *values;
+};
+
+namespace llvm {
+namespace yaml {
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<FeatureValues> {
+  static void mapping(IO &io, FeatureValues &features) {
+    for (unsigned int index = 0; index < features.names->size(); ++index) {
+      io.mapRequired((*features.names)[index].c_str(),
+                     (*features.values)[index]);
+    }
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<FeatureSnapshot::Delta> {
+  static void mapping(IO &io, FeatureSnapshot::Delta &delta) {
+    FeatureValues before = { &delta.names, &delta.before };
+    FeatureValues after = { &delta.names, &delta.after };
+    FeatureValues difference = { &delta.names, &delta.delta };
+    io.mapRequired("kernel", delta.kernel);
+    io.mapRequired("configuration", delta.configuration);
+    io.mapRequired("before", before);
+    io.mapRequired("after", after);
+    io.mapRequired("delta", difference);
+  }
+};
+}
+}
+
+//------------------------------------------------------------------------------
+FeatureSnapshot::FeatureSnapshot()
+    : FunctionPass(ID), table(FeatureCollector::getFeatureNames()) {}
+
+//------------------------------------------------------------------------------
+bool FeatureSnapshot::runOnFunction(Function &function) {
+  if (!FeatureCollector::isAnalyzed(function, snapshotKernelName))
+    return false;
+
+  FeatureCollector collector;
+  collector.collect(function, &getAnalysis<DominatorTree>(),
+                    &getAnalysis<PostDominatorTree>(),
+                    &getAnalysis<MultiDimDivAnalysis>(),
+                    &getAnalysis<SingleDimDivAnalysis>(),
+                    &getAnalysis<LoopInfo>(),
+                    &getAnalysis<ScalarEvolution>(), &getAnalysis<NDRange>());
+
+  std::pair<std::string, std::string> key(
+      function.getParent()->getModuleIdentifier(), function.getName());
+  std::map<std::pair<std::string, std::string>, std::vector<float> >::iterator
+      snapshot = snapshots.find(key);
+
+  // First snapshot: record the features of the original kernel.
+  if (snapshot == snapshots.end()) {
+    snapshots[key] = collector.getFeatureValues();
+    return false;
+  }
+
+  Delta delta;
+  delta.kernel = function.getName();
+  delta.configuration = FeatureConfigurationCL;
+  delta.names = FeatureCollector::getFeatureNames();
+  delta.before = snapshot->second;
+  delta.after = collector.getFeatureValues();
+  for (unsigned int index = 0; index < delta.after.size(); ++index) {
+    delta.delta.push_back(delta.after[index] - delta.before[index]);
+  }
+  snapshots.erase(snapshot);
+
+  output(function, delta);
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool FeatureSnapshot::doFinalization(Module &module) {
+  FeatureCollector::writeTable(table);
+  return false;
+}
+
+//------------------------------------------------------------------------------
+void FeatureSnapshot::getAnalysisUsage(AnalysisUsage &au) const {
+  au.addRequired<MultiDimDivAnalysis>();
+  au.addRequired<SingleDimDivAnalysis>();
+  au.addRequired<PostDominatorTree>();
+  au.addRequired<DominatorTree>();
+  au.addRequired<ScalarEvolution>();
+  au.addRequired<LoopInfo>();
+  au.addRequired<NDRange>();
+  au.setPreservesAll();
+}
+
+//------------------------------------------------------------------------------
+void FeatureSnapshot::output(const Function &function, Delta &delta) {
+  if (FeatureTableCL.empty() && FeatureColumnsCL.empty()) {
+    Output yout(llvm::outs());
+    yout << delta;
+    return;
+  }
+
+  std::string module = FeatureCollector::getModuleName(function);
+  std::string prefix =
+      delta.configuration.empty() ? "" : delta.configuration + ":";
+  table.addRow(module, delta.kernel, prefix + "before", delta.before);
+  table.addRow(module, delta.kernel, prefix + "after", delta.after);
+  table.addRow(module, delta.kernel, prefix + "delta", delta.delta);
+}
@@ -1,88 +1,88 @@
 #include "thrud/FeatureExtraction/ILPComputation.h"
 
 #include "thrud/Support/DataTypes.h"
-#include "thrud/Support/Graph.h"
+#include "thrud/Support/Utils.h"
 
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Instructions.h"
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
-//------------------------------------------------------------------------------
-void buildGraph(BasicBlock *block, Graph<Instruction *> &graph) {
-  for (BasicBlock::iterator iter = block->begin(), end = block->end();
-       iter != end; ++iter) {
-    Instruction *inst = iter;
+#include <algorithm>
 
-    std::vector<Instruction *> operands;
-    // Get the instruction-operands belonging to the current block.
-    for (Instruction::op_iterator opIter = inst->op_begin(),
-                                  opEnd = inst->op_end();
-         opIter != opEnd; ++opIter) {
-      if (Instruction *opInst = dyn_cast<Instruction>(opIter)) {
-        if (opInst->getParent() == block)
-          graph.addEdge(inst, opInst);
-      }
-    }
-  }
-}
-
-//------------------------------------------------------------------------------
-InstVector getInsts(BasicBlock *block) {
-  InstVector result;
-  for (BasicBlock::iterator iter = block->begin(), end = block->end();
-       iter != end; ++iter) {
-    result.push_back(iter);
-  }
-  return result;
-}
+static cl::opt<bool>
+    latencyWeightedILP("ilp-latency", cl::init(false), cl::Hidden,
+                       cl::desc("Weight the ILP dependency chains with the "
+                                "latency of the instructions"));
 
 //------------------------------------------------------------------------------
-std::vector<unsigned int>
-getDephts(std::map<Instruction *, unsigned int> &inputMap, InstVector &insts) {
-
-  std::vector<unsigned int> result;
-  for (InstVector::iterator iter = insts.begin(), end = insts.end();
-       iter != end; ++iter) {
-    Instruction *inst = *iter;
-    result.push_back(inputMap[inst]);
+// Rough issue-to-result latency in cycles of the instructions of a GPU.
+unsigned int getLatency(Instruction *inst) {
+  switch (inst->getOpcode()) {
+  case Instruction::PHI:
+  case Instruction::BitCast:
+  case Instruction::PtrToInt:
+  case Instruction::IntToPtr:
+    return 0;
+  case Instruction::Mul:
+  case Instruction::FMul:
+  case Instruction::FAdd:
+  case Instruction::FSub:
+    return 4;
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+  case Instruction::FDiv:
+  case Instruction::FRem:
+    return 20;
+  case Instruction::Call:
+    return 16;
+  case Instruction::Load:
+  case Instruction::Store:
+    return isLocalMemoryAccess(inst) ? 32 : 400;
+  default:
+    return 1;
   }
-  return result;
 }
 
 //------------------------------------------------------------------------------
+// Depths are computed in a single pass in program order: the operands defined
+// in the block come before their users, except for the incoming values of the
+// phi nodes, which come from the previous iteration of a loop.
 float getILP(BasicBlock *block) {
-  InstVector insts = getInsts(block);
-  Graph<Instruction *> graph(insts);
-  buildGraph(block, graph);
-
   std::map<Instruction *, unsigned int> depths;
   unsigned int maxDepth = 0;
+  unsigned int totalLatency = 0;
 
-  for (InstVector::iterator iter = insts.begin(), end = insts.end();
+  for (BasicBlock::iterator iter = block->begin(), end = block->end();
        iter != end; ++iter) {
-    Instruction *inst = *iter;
-
-    InstVector outgoing = graph.getOutgoing(inst);
-    std::vector<unsigned int> currentDepths = getDephts(depths, outgoing);
+    Instruction *inst = iter;
+    unsigned int latency = latencyWeightedILP ? getLatency(inst) : 1;
 
-    // Get the max depth of the adjacent nodes.
-    std::vector<unsigned int>::iterator maxPosition =
-        std::max_element(currentDepths.begin(), currentDepths.end());
+    // Get the max depth of the operands defined in the block.
     unsigned int max = 0;
-    if (maxPosition != currentDepths.end()) {
-      max = *maxPosition;
+    if (!isa<PHINode>(inst)) {
+      for (Instruction::op_iterator opIter = inst->op_begin(),
+                                    opEnd = inst->op_end();
+           opIter != opEnd; ++opIter) {
+        Instruction *opInst = dyn_cast<Instruction>(opIter);
+        if (opInst == NULL || opInst->getParent() != block)
+          continue;
+        max = std::max(max, depths[opInst]);
+      }
     }
 
-    // Update the maxium depth reached so far.
-    unsigned int currentDepth = max + 1;
-    if (currentDepth > maxDepth)
-      maxDepth = currentDepth;
-
-    // Set the depth of the current instruction.
+    // Set the depth of the current instruction and update the maximum depth
+    // reached so far.
+    unsigned int currentDepth = max + latency;
     depths[inst] = currentDepth;
+    maxDepth = std::max(maxDepth, currentDepth);
+    totalLatency += latency;
   }
 
-  float ilp = (float) insts.size() / maxDepth;
-  return ilp;
+  if (maxDepth == 0)
+    return 1;
+  return (float)totalLatency / maxDepth;
 }
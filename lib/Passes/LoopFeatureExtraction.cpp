@@ -18,7 +18,7 @@ static RegisterPass<OpenCLLoopFeatureExtractor>
 
 //------------------------------------------------------------------------------
 bool OpenCLLoopFeatureExtractor::runOnFunction(Function &function) {
-  if (function.getName() != loopKernelName)
+  if (!FeatureCollector::isAnalyzed(function, loopKernelName))
     return false;
 
   PDT = &getAnalysis<PostDominatorTree>();
@@ -27,9 +27,19 @@ bool OpenCLLoopFeatureExtractor::runOnFunction(Function &function) {
   SDDA = &getAnalysis<SingleDimDivAnalysis>();
   LI = &getAnalysis<LoopInfo>();
   SE = &getAnalysis<ScalarEvolution>();
+  NDR = &getAnalysis<NDRange>();
 
+  collector = FeatureCollector();
   visit(function);
-  collector.dump();
+  // The issue cost is rounded once for all the loops, not per block.
+  collector.instTypes["computeCycles"] = (int)(collector.computeCycles + 0.5f);
+  collector.output(function, table);
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool OpenCLLoopFeatureExtractor::doFinalization(Module &module) {
+  FeatureCollector::writeTable(table);
   return false;
 }
 
@@ -80,6 +90,8 @@ void OpenCLLoopFeatureExtractor::visitBasicBlock(BasicBlock &basicBlock) {
   collector.countOutgoingEdges(basicBlock);
   collector.countIncomingEdges(basicBlock);
   collector.countLocalMemoryUsage(basicBlock);
+  collector.countTypeMix(basicBlock);
+  collector.countTypedInsts(basicBlock);
   collector.countPhis(basicBlock);
   collector.livenessAnalysis(basicBlock);
 }
@@ -92,4 +104,9 @@ void OpenCLLoopFeatureExtractor::visitFunction(Function &function) {
   collector.loopCountBranches(function, LI);
   collector.loopCountEdges(function, LI);
   collector.loopCountDivInsts(function, MDDA, SDDA, LI);
+  collector.countDivRegionStructure(function, MDDA, LI, true);
+  collector.countLocalMemorySize(function);
+  collector.computeRegisterPressure(function, LI);
+  collector.computeTripCounts(function, LI, SE, NDR);
+  collector.countDynamicInsts(function, LI, true);
 }
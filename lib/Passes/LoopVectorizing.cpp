@@ -0,0 +1,569 @@
+#include "thrud/ThreadVectorizing/ThreadVectorizing.h"
+
+#include "thrud/Support/Utils.h"
+
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include <algorithm>
+
+// Support functions.
+// -----------------------------------------------------------------------------
+Intrinsic::ID getIntrinsicIDForCall(CallInst *callInst);
+void appendUsers(Instruction *inst, InstVector &users);
+bool isIntegerDivision(const Instruction *inst);
+
+// Divergent loops are executed in vector form: every lane iterates until all
+// of them have taken the exit branch. An active-lane mask records which lanes
+// are still in the loop:
+// - the loop-carried phis are blended with the mask on the back edge, so lanes
+//   that left the loop keep the values of their last iteration;
+// - loads and stores are guarded by the mask lane by lane;
+// - values used after the loop are frozen lane by lane in an accumulator,
+//   select(mask, new, old), since each lane leaves the loop at a different
+//   iteration. The uniform instructions after the loop that depend on them
+//   are computed in vector form too.
+
+//------------------------------------------------------------------------------
+bool ThreadVectorizing::isMaskableLoop(DivergentRegion *region) {
+  BasicBlock *header = region->getHeader();
+  if (!loopInfo->isLoopHeader(header))
+    return false;
+
+  Loop *loop = loopInfo->getLoopFor(header);
+  BasicBlock *exiting = loop->getExitingBlock();
+  if (exiting == NULL || loop->getLoopPredecessor() == NULL ||
+      !loop->hasDedicatedExits())
+    return false;
+
+  // The exit test must be at the top or at the bottom of the loop.
+  if (exiting != header && exiting != loop->getLoopLatch())
+    return false;
+
+  if (loop->getExitBlock() != region->getExiting())
+    return false;
+
+  // Nested divergent regions are not supported.
+  if (!sdda->getDivRegions(region, 0).empty())
+    return false;
+
+  for (Loop::block_iterator blockIter = loop->block_begin(),
+                            blockEnd = loop->block_end();
+       blockIter != blockEnd; ++blockIter) {
+    BasicBlock *block = *blockIter;
+    for (BasicBlock::iterator iter = block->begin(), iterEnd = block->end();
+         iter != iterEnd; ++iter) {
+      Instruction *inst = iter;
+
+      if (isBarrier(inst))
+        return false;
+
+      if (!sdda->isDivergent(inst))
+        continue;
+
+      // The only divergent branch must be the exit test.
+      if (isa<BranchInst>(inst) && inst != exiting->getTerminator())
+        return false;
+
+      // Only intrinsic calls can be vectorized.
+      if (CallInst *call = dyn_cast<CallInst>(inst))
+        if (getIntrinsicIDForCall(call) == Intrinsic::not_intrinsic)
+          return false;
+
+      // Lanes that left the loop still compute the body with the values of
+      // their exit iteration: a divergent divisor can be zero for them.
+      if (isIntegerDivision(inst)) {
+        Instruction *divisor = dyn_cast<Instruction>(inst->getOperand(1));
+        if (divisor != NULL && sdda->isDivergent(divisor))
+          return false;
+      }
+    }
+  }
+
+  InstVector liveOuts;
+  InstVector users;
+  return findLiveOutChains(loop, liveOuts, users);
+}
+
+//------------------------------------------------------------------------------
+void ThreadVectorizing::vectorizeLoop(DivergentRegion *region) {
+  BasicBlock *header = region->getHeader();
+  Loop *loop = loopInfo->getLoopFor(header);
+  BasicBlock *exiting = loop->getExitingBlock();
+  BasicBlock *latch = loop->getLoopLatch();
+  BranchInst *branch = cast<BranchInst>(exiting->getTerminator());
+
+  // All the lanes enter the loop.
+  Type *maskType = VectorType::get(irBuilder->getInt1Ty(), width);
+  loopMask = PHINode::Create(maskType, 2, "active_mask", header->begin());
+  loopMask->addIncoming(Constant::getAllOnesValue(maskType),
+                        loop->getLoopPredecessor());
+
+  // Vectorize the divergent instructions of the region, memory accesses are
+  // guarded later on.
+  InstVector memoryInsts;
+  InstVector &divInsts = sdda->getDivInsts();
+  for (InstVector::iterator iter = divInsts.begin(), iterEnd = divInsts.end();
+       iter != iterEnd; ++iter) {
+    Instruction *inst = *iter;
+    if (!contains(*region, inst) || isa<BranchInst>(inst))
+      continue;
+
+    // The phis of the exit block take the frozen values.
+    if (PHINode *phi = dyn_cast<PHINode>(inst))
+      if (liveOutPhis.count(phi))
+        continue;
+
+    // Induction variables stay scalar.
+    if (affineOffsets.count(inst))
+      continue;
+
+    // The exit block is in the region, but all the lanes execute it.
+    if ((isa<LoadInst>(inst) || isa<StoreInst>(inst)) && loop->contains(inst)) {
+      memoryInsts.push_back(inst);
+      continue;
+    }
+
+    setInsertPoint(inst);
+    Value *vectorResult = vectorizeInst(inst);
+    if (NULL != vectorResult) {
+      vectorMap[inst] = vectorResult;
+      toRemoveInsts.insert(inst);
+    }
+  }
+
+  vectorizeLoopBranch(branch);
+  loopMask->addIncoming(nextLoopMask, latch);
+
+  for (std::map<PHINode *, Instruction *>::iterator
+           iter = liveOutPhis.begin(),
+           iterEnd = liveOutPhis.end();
+       iter != iterEnd; ++iter) {
+    if (!loop->contains(iter->second))
+      continue;
+    vectorMap[iter->first] = freezeLiveOut(iter->second, loop);
+    toRemoveInsts.insert(iter->first);
+  }
+
+  // Blend all the vector phis of the header.
+  for (BasicBlock::iterator iter = header->begin(); isa<PHINode>(iter);
+       ++iter) {
+    PHINode *phi = cast<PHINode>(iter);
+    if (phi != loopMask && vectorMap.count(phi) && !affineOffsets.count(phi))
+      blendedPhis[phi] = nextLoopMask;
+  }
+
+  // Instructions in the header before the exit test run for the lanes that
+  // entered the iteration, the remaining ones for the lanes that passed it.
+  for (InstVector::iterator iter = memoryInsts.begin(),
+                            iterEnd = memoryInsts.end();
+       iter != iterEnd; ++iter) {
+    Instruction *inst = *iter;
+    Value *mask = loopMask;
+    if (exiting == header && inst->getParent() != header)
+      mask = nextLoopMask;
+    maskedInsts.push_back(std::make_pair(inst, mask));
+  }
+
+  loopMask = NULL;
+  nextLoopMask = NULL;
+}
+
+//------------------------------------------------------------------------------
+bool ThreadVectorizing::findLiveOutChains(Loop *loop, InstVector &liveOuts,
+                                          InstVector &users) {
+  BasicBlock *exit = loop->getExitBlock();
+  InstVector worklist;
+
+  // Seeds: values of the loop used outside of it. The phis of the exit block
+  // are closing the loop, their users depend on the live-out values as well.
+  for (Loop::block_iterator blockIter = loop->block_begin(),
+                            blockEnd = loop->block_end();
+       blockIter != blockEnd; ++blockIter) {
+    BasicBlock *block = *blockIter;
+    for (BasicBlock::iterator iter = block->begin(), iterEnd = block->end();
+         iter != iterEnd; ++iter) {
+      Instruction *inst = iter;
+      bool isLiveOut = false;
+      for (Value::use_iterator useIter = inst->use_begin(),
+                               useEnd = inst->use_end();
+           useIter != useEnd; ++useIter) {
+        Instruction *user = dyn_cast<Instruction>(*useIter);
+        if (user == NULL || loop->contains(user))
+          continue;
+
+        isLiveOut = true;
+        if (isa<PHINode>(user) && user->getParent() == exit)
+          appendUsers(user, worklist);
+        else
+          worklist.push_back(user);
+      }
+
+      if (isLiveOut)
+        liveOuts.push_back(inst);
+    }
+  }
+
+  // Follow the uniform users: they are different for each lane too.
+  // Divergent users are vectorized anyway, and so are their users.
+  InstSet visited;
+  while (!worklist.empty()) {
+    Instruction *inst = worklist.back();
+    worklist.pop_back();
+
+    if (sdda->isDivergent(inst) || !visited.insert(inst).second)
+      continue;
+
+    if (isa<TerminatorInst>(inst) || isBarrier(inst) ||
+        inst->getType()->isVectorTy())
+      return false;
+    if (CallInst *call = dyn_cast<CallInst>(inst))
+      if (getIntrinsicIDForCall(call) == Intrinsic::not_intrinsic)
+        return false;
+
+    // Divergent regions after the loop are replicated in scalar form.
+    RegionVector &regions = sdda->getDivRegions();
+    for (RegionVector::iterator iter = regions.begin(), iterEnd = regions.end();
+         iter != iterEnd; ++iter) {
+      if (inst->getParent() != exit && contains(**iter, inst))
+        return false;
+    }
+
+    users.push_back(inst);
+    appendUsers(inst, worklist);
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ThreadVectorizing::createLiveOutPhis(Loop *loop, InstVector &liveOuts) {
+  BasicBlock *exit = loop->getExitBlock();
+  BasicBlock *exiting = loop->getExitingBlock();
+
+  for (InstVector::iterator iter = liveOuts.begin(), iterEnd = liveOuts.end();
+       iter != iterEnd; ++iter) {
+    Instruction *inst = *iter;
+
+    // Copy the users: the uses are going to be changed.
+    std::vector<User *> users(inst->use_begin(), inst->use_end());
+    PHINode *closingPhi = NULL;
+    for (std::vector<User *>::iterator userIter = users.begin(),
+                                       userEnd = users.end();
+         userIter != userEnd; ++userIter) {
+      Instruction *user = dyn_cast<Instruction>(*userIter);
+      if (user == NULL || loop->contains(user))
+        continue;
+
+      // The exit block has the exiting block as its only predecessor: its
+      // phis are already closing the loop.
+      if (isa<PHINode>(user) && user->getParent() == exit) {
+        liveOutPhis[cast<PHINode>(user)] = inst;
+        promotedInsts.insert(user);
+        continue;
+      }
+
+      if (closingPhi == NULL) {
+        closingPhi = PHINode::Create(inst->getType(), 1,
+                                     inst->getName() + ".lcssa", exit->begin());
+        closingPhi->addIncoming(inst, exiting);
+        liveOutPhis[closingPhi] = inst;
+        promotedInsts.insert(closingPhi);
+      }
+      user->replaceUsesOfWith(inst, closingPhi);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+Value *ThreadVectorizing::freezeLiveOut(Instruction *inst, Loop *loop) {
+  assert(loopMask != NULL && "Missing active-lane mask");
+  if (frozenValues.count(inst))
+    return frozenValues[inst];
+
+  BasicBlock *header = loop->getHeader();
+  BasicBlock *exiting = loop->getExitingBlock();
+  Type *vectorType = VectorType::get(inst->getType(), width);
+
+  PHINode *accumulator =
+      PHINode::Create(vectorType, 2, inst->getName() + ".frozen",
+                      header->begin());
+  accumulator->addIncoming(UndefValue::get(vectorType),
+                           loop->getLoopPredecessor());
+
+  // A live-out value dominates the exiting block. There, the lanes in the
+  // mask have just computed it: all of them if the test is at the bottom of
+  // the loop, the ones that entered the header if it is at the top.
+  Value *vectorValue = getVectorValue(inst);
+  irBuilder->SetInsertPoint(exiting->getTerminator());
+  Value *frozen = irBuilder->CreateSelect(loopMask, vectorValue, accumulator,
+                                          inst->getName() + ".frozen.next");
+  accumulator->addIncoming(frozen, loop->getLoopLatch());
+
+  frozenValues[inst] = frozen;
+  return frozen;
+}
+
+//------------------------------------------------------------------------------
+BranchInst *ThreadVectorizing::vectorizeLoopBranch(BranchInst *branch) {
+  assert(loopMask != NULL && "Missing active-lane mask");
+  Loop *loop = loopInfo->getLoopFor(branch->getParent());
+
+  irBuilder->SetInsertPoint(branch);
+  Value *condition = getVectorValue(branch->getCondition());
+
+  // Lanes that take the successor in the loop stay active.
+  bool stayOnTrue = loop->contains(branch->getSuccessor(0));
+  Value *stay =
+      stayOnTrue ? condition : irBuilder->CreateNot(condition, "stay");
+  nextLoopMask = irBuilder->CreateAnd(loopMask, stay, "active_mask.next");
+
+  // Iterate while any lane is active.
+  branch->setCondition(createAnyLaneActive(nextLoopMask));
+  if (!stayOnTrue)
+    branch->swapSuccessors();
+
+  return branch;
+}
+
+//------------------------------------------------------------------------------
+Value *ThreadVectorizing::createAnyLaneActive(Value *mask) {
+  Value *result =
+      irBuilder->CreateExtractElement(mask, irBuilder->getInt32(0), "lane");
+  for (unsigned int index = 1; index < width; ++index) {
+    Value *lane = irBuilder->CreateExtractElement(
+        mask, irBuilder->getInt32(index), "lane");
+    result = irBuilder->CreateOr(result, lane, "any_active");
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+void ThreadVectorizing::vectorizeMaskedInsts() {
+  // Widen the operands first: widening may query the dominator tree, which
+  // does not know about the blocks created by the replication.
+  std::vector<ValueVector> operands;
+  for (std::vector<std::pair<Instruction *, Value *> >::iterator
+           iter = maskedInsts.begin(),
+           iterEnd = maskedInsts.end();
+       iter != iterEnd; ++iter) {
+    operands.push_back(getWidenedOperands(iter->first));
+  }
+
+  for (unsigned int index = 0; index < maskedInsts.size(); ++index) {
+    Instruction *inst = maskedInsts[index].first;
+    Value *result =
+        replicateMaskedInst(inst, maskedInsts[index].second, operands[index]);
+    if (result != NULL)
+      vectorMap[inst] = result;
+    toRemoveInsts.insert(inst);
+  }
+}
+
+//------------------------------------------------------------------------------
+Value *ThreadVectorizing::replicateMaskedInst(Instruction *inst, Value *mask,
+                                              ValueVector &operands) {
+  bool isVoid = inst->getType()->isVoidTy();
+  Value *result = NULL;
+  if (!isVoid)
+    result = UndefValue::get(VectorType::get(inst->getType(), width));
+
+  for (unsigned int index = 0; index < width; ++index) {
+    // Split the block right before the scalar instruction, every replica
+    // gets its own conditional block.
+    irBuilder->SetInsertPoint(inst);
+    Instruction *active = cast<Instruction>(irBuilder->CreateExtractElement(
+        mask, irBuilder->getInt32(index), "lane_active"));
+    BasicBlock *guard = active->getParent();
+    TerminatorInst *thenTerm = SplitBlockAndInsertIfThen(active, false);
+
+    irBuilder->SetInsertPoint(thenTerm);
+    Instruction *cloned = inst->clone();
+    for (unsigned int operandIndex = 0, operandEnd = inst->getNumOperands();
+         operandIndex != operandEnd; ++operandIndex) {
+      Value *operand = operands[operandIndex];
+      if (operand->getType()->isVectorTy())
+        operand = irBuilder->CreateExtractElement(
+            operand, irBuilder->getInt32(index), "extracted");
+      cloned->setOperand(operandIndex, operand);
+    }
+    irBuilder->Insert(cloned);
+    if (inst->hasName())
+      cloned->setName(inst->getName() + ".masked" + Twine(index));
+
+    if (isVoid)
+      continue;
+
+    // Inactive lanes get an undefined value, the values used after the loop
+    // are taken from the accumulators of freezeLiveOut.
+    irBuilder->SetInsertPoint(inst);
+    PHINode *phi = irBuilder->CreatePHI(inst->getType(), 2, "masked");
+    phi->addIncoming(cloned, cloned->getParent());
+    phi->addIncoming(UndefValue::get(inst->getType()), guard);
+    result = irBuilder->CreateInsertElement(result, phi,
+                                            irBuilder->getInt32(index),
+                                            "inserted");
+  }
+
+  return result;
+}
+
+// Induction variables such as "for (i = tid; i < n; i += stride)" are
+// divergent only because of their start value: the value of each lane is the
+// value of the first lane plus a constant offset. The phi and its increment
+// are kept scalar, so the loop overhead does not grow with the width, and
+// their vector form is built only for the users that need it.
+// The loop is either uniform, or divergent because its exit test depends on
+// the induction variable, and then masked: all the lanes step together, the
+// lanes that left the loop are masked out and their last values frozen.
+
+//------------------------------------------------------------------------------
+void ThreadVectorizing::findAffinePhis() {
+  InstVector &insts = sdda->getDivInsts();
+  for (InstVector::iterator iter = insts.begin(), iterEnd = insts.end();
+       iter != iterEnd; ++iter) {
+    PHINode *phi = dyn_cast<PHINode>(*iter);
+    if (phi == NULL || !isAffinePhi(phi))
+      continue;
+
+    Loop *loop = loopInfo->getLoopFor(phi->getParent());
+    Instruction *increment =
+        cast<Instruction>(phi->getIncomingValueForBlock(loop->getLoopLatch()));
+    initAffinePhi(phi, increment);
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ThreadVectorizing::isAffinePhi(PHINode *phi) {
+  if (!phi->getType()->isIntegerTy() || phi->getNumIncomingValues() != 2)
+    return false;
+
+  BasicBlock *header = phi->getParent();
+  if (!loopInfo->isLoopHeader(header))
+    return false;
+
+  Loop *loop = loopInfo->getLoopFor(header);
+  BasicBlock *preheader = loop->getLoopPredecessor();
+  BasicBlock *latch = loop->getLoopLatch();
+  if (preheader == NULL || latch == NULL)
+    return false;
+
+  // The start value is divergent.
+  Instruction *start =
+      dyn_cast<Instruction>(phi->getIncomingValueForBlock(preheader));
+  if (start == NULL || !sdda->isDivergent(start))
+    return false;
+
+  // The step is uniform and loop invariant: phi + step or phi - step.
+  BinaryOperator *increment =
+      dyn_cast<BinaryOperator>(phi->getIncomingValueForBlock(latch));
+  if (increment == NULL || !loop->contains(increment))
+    return false;
+
+  Value *step = NULL;
+  if (increment->getOpcode() == Instruction::Add) {
+    if (increment->getOperand(0) == phi)
+      step = increment->getOperand(1);
+    else if (increment->getOperand(1) == phi)
+      step = increment->getOperand(0);
+  } else if (increment->getOpcode() == Instruction::Sub &&
+             increment->getOperand(0) == phi) {
+    step = increment->getOperand(1);
+  }
+
+  if (step == NULL || !loop->isLoopInvariant(step))
+    return false;
+  if (Instruction *stepInst = dyn_cast<Instruction>(step))
+    if (sdda->isDivergent(stepInst))
+      return false;
+
+  // All the lanes execute the increment: either it is outside of divergent
+  // regions, or the loop is masked (masked loops have no nested regions).
+  for (RegionVector::iterator iter = maskedLoops.begin(),
+                              iterEnd = maskedLoops.end();
+       iter != iterEnd; ++iter) {
+    if ((*iter)->getHeader() == header)
+      return true;
+  }
+  InstVector &insts = sdda->getOutermostDivInsts();
+  return std::find(insts.begin(), insts.end(), increment) != insts.end();
+}
+
+//------------------------------------------------------------------------------
+void ThreadVectorizing::initAffinePhi(PHINode *phi, Instruction *increment) {
+  Loop *loop = loopInfo->getLoopFor(phi->getParent());
+  BasicBlock *preheader = loop->getLoopPredecessor();
+  Value *start = phi->getIncomingValueForBlock(preheader);
+
+  IRBuilderBase::InsertPoint originalIp = irBuilder->saveIP();
+
+  // The scalar phi computes the value of the first lane.
+  Value *vectorStart = getVectorValue(start);
+  irBuilder->SetInsertPoint(preheader->getTerminator());
+  Instruction *laneZero = cast<Instruction>(irBuilder->CreateExtractElement(
+      vectorStart, irBuilder->getInt32(0), phi->getName() + ".start"));
+  phi->setIncomingValue(phi->getBasicBlockIndex(preheader), laneZero);
+
+  // Offset of each lane from the first one.
+  Value *splatStart = widenValue(laneZero);
+  irBuilder->SetInsertPoint(preheader->getTerminator());
+  Value *offset = irBuilder->CreateSub(vectorStart, splatStart,
+                                       phi->getName() + ".offset");
+
+  irBuilder->restoreIP(originalIp);
+
+  affineOffsets[phi] = offset;
+  affineOffsets[increment] = offset;
+}
+
+//------------------------------------------------------------------------------
+Value *ThreadVectorizing::materializeAffineValue(Instruction *inst) {
+  IRBuilderBase::InsertPoint originalIp = irBuilder->saveIP();
+
+  Value *splat = widenValue(inst);
+  setInsertPoint(cast<Instruction>(splat));
+  Value *result =
+      irBuilder->CreateAdd(splat, affineOffsets[inst], inst->getName());
+
+  irBuilder->restoreIP(originalIp);
+  return result;
+}
+
+//------------------------------------------------------------------------------
+Value *ThreadVectorizing::getLaneZeroValue(Value *scalar) {
+  // The scalar form of affine values is the first lane.
+  if (Instruction *inst = dyn_cast<Instruction>(scalar))
+    if (affineOffsets.count(inst))
+      return inst;
+
+  return irBuilder->CreateExtractElement(getVectorValue(scalar),
+                                         irBuilder->getInt32(0), "extracted");
+}
+
+// Support functions.
+//------------------------------------------------------------------------------
+void appendUsers(Instruction *inst, InstVector &users) {
+  for (Value::use_iterator iter = inst->use_begin(), iterEnd = inst->use_end();
+       iter != iterEnd; ++iter) {
+    if (Instruction *user = dyn_cast<Instruction>(*iter))
+      users.push_back(user);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Divisions and remainders, which trap on a zero divisor.
+bool isIntegerDivision(const Instruction *inst) {
+  switch (inst->getOpcode()) {
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+    return true;
+  default:
+    return false;
+  }
+}
@@ -12,8 +12,39 @@
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/PostDominators.h"
 
+#include "llvm/Support/CFG.h"
+
 #include <algorithm>
 
+// Count the loads between two points of the function.
+// Each block is scanned once to number its loads, after that the loads
+// between two instructions of a block are the difference of their numbers.
+// The loads of the blocks between a definition and a use are summed once for
+// each pair of blocks.
+class LoadCounter {
+public:
+  LoadCounter(DominatorTree *dt);
+
+public:
+  // Loads after def and before user. A NULL user is the end of userBlock.
+  unsigned int countLoads(Instruction *def, BasicBlock *userBlock,
+                          Instruction *user);
+
+private:
+  void numberLoads(BasicBlock *block);
+  unsigned int countBefore(Instruction *inst);
+  unsigned int countInBlock(BasicBlock *block);
+  unsigned int countInRegion(BasicBlock *defBlock, BasicBlock *userBlock);
+
+private:
+  DominatorTree *dt;
+  // Loads preceding each instruction in its block.
+  std::map<const Instruction *, unsigned int> preceding;
+  std::map<const BasicBlock *, unsigned int> blockLoads;
+  // Loads of the blocks strictly between two blocks.
+  std::map<std::pair<BasicBlock *, BasicBlock *>, unsigned int> regionLoads;
+};
+
 //------------------------------------------------------------------------------
 InstVector filterUsers(InstVector &insts, BasicBlock *block) {
   InstVector result;
@@ -29,89 +60,112 @@ InstVector filterUsers(InstVector &insts, BasicBlock *block) {
 }
 
 //------------------------------------------------------------------------------
-bool isLoad(const llvm::Instruction &inst) { return isa<LoadInst>(inst); }
+LoadCounter::LoadCounter(DominatorTree *dt) : dt(dt) {}
 
 //------------------------------------------------------------------------------
-unsigned int countLoadsBounded(BasicBlock *block, Instruction *def,
-                               Instruction *user) {
-  BasicBlock::iterator iter(def), end(user);
-  ++iter;
-  return std::count_if(iter, end, isLoad);
+unsigned int LoadCounter::countLoads(Instruction *def, BasicBlock *userBlock,
+                                     Instruction *user) {
+  BasicBlock *defBlock = def->getParent();
+  unsigned int userPosition =
+      user == NULL ? countInBlock(userBlock) : countBefore(user);
+  // The loads following def in its block.
+  unsigned int afterDef = countBefore(def) + (isa<LoadInst>(def) ? 1 : 0);
+
+  if (defBlock == userBlock)
+    return userPosition - afterDef;
+
+  return countInBlock(defBlock) - afterDef +
+         countInRegion(defBlock, userBlock) + userPosition;
 }
 
 //------------------------------------------------------------------------------
-unsigned int countLoads(BlockVector blocks, BasicBlock *defBlock,
-                        BasicBlock *userBlock, Instruction *def,
-                        Instruction *user) {
-
-  if (defBlock == userBlock) {
-    return countLoadsBounded(defBlock, def, user);
+void LoadCounter::numberLoads(BasicBlock *block) {
+  unsigned int loads = 0;
+  for (BasicBlock::iterator iter = block->begin(), end = block->end();
+       iter != end; ++iter) {
+    Instruction *inst = iter;
+    preceding[inst] = loads;
+    if (isa<LoadInst>(inst))
+      ++loads;
   }
+  blockLoads[block] = loads;
+}
 
-  unsigned int result = 0;
-  for (BlockVector::iterator iter = blocks.begin(), end = blocks.end();
-       iter != end; ++iter) {
-    BasicBlock *block = *iter;
-    if (block == defBlock) {
-      result += countLoadsBounded(block, def, block->end());
-      continue;
-    }
-    if (block == userBlock) {
-      result += countLoadsBounded(block, block->begin(), user);
-      continue;
-    }
+//------------------------------------------------------------------------------
+unsigned int LoadCounter::countBefore(Instruction *inst) {
+  std::map<const Instruction *, unsigned int>::iterator iter =
+      preceding.find(inst);
+  if (iter != preceding.end())
+    return iter->second;
+
+  numberLoads(inst->getParent());
+  return preceding[inst];
+}
 
-    result += countLoadsBounded(block, block->begin(), block->end());
-  }
-  return result;
+//------------------------------------------------------------------------------
+unsigned int LoadCounter::countInBlock(BasicBlock *block) {
+  std::map<const BasicBlock *, unsigned int>::iterator iter =
+      blockLoads.find(block);
+  if (iter != blockLoads.end())
+    return iter->second;
+
+  numberLoads(block);
+  return blockLoads[block];
 }
 
 //------------------------------------------------------------------------------
-// FIXME: this might not work with loops.
-BlockVector getRegionBlocks(BasicBlock *defBlock, BasicBlock *userBlock) {
-  BlockVector result;
+// The blocks between defBlock and userBlock are the ones reaching userBlock
+// backwards without going through defBlock. They are all dominated by
+// defBlock: the walk does not leave the region, and visits each block once
+// even with loops.
+unsigned int LoadCounter::countInRegion(BasicBlock *defBlock,
+                                        BasicBlock *userBlock) {
+  std::pair<BasicBlock *, BasicBlock *> key(defBlock, userBlock);
+  std::map<std::pair<BasicBlock *, BasicBlock *>, unsigned int>::iterator
+      iter = regionLoads.find(key);
+  if (iter != regionLoads.end())
+    return iter->second;
+
+  unsigned int result = 0;
+  BlockSet visited;
   BlockStack stack;
+  visited.insert(defBlock);
+  visited.insert(userBlock);
   stack.push(userBlock);
 
   while (!stack.empty()) {
-    // Pop the first block.
     BasicBlock *block = stack.top();
-    result.push_back(block);
     stack.pop();
-
-    // Don't put to the stack the defBlock predecessors.
-    if (block == defBlock)
-      continue;
-
-    // Push to the stack the defBlock predecessors.
-    for (pred_iterator iter = pred_begin(block), end = pred_end(block);
-         iter != end; ++iter) {
-      BasicBlock *pred = *iter;
-      stack.push(pred);
+    if (block != userBlock)
+      result += countInBlock(block);
+
+    for (pred_iterator predIter = pred_begin(block), predEnd = pred_end(block);
+         predIter != predEnd; ++predIter) {
+      BasicBlock *pred = *predIter;
+      if (dt != NULL && !dt->dominates(defBlock, pred))
+        continue;
+      if (visited.insert(pred).second)
+        stack.push(pred);
     }
   }
 
+  regionLoads[key] = result;
   return result;
 }
 
 //------------------------------------------------------------------------------
-unsigned int computeDistance(Instruction *def, Instruction *user) {
-  BasicBlock *defBlock = def->getParent();
-  BasicBlock *userBlock = user->getParent();
-
-  // Manage the special case in which the user is a phi-node.
+unsigned int computeDistance(LoadCounter &counter, Instruction *def,
+                             Instruction *user) {
+  // Manage the special case in which the user is a phi-node: the value is
+  // used at the end of the incoming block.
   if (PHINode *phi = dyn_cast<PHINode>(user)) {
     for (unsigned int index = 0; index < phi->getNumIncomingValues(); ++index) {
-      if (def == phi->getIncomingValue(index)) {
-        userBlock = phi->getIncomingBlock(index);
-        BlockVector blocks = getRegionBlocks(defBlock, userBlock);
-        return countLoads(blocks, defBlock, userBlock, def, userBlock->end());
-      }
+      if (def == phi->getIncomingValue(index))
+        return counter.countLoads(def, phi->getIncomingBlock(index), NULL);
     }
   }
 
-  BlockVector blocks = getRegionBlocks(defBlock, userBlock);
-  return countLoads(blocks, defBlock, userBlock, def, user);
+  return counter.countLoads(def, user->getParent(), user);
 }
 
 //------------------------------------------------------------------------------
@@ -119,6 +173,7 @@ unsigned int computeDistance(Instruction *def, Instruction *user) {
 // MLP: count the number of loads that fall in each load-use interval
 // (interval between a load and the first use of the loaded value).
 float getMLP(BasicBlock *block, DominatorTree *DT, PostDominatorTree *PDT) {
+  LoadCounter counter(DT);
   std::vector<unsigned int> distances;
   for (BasicBlock::iterator inst = block->begin(), end = block->end();
        inst != end; ++inst) {
@@ -130,7 +185,7 @@ float getMLP(BasicBlock *block, DominatorTree *DT, PostDominatorTree *PDT) {
            iter != end; ++iter) {
 
         Instruction *user = *iter;
-        unsigned int distance = computeDistance(inst, user);
+        unsigned int distance = computeDistance(counter, inst, user);
         distances.push_back(distance);
       }
     }
@@ -2,6 +2,7 @@
 #include "thrud/ThreadVectorizing/ThreadVectorizing.h"
 
 #include "thrud/Support/DataTypes.h"
+#include "thrud/Support/NDRange.h"
 #include "thrud/Support/Utils.h"
 
 // Support functions.
@@ -12,6 +13,7 @@ Instruction *getShiftInst(Value *value, unsigned int shift);
 Instruction *getAndInst(Value *value, unsigned int factor);
 Instruction *getDivInst(Value *value, unsigned int divisor);
 Instruction *getModuloInst(Value *value, unsigned int modulo);
+void scaleSizes(NDRange *ndr, unsigned int direction, unsigned int factor);
 
 //------------------------------------------------------------------------------
 void ThreadCoarsening::scaleNDRange() {
@@ -21,18 +23,7 @@ void ThreadCoarsening::scaleNDRange() {
 }
 
 //------------------------------------------------------------------------------
-void ThreadCoarsening::scaleSizes() {
-  InstVector sizeInsts = ndr->getSizes(direction);
-  for (InstVector::iterator iter = sizeInsts.begin(), iterEnd = sizeInsts.end();
-       iter != iterEnd; ++iter) {
-    // Scale size.
-    Instruction *inst = *iter;
-    Instruction *mul = getMulInst(inst, factor);
-    mul->insertAfter(inst);
-    // Replace uses of the old size with the scaled one.
-    replaceUses(inst, mul);
-  }
-}
+void ThreadCoarsening::scaleSizes() { ::scaleSizes(ndr, direction, factor); }
 
 //------------------------------------------------------------------------------
 // Scaling function: origTid = [newTid / st] * cf * st + newTid % st + subid * st
@@ -113,6 +104,10 @@ void ThreadCoarsening::scaleIds() {
 //  }
 //}
 
+//------------------------------------------------------------------------------
+// Each work item now covers width work items of the original NDRange.
+void ThreadVectorizing::scaleSizes() { ::scaleSizes(ndr, direction, width); }
+
 //------------------------------------------------------------------------------
 void ThreadVectorizing::widenTids() {
   // Get the list of tid values.
@@ -177,6 +172,20 @@ ThreadVectorizing::createConsecutiveVector(llvm::Instruction *inst) {
 }
 
 // Support functions.
+//------------------------------------------------------------------------------
+// Multiply the global and local sizes along direction by factor and replace
+// their uses with the scaled ones.
+void scaleSizes(NDRange *ndr, unsigned int direction, unsigned int factor) {
+  InstVector sizeInsts = ndr->getSizes(direction);
+  for (InstVector::iterator iter = sizeInsts.begin(), iterEnd = sizeInsts.end();
+       iter != iterEnd; ++iter) {
+    Instruction *inst = *iter;
+    Instruction *mul = getMulInst(inst, factor);
+    mul->insertAfter(inst);
+    replaceUses(inst, mul);
+  }
+}
+
 //------------------------------------------------------------------------------
 unsigned int getIntWidth(Value *value) {
   Type *type = value->getType();
@@ -0,0 +1,249 @@
+#define DEBUG_TYPE "occupancy_analysis"
+
+#include "thrud/FeatureExtraction/OccupancyAnalysis.h"
+
+#include "thrud/DivergenceAnalysis/DivergenceAnalysis.h"
+
+#include "thrud/FeatureExtraction/RegisterPressure.h"
+#include "thrud/FeatureExtraction/SymbolicExecution.h"
+
+#include "thrud/Support/DeviceProfile.h"
+#include "thrud/Support/NDRangeSpace.h"
+#include "thrud/Support/Utils.h"
+
+#include "llvm/IR/Function.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+extern cl::opt<unsigned int> CoarseningFactorCL;
+
+static cl::opt<std::string>
+    kernelName("occupancy-kernel-name", cl::init(""), cl::Hidden,
+               cl::desc("Name of the kernel to estimate the occupancy of"));
+static cl::list<unsigned int>
+    factorsCL("occupancy-factors", cl::CommaSeparated, cl::Hidden,
+              cl::desc("Coarsening factors to estimate the occupancy of, "
+                       "comma separated. Default: 1 and -coarsening-factor"));
+static cl::opt<float>
+    thresholdCL("occupancy-threshold", cl::init(0.25), cl::Hidden,
+                cl::desc("Smallest occupancy hiding the memory latency"));
+
+char OccupancyAnalysis::ID = 0;
+static RegisterPass<OccupancyAnalysis>
+    X("occupancy", "Estimate the occupancy of a kernel before and after "
+                   "coarsening", false, true);
+
+using yaml::MappingTraits;
+using yaml::SequenceTraits;
+using yaml::IO;
+using yaml::Output;
+
+namespace llvm {
+namespace yaml {
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<OccupancyAnalysis::Configuration> {
+  static void mapping(IO &io, OccupancyAnalysis::Configuration &config) {
+    io.mapRequired("factor", config.factor);
+    io.mapRequired("group_size", config.groupSize);
+    io.mapRequired("warps_per_group", config.warpsPerGroup);
+    io.mapRequired("registers", config.registers);
+    io.mapRequired("resident_groups", config.residentGroups);
+    io.mapRequired("resident_warps", config.residentWarps);
+    io.mapRequired("occupancy", config.occupancy);
+    io.mapRequired("limiter", config.limiter);
+    io.mapRequired("spills", config.spills);
+    io.mapRequired("acceptable", config.acceptable);
+  }
+};
+
+//------------------------------------------------------------------------------
+template <>
+struct SequenceTraits<std::vector<OccupancyAnalysis::Configuration> > {
+  static size_t size(IO &io,
+                     std::vector<OccupancyAnalysis::Configuration> &seq) {
+    return seq.size();
+  }
+  static OccupancyAnalysis::Configuration &
+  element(IO &, std::vector<OccupancyAnalysis::Configuration> &seq,
+          size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<OccupancyAnalysis> {
+  static void mapping(IO &io, OccupancyAnalysis &analysis) {
+    io.mapRequired("kernel", analysis.kernel);
+    io.mapRequired("device", analysis.deviceName);
+    io.mapRequired("direction", analysis.direction);
+    io.mapRequired("local_bytes", analysis.localBytes);
+    io.mapRequired("unbound_local_args", analysis.unboundLocalArgs);
+    io.mapRequired("configurations", analysis.configurations);
+  }
+};
+}
+}
+
+// Support functions.
+//------------------------------------------------------------------------------
+void applyLimit(unsigned int limit, const char *name, unsigned int &groups,
+                std::string &limiter);
+
+//------------------------------------------------------------------------------
+OccupancyAnalysis::OccupancyAnalysis()
+    : FunctionPass(ID), direction(0), localBytes(0), unboundLocalArgs(0),
+      sdda(NULL) {}
+
+//------------------------------------------------------------------------------
+bool OccupancyAnalysis::runOnFunction(Function &function) {
+  if (function.getName() != kernelName)
+    return false;
+
+  sdda = &getAnalysis<SingleDimDivAnalysis>();
+
+  kernel = function.getName();
+  deviceName = getDeviceProfile().name;
+  direction = sdda->getDirection();
+  localBytes = getLocalMemorySize(&function, unboundLocalArgs);
+
+  std::vector<unsigned int> factors(factorsCL.begin(), factorsCL.end());
+  if (factors.empty()) {
+    factors.push_back(1);
+    if (CoarseningFactorCL > 1)
+      factors.push_back(CoarseningFactorCL);
+  }
+
+  configurations.clear();
+  for (std::vector<unsigned int>::iterator iter = factors.begin(),
+                                           iterEnd = factors.end();
+       iter != iterEnd; ++iter) {
+    if (*iter == 0)
+      report_fatal_error("Invalid coarsening factor 0");
+    configurations.push_back(analyzeFactor(function, *iter));
+  }
+
+  dump();
+  return false;
+}
+
+//------------------------------------------------------------------------------
+void OccupancyAnalysis::getAnalysisUsage(AnalysisUsage &au) const {
+  au.addRequired<SingleDimDivAnalysis>();
+  au.setPreservesAll();
+}
+
+//------------------------------------------------------------------------------
+const OccupancyAnalysis::Configuration *
+OccupancyAnalysis::getConfiguration(unsigned int factor) const {
+  for (std::vector<Configuration>::const_iterator
+           iter = configurations.begin(),
+           iterEnd = configurations.end();
+       iter != iterEnd; ++iter) {
+    if (iter->factor == factor)
+      return &*iter;
+  }
+  return NULL;
+}
+
+//------------------------------------------------------------------------------
+unsigned int OccupancyAnalysis::getMaxAcceptableFactor() const {
+  unsigned int result = 1;
+  for (std::vector<Configuration>::const_iterator
+           iter = configurations.begin(),
+           iterEnd = configurations.end();
+       iter != iterEnd; ++iter) {
+    if (iter->acceptable)
+      result = std::max(result, iter->factor);
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+OccupancyAnalysis::Configuration
+OccupancyAnalysis::analyzeFactor(Function &function, unsigned int factor) {
+  const DeviceProfile &device = getDeviceProfile();
+  NDRangeSpace ndrSpace = getCommandLineNDRangeSpace();
+
+  Configuration config;
+  config.factor = factor;
+
+  // A coarsened work-item does the work of factor work-items along the
+  // coarsening direction: the group shrinks accordingly, its local memory
+  // does not.
+  config.groupSize = 1;
+  for (unsigned int index = 0; index < 3; ++index) {
+    unsigned int localSize = ndrSpace.getLocalSize(index);
+    if (index == direction)
+      localSize = (localSize + factor - 1) / factor;
+    config.groupSize *= localSize;
+  }
+  config.warpsPerGroup =
+      (config.groupSize + device.warpSize - 1) / device.warpSize;
+
+  RegisterPressure pressure(function, sdda, factor);
+  config.registers = pressure.getMaxLiveRegisters();
+
+  // Registers are allocated to whole warps.
+  unsigned int groupRegisters =
+      config.registers * config.warpsPerGroup * device.warpSize;
+
+  // 0 resident groups means that no resource limits them.
+  config.residentGroups = 0;
+  config.limiter = "none";
+  if (device.maxWarpsPerComputeUnit != 0)
+    applyLimit(device.maxWarpsPerComputeUnit / config.warpsPerGroup, "warps",
+               config.residentGroups, config.limiter);
+  if (device.maxGroupsPerComputeUnit != 0)
+    applyLimit(device.maxGroupsPerComputeUnit, "groups",
+               config.residentGroups, config.limiter);
+  if (device.computeUnitRegisters != 0 && groupRegisters != 0)
+    applyLimit(device.computeUnitRegisters / groupRegisters, "registers",
+               config.residentGroups, config.limiter);
+  if (device.localMemorySize != 0 && localBytes != 0)
+    applyLimit(device.localMemorySize / localBytes, "local-memory",
+               config.residentGroups, config.limiter);
+
+  config.residentWarps = config.residentGroups * config.warpsPerGroup;
+  // Without a warp limit the compute unit is full as soon as a group fits.
+  if (device.maxWarpsPerComputeUnit == 0)
+    config.occupancy =
+        (config.limiter == "none" || config.residentGroups != 0) ? 1 : 0;
+  else
+    config.occupancy = std::min(1.0f, (float)config.residentWarps /
+                                          device.maxWarpsPerComputeUnit);
+
+  config.spills = config.registers * 4 > device.registerFileSize;
+  config.acceptable = !config.spills && config.occupancy >= thresholdCL;
+
+  DEBUG(dbgs() << kernel << " coarsened by " << factor << ": "
+               << config.residentWarps << " resident warps, occupancy "
+               << config.occupancy << ", " << config.limiter << " bound\n");
+
+  return config;
+}
+
+//------------------------------------------------------------------------------
+void OccupancyAnalysis::dump() {
+  Output yout(llvm::outs());
+  yout << *this;
+}
+
+//------------------------------------------------------------------------------
+// Lower the resident groups to limit, the first limit sets them.
+void applyLimit(unsigned int limit, const char *name, unsigned int &groups,
+                std::string &limiter) {
+  if (limiter == "none" || limit < groups) {
+    groups = limit;
+    limiter = name;
+  }
+}
@@ -0,0 +1,339 @@
+#define DEBUG_TYPE "performance_prediction"
+
+#include "thrud/FeatureExtraction/PerformancePrediction.h"
+
+#include "thrud/FeatureExtraction/FeatureCollector.h"
+
+#include "thrud/Support/DeviceProfile.h"
+#include "thrud/Support/NDRange.h"
+#include "thrud/Support/NDRangeSpace.h"
+#include "thrud/Support/OCLEnv.h"
+
+#include "llvm/Analysis/ScalarEvolution.h"
+
+#include "llvm/IR/Function.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+
+static cl::opt<std::string>
+    kernelName("prediction-kernel-name", cl::init(""), cl::Hidden,
+               cl::desc("Name of the kernel to predict the runtime of"));
+
+char PerformancePrediction::ID = 0;
+static RegisterPass<PerformancePrediction>
+    X("performance-prediction",
+      "Estimate the runtime of a kernel on the device profile", false, true);
+
+// Opcodes taking an issue slot of the arithmetic units.
+static const char *ALU_OPCODES[] = {
+  "Add", "FAdd", "Sub", "FSub", "Mul", "FMul", "UDiv", "SDiv", "FDiv",
+  "URem", "SRem", "FRem", "Shl", "LShr", "AShr", "And", "Or", "Xor",
+  "ICmp", "FCmp", "Select", "GetElementPtr", "Trunc", "ZExt", "SExt",
+  "FPToUI", "FPToSI", "UIToFP", "SIToFP", "FPTrunc", "FPExt", "PtrToInt",
+  "IntToPtr", "ExtractElement", "InsertElement", "ShuffleVector"
+};
+
+using namespace llvm;
+
+// Support functions.
+// -----------------------------------------------------------------------------
+double countTransactions(const std::vector<int> &transactions,
+                         unsigned int warpSize);
+double countLoopTransactions(const std::vector<int> &totals,
+                             const std::vector<int> &iterations,
+                             unsigned int warpSize, int &unknown);
+double countWavefronts(const std::vector<int> &conflicts,
+                       unsigned int warpSize);
+double countLoopWavefronts(const std::vector<int> &conflicts,
+                           const std::vector<int> &iterations,
+                           unsigned int warpSize, int &unknown);
+
+using yaml::MappingTraits;
+using yaml::IO;
+using yaml::Output;
+
+namespace llvm {
+namespace yaml {
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<PerformancePrediction> {
+  static void mapping(IO &io, PerformancePrediction &prediction) {
+    io.mapRequired("kernel", prediction.kernel);
+    io.mapRequired("device", prediction.deviceName);
+    io.mapRequired("kernel_arguments", prediction.kernelArguments);
+    io.mapRequired("work_items", prediction.workItems);
+    io.mapRequired("warps", prediction.warps);
+    io.mapRequired("alu_ops", prediction.aluOps);
+    io.mapRequired("math_calls", prediction.mathCalls);
+    io.mapRequired("barriers", prediction.barriers);
+    io.mapRequired("branches", prediction.branches);
+    io.mapRequired("ops", prediction.ops);
+    io.mapRequired("global_bytes", prediction.globalBytes);
+    io.mapRequired("local_bytes", prediction.localBytes);
+    io.mapRequired("unknown_accesses", prediction.unknownAccesses);
+    io.mapRequired("arithmetic_intensity", prediction.arithmeticIntensity);
+    io.mapRequired("compute_time", prediction.computeTime);
+    io.mapRequired("memory_time", prediction.memoryTime);
+    io.mapRequired("local_memory_time", prediction.localMemoryTime);
+    io.mapRequired("runtime", prediction.runtime);
+    io.mapRequired("bound", prediction.bound);
+  }
+};
+}
+}
+
+//------------------------------------------------------------------------------
+PerformancePrediction::PerformancePrediction()
+    : FunctionPass(ID), workItems(0), warps(0), aluOps(0), mathCalls(0),
+      barriers(0), branches(0), ops(0), globalBytes(0), localBytes(0),
+      unknownAccesses(0), arithmeticIntensity(0), computeTime(0), memoryTime(0),
+      localMemoryTime(0), runtime(0), loopInfo(NULL) {}
+
+//------------------------------------------------------------------------------
+bool PerformancePrediction::runOnFunction(Function &function) {
+  if (function.getName() != kernelName)
+    return false;
+
+  loopInfo = &getAnalysis<LoopInfo>();
+  ScalarEvolution *scalarEvolution = &getAnalysis<ScalarEvolution>();
+  NDRange *ndr = &getAnalysis<NDRange>();
+
+  // The memory behavior is the one of the first set of argument values.
+  execution.analyze(function, loopInfo, scalarEvolution, ndr,
+                    OCLEnv::getArgumentSets().front());
+
+  kernel = function.getName();
+  deviceName = getDeviceProfile().name;
+  kernelArguments = execution.kernelArguments;
+
+  // Weight the blocks with the same trip counts as the dynamic features.
+  FeatureCollector collector;
+  collector.computeTripCounts(function, loopInfo, scalarEvolution, ndr);
+  tripCounts = collector.tripCounts;
+
+  unknownAccesses = 0;
+  countWarps();
+  countOps(function);
+  countGlobalBytes();
+  countLocalBytes();
+  predict();
+  dump();
+
+  return false;
+}
+
+//------------------------------------------------------------------------------
+void PerformancePrediction::getAnalysisUsage(AnalysisUsage &au) const {
+  au.addRequired<ScalarEvolution>();
+  au.addRequired<NDRange>();
+  au.addRequired<LoopInfo>();
+  au.setPreservesAll();
+}
+
+//------------------------------------------------------------------------------
+float PerformancePrediction::getRuntime() const { return runtime; }
+
+//------------------------------------------------------------------------------
+const std::string &PerformancePrediction::getBound() const { return bound; }
+
+//------------------------------------------------------------------------------
+bool PerformancePrediction::isMemoryBound() const {
+  return bound != "compute";
+}
+
+//------------------------------------------------------------------------------
+void PerformancePrediction::countWarps() {
+  const NDRangeSpace &ndrSpace = execution.getNDRangeSpace();
+  unsigned int warpSize = getDeviceProfile().warpSize;
+  double groups = (double)ndrSpace.getNumberOfGroupsX() *
+                  ndrSpace.getNumberOfGroupsY() *
+                  ndrSpace.getNumberOfGroupsZ();
+  workItems = groups * ndrSpace.getGroupSize();
+  warps = groups * ((ndrSpace.getGroupSize() + warpSize - 1) / warpSize);
+}
+
+//------------------------------------------------------------------------------
+void PerformancePrediction::countOps(Function &function) {
+  unsigned int aluOpcodeNumber = sizeof(ALU_OPCODES) / sizeof(ALU_OPCODES[0]);
+
+  aluOps = 0;
+  mathCalls = 0;
+  barriers = 0;
+  branches = 0;
+  ops = 0;
+  for (Function::iterator iter = function.begin(), iterEnd = function.end();
+       iter != iterEnd; ++iter) {
+    BasicBlock *block = iter;
+    FeatureCollector collector;
+    collector.countOpcodes(*block);
+    collector.countMathFunctions(*block);
+    collector.countBarriers(*block);
+    collector.countTypedInsts(*block);
+
+    float blockAluOps = 0;
+    for (unsigned int index = 0; index < aluOpcodeNumber; ++index) {
+      blockAluOps += collector.instTypes[ALU_OPCODES[index]];
+    }
+    // Calls to functions other than math builtins and barriers are mostly
+    // work item functions: count them as simple operations.
+    int blockMathCalls = collector.instTypes["mathFunctions"];
+    int blockBarriers = collector.instTypes["barriers"];
+    blockAluOps +=
+        collector.instTypes["Call"] - blockMathCalls - blockBarriers;
+    int blockBranches =
+        collector.instTypes["Br"] + collector.instTypes["Switch"];
+
+    float weight = getBlockWeight(block);
+    aluOps += weight * blockAluOps;
+    mathCalls += weight * blockMathCalls;
+    barriers += weight * blockBarriers;
+    branches += weight * blockBranches;
+    ops += weight * collector.computeCycles;
+  }
+}
+
+//------------------------------------------------------------------------------
+float PerformancePrediction::getBlockWeight(const BasicBlock *block) {
+  float weight = 1;
+  for (const Loop *loop = loopInfo->getLoopFor(block); loop != NULL;
+       loop = loop->getParentLoop()) {
+    weight *= tripCounts[loop];
+  }
+  return weight;
+}
+
+//------------------------------------------------------------------------------
+void PerformancePrediction::countGlobalBytes() {
+  if (execution.cacheSimulated) {
+    globalBytes = execution.dramBytes;
+    return;
+  }
+
+  // Transactions of a warp.
+  unsigned int warpSize = getDeviceProfile().warpSize;
+  double transactions =
+      countTransactions(execution.loadTransactions, warpSize) +
+      countTransactions(execution.storeTransactions, warpSize) +
+      countLoopTransactions(execution.loopLoadTotalTransactions,
+                            execution.loopLoadIterations, warpSize,
+                            unknownAccesses) +
+      countLoopTransactions(execution.loopStoreTotalTransactions,
+                            execution.loopStoreIterations, warpSize,
+                            unknownAccesses);
+
+  globalBytes = transactions * getDeviceProfile().cachelineSize * warps;
+}
+
+//------------------------------------------------------------------------------
+void PerformancePrediction::countLocalBytes() {
+  const DeviceProfile &device = getDeviceProfile();
+  double wavefronts =
+      countWavefronts(execution.loadBankConflicts, device.warpSize) +
+      countWavefronts(execution.storeBankConflicts, device.warpSize) +
+      countLoopWavefronts(execution.loopLoadBankConflicts,
+                          execution.loopLocalLoadIterations, device.warpSize,
+                          unknownAccesses) +
+      countLoopWavefronts(execution.loopStoreBankConflicts,
+                          execution.loopLocalStoreIterations, device.warpSize,
+                          unknownAccesses);
+
+  localBytes = wavefronts * device.bankNumber * device.bankWidth * warps;
+}
+
+//------------------------------------------------------------------------------
+void PerformancePrediction::predict() {
+  const DeviceProfile &device = getDeviceProfile();
+
+  // All the lanes of a warp issue, even the ones of a partial warp.
+  double totalOps = ops * warps * device.warpSize;
+
+  computeTime = totalOps / (device.computeThroughput * 1e9);
+  memoryTime = globalBytes / (device.memoryBandwidth * 1e9);
+  localMemoryTime = localBytes / (device.localMemoryBandwidth * 1e9);
+  arithmeticIntensity = globalBytes == 0 ? 0 : totalOps / globalBytes;
+
+  runtime = computeTime;
+  bound = "compute";
+  if (memoryTime > runtime) {
+    runtime = memoryTime;
+    bound = "memory";
+  }
+  if (localMemoryTime > runtime) {
+    runtime = localMemoryTime;
+    bound = "local-memory";
+  }
+
+  DEBUG(dbgs() << kernel << " on " << device.name << ": " << runtime << "s, "
+               << bound << " bound\n");
+}
+
+//------------------------------------------------------------------------------
+void PerformancePrediction::dump() {
+  Output yout(llvm::outs());
+  yout << *this;
+}
+
+// Support functions.
+//------------------------------------------------------------------------------
+// Unknown (negative) counts take a transaction per lane.
+double countTransactions(const std::vector<int> &transactions,
+                         unsigned int warpSize) {
+  double sum = 0;
+  for (std::vector<int>::const_iterator iter = transactions.begin(),
+                                        iterEnd = transactions.end();
+       iter != iterEnd; ++iter) {
+    sum += *iter < 0 ? warpSize : *iter;
+  }
+  return sum;
+}
+
+//------------------------------------------------------------------------------
+// Transactions of the whole loop. Without the total, a transaction per lane
+// in every iteration; without the iterations, nothing.
+double countLoopTransactions(const std::vector<int> &totals,
+                             const std::vector<int> &iterations,
+                             unsigned int warpSize, int &unknown) {
+  double sum = 0;
+  for (unsigned int index = 0; index < totals.size(); ++index) {
+    if (totals[index] >= 0)
+      sum += totals[index];
+    else if (iterations[index] >= 0)
+      sum += (double)iterations[index] * warpSize;
+    else
+      ++unknown;
+  }
+  return sum;
+}
+
+//------------------------------------------------------------------------------
+// A warp access takes a wavefront, plus one for each bank conflict. Unknown
+// (negative) counts conflict with every other lane.
+double countWavefronts(const std::vector<int> &conflicts,
+                       unsigned int warpSize) {
+  double sum = 0;
+  for (std::vector<int>::const_iterator iter = conflicts.begin(),
+                                        iterEnd = conflicts.end();
+       iter != iterEnd; ++iter) {
+    sum += *iter < 0 ? warpSize : 1 + *iter;
+  }
+  return sum;
+}
+
+//------------------------------------------------------------------------------
+double countLoopWavefronts(const std::vector<int> &conflicts,
+                           const std::vector<int> &iterations,
+                           unsigned int warpSize, int &unknown) {
+  double sum = 0;
+  for (unsigned int index = 0; index < conflicts.size(); ++index) {
+    if (iterations[index] < 0) {
+      ++unknown;
+      continue;
+    }
+    int wavefronts = conflicts[index] < 0 ? warpSize : 1 + conflicts[index];
+    sum += (double)iterations[index] * wavefronts;
+  }
+  return sum;
+}
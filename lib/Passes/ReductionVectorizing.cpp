@@ -0,0 +1,404 @@
+#define DEBUG_TYPE "ThreadVectorizing"
+
+#include "thrud/ThreadVectorizing/ThreadVectorizing.h"
+
+#include "thrud/Support/NDRange.h"
+#include "thrud/Support/Utils.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include <algorithm>
+
+// Support functions.
+// -----------------------------------------------------------------------------
+Value *stripIntCasts(Value *value);
+bool isHalvingStride(PHINode *phi, BasicBlock *latch);
+bool isTreeOperation(const BinaryOperator *binOp);
+BinaryOperator *getInPlaceUpdate(StoreInst *store, LoadInst *&first,
+                                 LoadInst *&second);
+
+// Reduction trees through local memory halve the number of active work items
+// at every step. Once the stride is below the vectorizing width all the
+// active lanes belong to the first work item: the last log2(width) steps,
+// each with its own barrier, are replaced by a reduction of a vector of
+// width elements within that work item.
+// Scans built on the same pattern are recognized, but left to the generic
+// replication.
+
+//------------------------------------------------------------------------------
+void ThreadVectorizing::findReductionTrees() {
+  RegionVector &regions = sdda->getOutermostDivRegions();
+  for (Function::iterator blockIter = kernelFunction->begin(),
+                          blockEnd = kernelFunction->end();
+       blockIter != blockEnd; ++blockIter) {
+    BasicBlock *header = blockIter;
+    if (!loopInfo->isLoopHeader(header))
+      continue;
+
+    // The loop must be executed by all the work items.
+    bool isInRegion = false;
+    for (RegionVector::iterator iter = regions.begin(),
+                                iterEnd = regions.end();
+         iter != iterEnd; ++iter) {
+      isInRegion |= contains(**iter, header);
+    }
+    if (isInRegion)
+      continue;
+
+    Loop *loop = loopInfo->getLoopFor(header);
+    ReductionTree tree;
+    if (isReductionTree(loop, tree)) {
+      DEBUG(dbgs() << "Reduction tree in " << header->getName() << "\n");
+      reductionTrees.push_back(tree);
+    } else if (isScanTree(loop)) {
+      DEBUG(dbgs() << "Scan tree in " << header->getName()
+                   << " is replicated\n");
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ThreadVectorizing::isReductionTree(Loop *loop, ReductionTree &tree) {
+  BasicBlock *latch = loop->getLoopLatch();
+  BasicBlock *exiting = loop->getExitingBlock();
+  BasicBlock *exit = loop->getExitBlock();
+  if (latch == NULL || exiting == NULL || exit == NULL ||
+      exit->getSinglePredecessor() != exiting)
+    return false;
+
+  // Exit test: s > 0, or s >> 1 > 0.
+  BranchInst *branch = dyn_cast<BranchInst>(exiting->getTerminator());
+  if (branch == NULL || !branch->isConditional())
+    return false;
+  ICmpInst *cmp = dyn_cast<ICmpInst>(branch->getCondition());
+  if (cmp == NULL)
+    return false;
+  ConstantInt *zero = dyn_cast<ConstantInt>(cmp->getOperand(1));
+  if (zero == NULL || !zero->isZero())
+    return false;
+
+  bool stayOnTrue = loop->contains(branch->getSuccessor(0));
+  CmpInst::Predicate predicate = cmp->getPredicate();
+  if (!stayOnTrue)
+    predicate = CmpInst::getInversePredicate(predicate);
+  if (predicate != CmpInst::ICMP_UGT && predicate != CmpInst::ICMP_SGT &&
+      predicate != CmpInst::ICMP_NE)
+    return false;
+
+  Value *tested = cmp->getOperand(0);
+  PHINode *stride = dyn_cast<PHINode>(tested);
+  if (stride == NULL) {
+    Instruction *next = dyn_cast<Instruction>(tested);
+    if (next == NULL || next->getNumOperands() == 0)
+      return false;
+    stride = dyn_cast<PHINode>(next->getOperand(0));
+  }
+  if (stride == NULL || stride->getParent() != loop->getHeader() ||
+      !isHalvingStride(stride, latch))
+    return false;
+  if (tested != stride && tested != stride->getIncomingValueForBlock(latch))
+    return false;
+
+  // Body: a barrier and l[lid] = l[lid] op l[lid + s].
+  tree.barrier = NULL;
+  tree.localId = NULL;
+  StoreInst *update = NULL;
+  BinaryOperator *operation = NULL;
+  for (Loop::block_iterator blockIter = loop->block_begin(),
+                            blockEnd = loop->block_end();
+       blockIter != blockEnd; ++blockIter) {
+    BasicBlock *block = *blockIter;
+    for (BasicBlock::iterator iter = block->begin(), iterEnd = block->end();
+         iter != iterEnd; ++iter) {
+      Instruction *inst = iter;
+      if (isBarrier(inst)) {
+        tree.barrier = cast<CallInst>(inst);
+        continue;
+      }
+
+      if (!isLocalMemoryStore(inst))
+        continue;
+
+      // Only one update of local memory.
+      if (update != NULL)
+        return false;
+
+      update = cast<StoreInst>(inst);
+      LoadInst *first = NULL;
+      LoadInst *second = NULL;
+      operation = getInPlaceUpdate(update, first, second);
+      if (operation == NULL || !isTreeOperation(operation))
+        return false;
+
+      GetElementPtrInst *address =
+          cast<GetElementPtrInst>(update->getPointerOperand());
+      GetElementPtrInst *other =
+          cast<GetElementPtrInst>(second->getPointerOperand());
+      unsigned int last = address->getNumOperands() - 1;
+
+      // The updated element is the one of the work item.
+      CallInst *localId =
+          dyn_cast<CallInst>(stripIntCasts(address->getOperand(last)));
+      if (localId == NULL || !ndr->isLocal(localId, direction))
+        return false;
+      tree.localId = localId;
+
+      // The other element is s positions away.
+      BinaryOperator *offset =
+          dyn_cast<BinaryOperator>(stripIntCasts(other->getOperand(last)));
+      if (offset == NULL || offset->getOpcode() != Instruction::Add)
+        return false;
+      Value *left = stripIntCasts(offset->getOperand(0));
+      Value *right = stripIntCasts(offset->getOperand(1));
+      if (!(left == localId && right == stride) &&
+          !(left == stride && right == localId))
+        return false;
+    }
+  }
+
+  if (update == NULL || tree.barrier == NULL)
+    return false;
+
+  // The first element of the buffer must be addressable after the loop. Its
+  // address is built once the kernel is vectorized: the operands must be
+  // uniform, so that they are still there.
+  GetElementPtrInst *address =
+      cast<GetElementPtrInst>(update->getPointerOperand());
+  unsigned int last = address->getNumOperands() - 1;
+  tree.baseOperands.clear();
+  for (unsigned int index = 0; index < last; ++index) {
+    Value *operand = address->getOperand(index);
+    Instruction *inst = dyn_cast<Instruction>(operand);
+    if (!loop->isLoopInvariant(operand) ||
+        (inst != NULL && sdda->isDivergent(inst)))
+      return false;
+    tree.baseOperands.push_back(operand);
+  }
+
+  // The element type must be a valid vector element.
+  Type *type = update->getValueOperand()->getType();
+  if (!VectorType::isValidElementType(type))
+    return false;
+
+  tree.exitBranch = branch;
+  tree.stride = tested;
+  tree.indexType = address->getOperand(last)->getType();
+  tree.inBounds = address->isInBounds();
+  tree.exit = exit;
+  tree.opcode = operation->getOpcode();
+  tree.alignment = update->getAlignment();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ThreadVectorizing::isScanTree(Loop *loop) {
+  // A loop with a barrier updating local memory in place with values of
+  // other work items: l[a] = l[a] op l[b].
+  bool hasBarrier = false;
+  bool hasUpdate = false;
+  for (Loop::block_iterator blockIter = loop->block_begin(),
+                            blockEnd = loop->block_end();
+       blockIter != blockEnd; ++blockIter) {
+    BasicBlock *block = *blockIter;
+    for (BasicBlock::iterator iter = block->begin(), iterEnd = block->end();
+         iter != iterEnd; ++iter) {
+      Instruction *inst = iter;
+      hasBarrier |= isBarrier(inst);
+
+      if (!isLocalMemoryStore(inst))
+        continue;
+
+      LoadInst *first = NULL;
+      LoadInst *second = NULL;
+      BinaryOperator *operation =
+          getInPlaceUpdate(cast<StoreInst>(inst), first, second);
+      hasUpdate |= operation != NULL && isTreeOperation(operation);
+    }
+  }
+
+  return hasBarrier && hasUpdate;
+}
+
+//------------------------------------------------------------------------------
+void ThreadVectorizing::vectorizeReductionTrees() {
+  for (std::vector<ReductionTree>::iterator iter = reductionTrees.begin(),
+                                            iterEnd = reductionTrees.end();
+       iter != iterEnd; ++iter) {
+    vectorizeReductionTree(*iter);
+  }
+}
+
+//------------------------------------------------------------------------------
+void ThreadVectorizing::vectorizeReductionTree(ReductionTree &tree) {
+  BranchInst *branch = tree.exitBranch;
+  Loop *loop = loopInfo->getLoopFor(branch->getParent());
+  Type *strideType = tree.stride->getType();
+  Value *vectorWidth = ConstantInt::get(strideType, width);
+
+  // Leave the loop when the stride gets smaller than the width.
+  irBuilder->SetInsertPoint(branch);
+  Instruction *oldCondition = cast<Instruction>(branch->getCondition());
+  Value *condition =
+      loop->contains(branch->getSuccessor(0))
+          ? irBuilder->CreateICmpUGE(tree.stride, vectorWidth, "tree_stay")
+          : irBuilder->CreateICmpULT(tree.stride, vectorWidth, "tree_exit");
+  branch->setCondition(condition);
+  if (oldCondition->use_empty())
+    oldCondition->eraseFromParent();
+
+  // The first work item reduces the remaining width elements.
+  ValueVector indices(tree.baseOperands.begin() + 1, tree.baseOperands.end());
+  indices.push_back(Constant::getNullValue(tree.indexType));
+  GetElementPtrInst *firstElement = GetElementPtrInst::Create(
+      tree.baseOperands[0], indices, "reduction_base",
+      tree.exit->getFirstInsertionPt());
+  firstElement->setIsInBounds(tree.inBounds);
+
+  Instruction *localId = tree.localId->clone();
+  localId->insertAfter(firstElement);
+  localId->setName("item_id");
+  irBuilder->SetInsertPoint(firstElement->getParent(),
+                            ++BasicBlock::iterator(localId));
+  Instruction *isFirst = cast<Instruction>(irBuilder->CreateICmpEQ(
+      localId, Constant::getNullValue(localId->getType()), "is_first_item"));
+  TerminatorInst *thenTerm = SplitBlockAndInsertIfThen(isFirst, false);
+  BasicBlock *tail = thenTerm->getSuccessor(0);
+
+  irBuilder->SetInsertPoint(thenTerm);
+  Type *elementType =
+      cast<PointerType>(firstElement->getType())->getElementType();
+  Value *pointer = irBuilder->CreateBitCast(
+      firstElement, getVectorPointerType(firstElement->getType()),
+      "reduction_ptr");
+  LoadInst *partials = irBuilder->CreateLoad(pointer, "partials");
+  partials->setAlignment(tree.alignment);
+
+  // Fold the upper half of the vector onto the lower one, the same pairs
+  // the loop would combine.
+  Value *result = partials;
+  Type *int32 = irBuilder->getInt32Ty();
+  for (unsigned int half = width / 2; half >= 1; half /= 2) {
+    SmallVector<Constant *, 16> mask;
+    for (unsigned int index = 0; index < width; ++index) {
+      if (index < half)
+        mask.push_back(ConstantInt::get(int32, index + half));
+      else
+        mask.push_back(UndefValue::get(int32));
+    }
+    Value *upper = irBuilder->CreateShuffleVector(
+        result, UndefValue::get(result->getType()), ConstantVector::get(mask),
+        "upper");
+    result = irBuilder->CreateBinOp(tree.opcode, result, upper, "reduced");
+  }
+
+  Value *total = irBuilder->CreateExtractElement(result, irBuilder->getInt32(0),
+                                                 "total");
+  assert(total->getType() == elementType && "Wrong reduction type");
+  StoreInst *store = irBuilder->CreateStore(total, firstElement);
+  store->setAlignment(tree.alignment);
+
+  // The other work items wait for the result.
+  Instruction *barrier = tree.barrier->clone();
+  barrier->insertBefore(tail->getFirstInsertionPt());
+}
+
+// Support functions.
+//------------------------------------------------------------------------------
+Value *stripIntCasts(Value *value) {
+  while (CastInst *cast = dyn_cast<CastInst>(value)) {
+    if (!cast->isIntegerCast())
+      break;
+    value = cast->getOperand(0);
+  }
+  return value;
+}
+
+//------------------------------------------------------------------------------
+// The stride is halved at every iteration: s >> 1 or s / 2.
+bool isHalvingStride(PHINode *phi, BasicBlock *latch) {
+  if (!phi->getType()->isIntegerTy() || phi->getNumIncomingValues() != 2)
+    return false;
+
+  BinaryOperator *next =
+      dyn_cast<BinaryOperator>(phi->getIncomingValueForBlock(latch));
+  if (next == NULL || next->getOperand(0) != phi)
+    return false;
+
+  ConstantInt *constant = dyn_cast<ConstantInt>(next->getOperand(1));
+  if (constant == NULL)
+    return false;
+
+  switch (next->getOpcode()) {
+  case Instruction::LShr:
+  case Instruction::AShr:
+    return constant->isOne();
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+    return constant->equalsInt(2);
+  default:
+    return false;
+  }
+}
+
+//------------------------------------------------------------------------------
+bool isTreeOperation(const BinaryOperator *binOp) {
+  switch (binOp->getOpcode()) {
+  case Instruction::Add:
+  case Instruction::FAdd:
+  case Instruction::Mul:
+  case Instruction::FMul:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+    return true;
+  default:
+    return false;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Match store(op(load(p), load(q)), p) on local memory. The load of the
+// stored element is returned in first.
+BinaryOperator *getInPlaceUpdate(StoreInst *store, LoadInst *&first,
+                                 LoadInst *&second) {
+  BinaryOperator *binOp = dyn_cast<BinaryOperator>(store->getValueOperand());
+  if (binOp == NULL)
+    return NULL;
+
+  first = dyn_cast<LoadInst>(binOp->getOperand(0));
+  second = dyn_cast<LoadInst>(binOp->getOperand(1));
+  if (first == NULL || second == NULL || !isLocalMemoryLoad(first) ||
+      !isLocalMemoryLoad(second))
+    return NULL;
+
+  if (second->getPointerOperand() == store->getPointerOperand())
+    std::swap(first, second);
+  if (first->getPointerOperand() != store->getPointerOperand())
+    return NULL;
+
+  // Both elements belong to the same buffer.
+  GetElementPtrInst *address =
+      dyn_cast<GetElementPtrInst>(store->getPointerOperand());
+  GetElementPtrInst *other =
+      dyn_cast<GetElementPtrInst>(second->getPointerOperand());
+  if (address == NULL || other == NULL ||
+      address->getNumOperands() != other->getNumOperands())
+    return NULL;
+
+  for (unsigned int index = 0, last = address->getNumOperands() - 1;
+       index < last; ++index) {
+    if (address->getOperand(index) != other->getOperand(index))
+      return NULL;
+  }
+
+  return binOp;
+}
@@ -0,0 +1,327 @@
+#include "thrud/FeatureExtraction/RegisterPressure.h"
+
+#include "thrud/DivergenceAnalysis/DivergenceAnalysis.h"
+#include "thrud/Support/Utils.h"
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+#include "llvm/Support/CFG.h"
+
+#include <algorithm>
+#include <set>
+
+static const char *CLASS_NAMES[] = { "ScalarInt", "ScalarFloat", "VectorInt",
+                                     "VectorFloat" };
+
+//------------------------------------------------------------------------------
+RegisterPressure::RegisterPressure(Function &function) {
+  analyze(function, NULL, 1);
+}
+
+//------------------------------------------------------------------------------
+RegisterPressure::RegisterPressure(Function &function,
+                                   DivergenceAnalysis *divergence,
+                                   unsigned int coarseningFactor) {
+  analyze(function, divergence, coarseningFactor);
+}
+
+//------------------------------------------------------------------------------
+void RegisterPressure::analyze(Function &function,
+                               DivergenceAnalysis *divergence,
+                               unsigned int coarseningFactor) {
+  numberValues(function, divergence, coarseningFactor);
+  computeLiveSets(function);
+
+  for (Function::iterator iter = function.begin(), end = function.end();
+       iter != end; ++iter) {
+    BasicBlock *block = iter;
+    computeMaxLive(block, blocks[block]);
+  }
+}
+
+//------------------------------------------------------------------------------
+std::vector<int> RegisterPressure::getLiveIn(const BasicBlock *block) const {
+  std::map<const BasicBlock *, BlockLiveness>::const_iterator iter =
+      blocks.find(block);
+  if (iter == blocks.end())
+    return std::vector<int>(RegisterClassNumber, 0);
+  return countClasses(iter->second.liveIn);
+}
+
+//------------------------------------------------------------------------------
+std::vector<int> RegisterPressure::getLiveOut(const BasicBlock *block) const {
+  std::map<const BasicBlock *, BlockLiveness>::const_iterator iter =
+      blocks.find(block);
+  if (iter == blocks.end())
+    return std::vector<int>(RegisterClassNumber, 0);
+  return countClasses(iter->second.liveOut);
+}
+
+//------------------------------------------------------------------------------
+std::vector<int> RegisterPressure::getMaxLive(const BasicBlock *block) const {
+  std::map<const BasicBlock *, BlockLiveness>::const_iterator iter =
+      blocks.find(block);
+  if (iter == blocks.end())
+    return std::vector<int>(RegisterClassNumber, 0);
+  return iter->second.maxLive;
+}
+
+//------------------------------------------------------------------------------
+int RegisterPressure::getMaxLiveValues(const BasicBlock *block) const {
+  std::map<const BasicBlock *, BlockLiveness>::const_iterator iter =
+      blocks.find(block);
+  return iter == blocks.end() ? 0 : iter->second.maxLiveValues;
+}
+
+//------------------------------------------------------------------------------
+int RegisterPressure::getMaxLiveRegisters(const BasicBlock *block) const {
+  std::map<const BasicBlock *, BlockLiveness>::const_iterator iter =
+      blocks.find(block);
+  return iter == blocks.end() ? 0 : iter->second.maxLiveRegisters;
+}
+
+//------------------------------------------------------------------------------
+int RegisterPressure::getMaxLiveRegisters() const {
+  int result = 0;
+  for (std::map<const BasicBlock *, BlockLiveness>::const_iterator
+           iter = blocks.begin(),
+           end = blocks.end();
+       iter != end; ++iter) {
+    result = std::max(result, iter->second.maxLiveRegisters);
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+const char *RegisterPressure::getClassName(RegisterClass registerClass) {
+  return CLASS_NAMES[registerClass];
+}
+
+//------------------------------------------------------------------------------
+int RegisterPressure::getClass(const Type *type) {
+  bool isVector = type->isVectorTy();
+  if (isVector)
+    type = type->getVectorElementType();
+
+  if (type->isIntegerTy() || type->isPointerTy())
+    return isVector ? VectorInt : ScalarInt;
+  if (type->isFloatingPointTy())
+    return isVector ? VectorFloat : ScalarFloat;
+  return -1;
+}
+
+//------------------------------------------------------------------------------
+// Number the arguments and the instructions kept in registers.
+void RegisterPressure::numberValues(Function &function,
+                                    DivergenceAnalysis *divergence,
+                                    unsigned int coarseningFactor) {
+  std::vector<Value *> values;
+  for (Function::arg_iterator iter = function.arg_begin(),
+                              end = function.arg_end();
+       iter != end; ++iter) {
+    values.push_back(iter);
+  }
+  for (Function::iterator blockIter = function.begin(),
+                          blockEnd = function.end();
+       blockIter != blockEnd; ++blockIter) {
+    for (BasicBlock::iterator iter = blockIter->begin(),
+                              end = blockIter->end();
+         iter != end; ++iter) {
+      values.push_back(iter);
+    }
+  }
+
+  for (std::vector<Value *>::iterator iter = values.begin(),
+                                      end = values.end();
+       iter != end; ++iter) {
+    Value *value = *iter;
+    int registerClass = getClass(value->getType());
+    if (registerClass < 0)
+      continue;
+
+    unsigned int copies = 1;
+    Instruction *inst = dyn_cast<Instruction>(value);
+    if (divergence != NULL && inst != NULL && divergence->isDivergent(inst))
+      copies = coarseningFactor;
+
+    indices[value] = classes.size();
+    classes.push_back(registerClass);
+    unsigned int words = (getRegisterBytes(value->getType()) + 3) / 4;
+    registers.push_back(copies * words);
+  }
+}
+
+//------------------------------------------------------------------------------
+int RegisterPressure::getIndex(const Value *value) const {
+  std::map<const Value *, int>::const_iterator iter = indices.find(value);
+  return iter == indices.end() ? -1 : iter->second;
+}
+
+//------------------------------------------------------------------------------
+// Iterate the dataflow equations to a fixed point:
+// liveOut(B) = U_S (liveIn(S) - phis(S)) + phiUses(S, B)
+// liveIn(B) = uses(B) + (liveOut(B) - defs(B))
+// where the uses of the phis are on the incoming edges, not in the block.
+void RegisterPressure::computeLiveSets(Function &function) {
+  unsigned int valueNumber = classes.size();
+
+  // Upward exposed uses and definitions of each block.
+  std::map<const BasicBlock *, BitVector> uses;
+  std::map<const BasicBlock *, BitVector> defs;
+  std::map<const BasicBlock *, BitVector> phiDefs;
+  std::vector<BasicBlock *> worklist;
+  for (Function::iterator blockIter = function.begin(),
+                          blockEnd = function.end();
+       blockIter != blockEnd; ++blockIter) {
+    BasicBlock *block = blockIter;
+    BitVector &blockUses = uses[block];
+    BitVector &blockDefs = defs[block];
+    BitVector &blockPhiDefs = phiDefs[block];
+    blockUses.resize(valueNumber);
+    blockDefs.resize(valueNumber);
+    blockPhiDefs.resize(valueNumber);
+    blocks[block].liveIn.resize(valueNumber);
+    blocks[block].liveOut.resize(valueNumber);
+
+    for (BasicBlock::iterator iter = block->begin(), end = block->end();
+         iter != end; ++iter) {
+      Instruction *inst = iter;
+      if (!isa<PHINode>(inst)) {
+        for (Instruction::op_iterator opIter = inst->op_begin(),
+                                      opEnd = inst->op_end();
+             opIter != opEnd; ++opIter) {
+          int index = getIndex(*opIter);
+          if (index >= 0 && !blockDefs.test(index))
+            blockUses.set(index);
+        }
+      }
+
+      int index = getIndex(inst);
+      if (index < 0)
+        continue;
+      blockDefs.set(index);
+      if (isa<PHINode>(inst))
+        blockPhiDefs.set(index);
+    }
+
+    worklist.push_back(block);
+  }
+
+  // Visit the blocks bottom up first, the fixed point is reached sooner: the
+  // worklist is popped from the back, the last block of the function first.
+  // Predecessors are queued at the front.
+  std::set<BasicBlock *> queued(worklist.begin(), worklist.end());
+  while (!worklist.empty()) {
+    BasicBlock *block = worklist.back();
+    worklist.pop_back();
+    queued.erase(block);
+    BlockLiveness &liveness = blocks[block];
+
+    BitVector liveOut(valueNumber);
+    for (succ_iterator iter = succ_begin(block), end = succ_end(block);
+         iter != end; ++iter) {
+      BasicBlock *successor = *iter;
+      BitVector successorIn = blocks[successor].liveIn;
+      successorIn.reset(phiDefs[successor]);
+      liveOut |= successorIn;
+      addPhiUses(block, successor, liveOut);
+    }
+
+    BitVector liveIn = liveOut;
+    liveIn.reset(defs[block]);
+    liveIn |= uses[block];
+    liveness.liveOut = liveOut;
+
+    if (liveIn == liveness.liveIn)
+      continue;
+    liveness.liveIn = liveIn;
+
+    for (pred_iterator iter = pred_begin(block), end = pred_end(block);
+         iter != end; ++iter) {
+      BasicBlock *pred = *iter;
+      if (queued.insert(pred).second)
+        worklist.insert(worklist.begin(), pred);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void RegisterPressure::addPhiUses(const BasicBlock *block,
+                                  const BasicBlock *successor,
+                                  BitVector &live) const {
+  for (BasicBlock::const_iterator iter = successor->begin();
+       isa<PHINode>(iter); ++iter) {
+    const PHINode *phi = cast<PHINode>(iter);
+    int index = getIndex(phi->getIncomingValueForBlock(block));
+    if (index >= 0)
+      live.set(index);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Walk the block backwards from its live out set. The phis are defined
+// together at the entry of the block.
+void RegisterPressure::computeMaxLive(const BasicBlock *block,
+                                      BlockLiveness &liveness) const {
+  liveness.maxLive.assign(RegisterClassNumber, 0);
+  liveness.maxLiveValues = 0;
+  liveness.maxLiveRegisters = 0;
+
+  BitVector live = liveness.liveOut;
+  addLive(live, liveness.maxLive, liveness.maxLiveValues,
+          liveness.maxLiveRegisters);
+
+  for (BasicBlock::const_reverse_iterator iter = block->rbegin(),
+                                          end = block->rend();
+       iter != end && !isa<PHINode>(&*iter); ++iter) {
+    const Instruction *inst = &*iter;
+    int index = getIndex(inst);
+    if (index >= 0)
+      live.reset(index);
+
+    for (User::const_op_iterator opIter = inst->op_begin(),
+                                 opEnd = inst->op_end();
+         opIter != opEnd; ++opIter) {
+      int opIndex = getIndex(*opIter);
+      if (opIndex >= 0)
+        live.set(opIndex);
+    }
+
+    addLive(live, liveness.maxLive, liveness.maxLiveValues,
+            liveness.maxLiveRegisters);
+  }
+}
+
+//------------------------------------------------------------------------------
+void RegisterPressure::addLive(const BitVector &live,
+                               std::vector<int> &maxLive, int &maxValues,
+                               int &maxRegisters) const {
+  std::vector<int> classNumbers = countClasses(live);
+  int values = 0;
+  for (int index = 0; index < RegisterClassNumber; ++index) {
+    maxLive[index] = std::max(maxLive[index], classNumbers[index]);
+    values += classNumbers[index];
+  }
+
+  int liveRegisters = 0;
+  for (int index = live.find_first(); index >= 0;
+       index = live.find_next(index)) {
+    liveRegisters += registers[index];
+  }
+
+  maxValues = std::max(maxValues, values);
+  maxRegisters = std::max(maxRegisters, liveRegisters);
+}
+
+//------------------------------------------------------------------------------
+std::vector<int> RegisterPressure::countClasses(const BitVector &live) const {
+  std::vector<int> result(RegisterClassNumber, 0);
+  for (int index = live.find_first(); index >= 0;
+       index = live.find_next(index)) {
+    ++result[classes[index]];
+  }
+  return result;
+}
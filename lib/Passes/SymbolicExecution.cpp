@@ -1,21 +1,42 @@
+#define DEBUG_TYPE "symbolic_execution"
+
 #include "thrud/FeatureExtraction/SymbolicExecution.h"
 
 #include "llvm/Analysis/ScalarEvolution.h"
 
 #include "llvm/IR/Instructions.h"
 
+#include "llvm/InstVisitor.h"
+
+#include "thrud/Support/AccessTrace.h"
+#include "thrud/Support/CacheSimulator.h"
+#include "thrud/Support/DeviceProfile.h"
 #include "thrud/Support/NDRange.h"
 #include "thrud/Support/NDRangeSpace.h"
 #include "thrud/Support/OCLEnv.h"
 #include "thrud/Support/SubscriptAnalysis.h"
+#include "thrud/Support/ThreadPool.h"
 #include "thrud/Support/Utils.h"
+#include "thrud/Support/WarpSampler.h"
+#include "llvm/Support/InstIterator.h"
 #include "llvm/Support/YAMLTraits.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <set>
+#include <sstream>
 
 static cl::opt<std::string>
     kernelName("symbolic-kernel-name", cl::init(""), cl::Hidden,
                cl::desc("Name of the kernel to analyze"));
+static cl::opt<bool>
+    allKernels("symbolic-all-kernels", cl::init(false), cl::Hidden,
+               cl::desc("Analyze all the kernels of the module"));
+static cl::opt<unsigned int>
+    threadNumber("symbolic-threads", cl::init(0), cl::Hidden,
+                 cl::desc("Threads evaluating the warps, 0 for one for each "
+                          "processor"));
 
 static cl::opt<int> localSizeX("localSizeX", cl::init(128), cl::Hidden,
                                cl::desc("localSizeX for symbolic execution"));
@@ -34,6 +55,119 @@ static cl::opt<int>
     numberOfGroupsZ("numberOfGroupsZ", cl::init(1024), cl::Hidden,
                     cl::desc("numberOfGroupsZ for symbolic execution"));
 
+static cl::opt<WarpSampler::SamplingMode> warpSampling(
+    "symbolic-warps", cl::init(WarpSampler::FirstWarp), cl::Hidden,
+    cl::desc("Warps the memory accesses are evaluated on"),
+    cl::values(clEnumValN(WarpSampler::FirstWarp, "first",
+                          "First warp of the first group"),
+               clEnumValN(WarpSampler::AllWarps, "all",
+                          "All the warps of the NDRange"),
+               clEnumValN(WarpSampler::StratifiedWarps, "stratified",
+                          "Sample across groups and warp indices"),
+               clEnumValN(WarpSampler::ListedWarps, "list",
+                          "Warps listed with -symbolic-warp-list"),
+               clEnumValEnd));
+static cl::opt<unsigned int>
+    warpSamples("symbolic-warp-samples", cl::init(64), cl::Hidden,
+                cl::desc("Number of warps for stratified sampling"));
+static cl::opt<unsigned int>
+    maxWarps("symbolic-max-warps", cl::init(65536), cl::Hidden,
+             cl::desc("Maximum number of warps evaluated with "
+                      "-symbolic-warps=all"));
+static cl::opt<std::string>
+    warpList("symbolic-warp-list", cl::init(""), cl::Hidden,
+             cl::desc("Warps to evaluate: gx,gy,gz,warp;gx,gy,gz,warp;..."));
+
+enum CacheScheduling {
+  SequentialScheduling,
+  RoundRobinScheduling
+};
+
+static cl::opt<bool>
+    cacheSimulation("symbolic-cache", cl::init(false), cl::Hidden,
+                    cl::desc("Simulate the caches on the global memory "
+                             "accesses of the sampled warps"));
+static cl::opt<CacheScheduling> cacheScheduling(
+    "symbolic-cache-scheduling", cl::init(RoundRobinScheduling), cl::Hidden,
+    cl::desc("Order the requests of the warps reach the caches in"),
+    cl::values(clEnumValN(SequentialScheduling, "sequential",
+                          "Each warp runs to completion before the next"),
+               clEnumValN(RoundRobinScheduling, "round-robin",
+                          "Warps issue one request each in turn"),
+               clEnumValEnd));
+static cl::opt<unsigned int>
+    cacheLoopIterations("symbolic-cache-loop-iterations", cl::init(64),
+                        cl::Hidden,
+                        cl::desc("Iterations of each loop simulated, the "
+                                 "rest are extrapolated"));
+static cl::opt<unsigned int> l1Size("symbolic-l1-size", cl::init(16 * 1024),
+                                    cl::Hidden, cl::desc("L1 size in bytes"));
+static cl::opt<unsigned int>
+    l1LineSize("symbolic-l1-line", cl::init(0), cl::Hidden,
+               cl::desc("L1 line size in bytes, 0 for the cache line size "
+                        "of the device"));
+static cl::opt<unsigned int> l1Ways("symbolic-l1-ways", cl::init(4),
+                                    cl::Hidden, cl::desc("L1 associativity"));
+static cl::opt<unsigned int> l2Size("symbolic-l2-size", cl::init(768 * 1024),
+                                    cl::Hidden, cl::desc("L2 size in bytes"));
+static cl::opt<unsigned int> l2LineSize("symbolic-l2-line", cl::init(32),
+                                        cl::Hidden,
+                                        cl::desc("L2 line size in bytes"));
+static cl::opt<unsigned int> l2Ways("symbolic-l2-ways", cl::init(16),
+                                    cl::Hidden, cl::desc("L2 associativity"));
+
+static cl::opt<std::string>
+    traceFile("symbolic-trace", cl::init(""), cl::Hidden,
+              cl::desc("Write the memory accesses of the evaluated work items "
+                       "to this binary trace, with a YAML index in "
+                       "<file>.yaml"));
+static cl::opt<unsigned int>
+    traceLoopIterations("symbolic-trace-loop-iterations", cl::init(0),
+                        cl::Hidden,
+                        cl::desc("Iterations of each loop written to the "
+                                 "trace, 0 for all of them"));
+
+Value *getGlobalMemoryPointer(Instruction *inst);
+unsigned int getLog2Bucket(int value);
+void evaluateWarp(void *context, unsigned int warp, unsigned int thread);
+
+// Evaluate the memory accesses of a function on a warp, with the analysis
+// of the thread doing it.
+class WarpEvaluator : public InstVisitor<WarpEvaluator> {
+public:
+  WarpEvaluator(SubscriptAnalysis &subscriptAnalysis, LoopInfo *loopInfo,
+                WarpResults &results);
+
+  void visitLoadInst(LoadInst &loadInst);
+  void visitStoreInst(StoreInst &storeInst);
+
+private:
+  void visitMemoryInst(Value *pointer, std::vector<int> &resultVector);
+  void visitLocalMemoryInst(Value *pointer, std::vector<int> &resultVector);
+  void visitLoopMemoryInst(Instruction &inst, Value *pointer,
+                           std::vector<int> &resultVector,
+                           std::vector<int> &iterationVector,
+                           std::vector<int> &totalVector);
+  void visitLoopLocalMemoryInst(Instruction &inst, Value *pointer,
+                                std::vector<int> &resultVector,
+                                std::vector<int> &iterationVector);
+
+private:
+  SubscriptAnalysis &subscriptAnalysis;
+  LoopInfo *loopInfo;
+  WarpResults &results;
+  unsigned int localAddressSpace;
+};
+
+// State shared by the threads evaluating the warps.
+struct WarpTask {
+  Function *function;
+  LoopInfo *loopInfo;
+  const std::vector<Warp> *warps;
+  std::vector<SubscriptAnalysis> *analyses;
+  std::vector<WarpResults> *results;
+};
+
 char SymbolicExecution::ID = 0;
 static RegisterPass<SymbolicExecution>
     X("symbolic-execution",
@@ -49,9 +183,76 @@ using yaml::Output;
 namespace llvm {
 namespace yaml {
 
+//------------------------------------------------------------------------------
+// Sequence of ints.
+template <> struct SequenceTraits<std::vector<int> > {
+  static size_t size(IO &io, std::vector<int> &seq) { return seq.size(); }
+  static int &element(IO &, std::vector<int> &seq, size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+
+  static const bool flow = true;
+};
+
+//------------------------------------------------------------------------------
+// Sequence of floats.
+template <> struct SequenceTraits<std::vector<float> > {
+  static size_t size(IO &io, std::vector<float> &seq) { return seq.size(); }
+  static float &element(IO &, std::vector<float> &seq, size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+
+  static const bool flow = true;
+};
+
+//------------------------------------------------------------------------------
+// Sequence of unsigned 64 bit integers.
+template <> struct SequenceTraits<std::vector<uint64_t> > {
+  static size_t size(IO &io, std::vector<uint64_t> &seq) { return seq.size(); }
+  static uint64_t &element(IO &, std::vector<uint64_t> &seq, size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+
+  static const bool flow = true;
+};
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<AccessStats> {
+  static void mapping(IO &io, AccessStats &stats) {
+    io.mapRequired("min", stats.min);
+    io.mapRequired("mean", stats.mean);
+    io.mapRequired("max", stats.max);
+    io.mapRequired("unknown", stats.unknown);
+    io.mapOptional("histogram", stats.histogram);
+    io.mapOptional("log2_histogram", stats.log2Histogram);
+  }
+};
+
+//------------------------------------------------------------------------------
+// Sequence of access statistics.
+template <> struct SequenceTraits<std::vector<AccessStats> > {
+  static size_t size(IO &io, std::vector<AccessStats> &seq) {
+    return seq.size();
+  }
+  static AccessStats &element(IO &, std::vector<AccessStats> &seq,
+                              size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+};
+
 //------------------------------------------------------------------------------
 template <> struct MappingTraits<SymbolicExecution> {
   static void mapping(IO &io, SymbolicExecution &exe) {
+    io.mapRequired("kernel", exe.kernel);
+    io.mapRequired("kernel_arguments", exe.kernelArguments);
     io.mapRequired("load_transactions", exe.loadTransactions);
     io.mapRequired("store_transactions", exe.storeTransactions);
 
@@ -62,55 +263,163 @@ template <> struct MappingTraits<SymbolicExecution> {
     io.mapRequired("store_bank_conflicts", exe.storeBankConflicts);
     io.mapRequired("loop_load_bank_conflicts", exe.loopLoadBankConflicts);
     io.mapRequired("loop_store_bank_conflicts", exe.loopStoreBankConflicts);
-  }
-};
 
-//------------------------------------------------------------------------------
-// Sequence of ints.
-template <> struct SequenceTraits<std::vector<int> > {
-  static size_t size(IO &io, std::vector<int> &seq) { return seq.size(); }
-  static int &element(IO &, std::vector<int> &seq, size_t index) {
-    if (index >= seq.size())
-      seq.resize(index + 1);
-    return seq[index];
-  }
+    io.mapRequired("loop_load_iterations", exe.loopLoadIterations);
+    io.mapRequired("loop_store_iterations", exe.loopStoreIterations);
+    io.mapRequired("loop_local_load_iterations",
+                   exe.loopLocalLoadIterations);
+    io.mapRequired("loop_local_store_iterations",
+                   exe.loopLocalStoreIterations);
+    io.mapRequired("loop_load_total_transactions",
+                   exe.loopLoadTotalTransactions);
+    io.mapRequired("loop_store_total_transactions",
+                   exe.loopStoreTotalTransactions);
 
-  static const bool flow = true;
+    io.mapRequired("l1_hit_rate", exe.l1HitRate);
+    io.mapRequired("l2_hit_rate", exe.l2HitRate);
+    io.mapRequired("dram_bytes", exe.dramBytes);
+    io.mapRequired("access_l1_hit_rates", exe.accessL1HitRates);
+    io.mapRequired("access_l2_hit_rates", exe.accessL2HitRates);
+    io.mapRequired("access_dram_bytes", exe.accessDramBytes);
+
+    io.mapRequired("sampled_warps", exe.sampledWarps);
+    io.mapRequired("load_transactions_stats", exe.loadTransactionStats);
+    io.mapRequired("store_transactions_stats", exe.storeTransactionStats);
+    io.mapRequired("loop_load_transactions_stats",
+                   exe.loopLoadTransactionStats);
+    io.mapRequired("loop_store_transactions_stats",
+                   exe.loopStoreTransactionStats);
+    io.mapRequired("load_bank_conflicts_stats", exe.loadBankConflictStats);
+    io.mapRequired("store_bank_conflicts_stats", exe.storeBankConflictStats);
+    io.mapRequired("loop_load_bank_conflicts_stats",
+                   exe.loopLoadBankConflictStats);
+    io.mapRequired("loop_store_bank_conflicts_stats",
+                   exe.loopStoreBankConflictStats);
+    io.mapRequired("loop_load_iterations_stats", exe.loopLoadIterationStats);
+    io.mapRequired("loop_store_iterations_stats",
+                   exe.loopStoreIterationStats);
+    io.mapRequired("loop_local_load_iterations_stats",
+                   exe.loopLocalLoadIterationStats);
+    io.mapRequired("loop_local_store_iterations_stats",
+                   exe.loopLocalStoreIterationStats);
+    io.mapRequired("loop_load_total_transactions_stats",
+                   exe.loopLoadTotalTransactionStats);
+    io.mapRequired("loop_store_total_transactions_stats",
+                   exe.loopStoreTotalTransactionStats);
+  }
 };
 
 }
 }
 
+NDRangeSpace getCommandLineNDRangeSpace() {
+  return NDRangeSpace(localSizeX, localSizeY, localSizeZ, numberOfGroupsX,
+                      numberOfGroupsY, numberOfGroupsZ);
+}
+
 SymbolicExecution::SymbolicExecution()
-    : FunctionPass(ID),
-      ndrSpace(localSizeX, localSizeY, localSizeZ, numberOfGroupsX,
-               numberOfGroupsY, numberOfGroupsZ) {
+    : FunctionPass(ID), subscriptAnalysis(NULL), ocl(NULL),
+      ndrSpace(getCommandLineNDRangeSpace()) {
 }
 
 SymbolicExecution::~SymbolicExecution() {
+  delete subscriptAnalysis;
   delete ocl;
 }
 
 //------------------------------------------------------------------------------
 bool SymbolicExecution::runOnFunction(Function &function) {
-  if (function.getName() != kernelName)
+  if (allKernels ? !isKernel(&function) : function.getName() != kernelName)
     return false;
 
-  loopInfo = &getAnalysis<LoopInfo>();
-  scalarEvolution = &getAnalysis<ScalarEvolution>();
-  ndr = &getAnalysis<NDRange>();
+  LoopInfo *loopInfo = &getAnalysis<LoopInfo>();
+  ScalarEvolution *scalarEvolution = &getAnalysis<ScalarEvolution>();
+  NDRange *ndr = &getAnalysis<NDRange>();
 
-  ocl = new OCLEnv(function, ndr, ndrSpace);
-  Warp warp(0, 0, 0, 0, ndrSpace);
-  subscriptAnalysis = new SubscriptAnalysis(scalarEvolution, ocl, warp);
+  // Analyze the kernel once for each set of argument values, emitting a
+  // document (and a trace) for each one.
+  const std::vector<OCLEnv::ArgumentSet> &argumentSets =
+      OCLEnv::getArgumentSets();
+  for (unsigned int index = 0; index < argumentSets.size(); ++index) {
+    analyze(function, loopInfo, scalarEvolution, ndr, argumentSets[index]);
 
-  initBuffers();
-  visit(function);
-  dump();
+    if (!traceFile.empty()) {
+      std::stringstream fileName;
+      fileName << traceFile;
+      if (allKernels)
+        fileName << "." << kernel;
+      if (index != 0)
+        fileName << "." << index;
+      exportTrace(function, fileName.str());
+    }
+
+    dump();
+  }
 
   return false;
 }
 
+//------------------------------------------------------------------------------
+void SymbolicExecution::analyze(Function &function, LoopInfo *loopInfo,
+                                ScalarEvolution *scalarEvolution, NDRange *ndr,
+                                const OCLEnv::ArgumentSet &arguments) {
+  this->loopInfo = loopInfo;
+  this->scalarEvolution = scalarEvolution;
+  this->ndr = ndr;
+
+  std::vector<Warp> warps = sampleWarps();
+
+  delete subscriptAnalysis;
+  delete ocl;
+  ocl = new OCLEnv(function, ndr, ndrSpace, arguments);
+  subscriptAnalysis = new SubscriptAnalysis(scalarEvolution, ocl, warps[0]);
+  kernel = function.getName();
+  kernelArguments = OCLEnv::toString(arguments);
+
+  initBuffers();
+  analyzeWarps(function, warps);
+  sampledWarps = warps.size();
+
+  aggregateSamples(loadTransactionSamples, loadTransactions,
+                   loadTransactionStats, false);
+  aggregateSamples(storeTransactionSamples, storeTransactions,
+                   storeTransactionStats, false);
+  aggregateSamples(loopLoadTransactionSamples, loopLoadTransactions,
+                   loopLoadTransactionStats, false);
+  aggregateSamples(loopStoreTransactionSamples, loopStoreTransactions,
+                   loopStoreTransactionStats, false);
+  aggregateSamples(loadBankConflictSamples, loadBankConflicts,
+                   loadBankConflictStats, false);
+  aggregateSamples(storeBankConflictSamples, storeBankConflicts,
+                   storeBankConflictStats, false);
+  aggregateSamples(loopLoadBankConflictSamples, loopLoadBankConflicts,
+                   loopLoadBankConflictStats, false);
+  aggregateSamples(loopStoreBankConflictSamples, loopStoreBankConflicts,
+                   loopStoreBankConflictStats, false);
+  aggregateSamples(loopLoadIterationSamples, loopLoadIterations,
+                   loopLoadIterationStats, true);
+  aggregateSamples(loopStoreIterationSamples, loopStoreIterations,
+                   loopStoreIterationStats, true);
+  aggregateSamples(loopLocalLoadIterationSamples, loopLocalLoadIterations,
+                   loopLocalLoadIterationStats, true);
+  aggregateSamples(loopLocalStoreIterationSamples, loopLocalStoreIterations,
+                   loopLocalStoreIterationStats, true);
+  aggregateSamples(loopLoadTotalTransactionSamples, loopLoadTotalTransactions,
+                   loopLoadTotalTransactionStats, true);
+  aggregateSamples(loopStoreTotalTransactionSamples,
+                   loopStoreTotalTransactions, loopStoreTotalTransactionStats,
+                   true);
+
+  cacheSimulated = cacheSimulation;
+  if (cacheSimulation)
+    simulateCaches(function, warps);
+}
+
+//------------------------------------------------------------------------------
+const NDRangeSpace &SymbolicExecution::getNDRangeSpace() const {
+  return ndrSpace;
+}
+
 //------------------------------------------------------------------------------
 void SymbolicExecution::initBuffers() {
   loadTransactions.clear();
@@ -122,6 +431,447 @@ void SymbolicExecution::initBuffers() {
   storeBankConflicts.clear();
   loopLoadBankConflicts.clear();
   loopStoreBankConflicts.clear();
+
+  loopLoadIterations.clear();
+  loopStoreIterations.clear();
+  loopLocalLoadIterations.clear();
+  loopLocalStoreIterations.clear();
+  loopLoadTotalTransactions.clear();
+  loopStoreTotalTransactions.clear();
+
+  cacheSimulated = false;
+  l1HitRate = 0;
+  l2HitRate = 0;
+  dramBytes = 0;
+  accessL1HitRates.clear();
+  accessL2HitRates.clear();
+  accessDramBytes.clear();
+  traceAccesses.clear();
+  tracedIterations = 0;
+  baseAddresses.clear();
+
+  sampledWarps = 0;
+  loadTransactionStats.clear();
+  storeTransactionStats.clear();
+  loopLoadTransactionStats.clear();
+  loopStoreTransactionStats.clear();
+  loadBankConflictStats.clear();
+  storeBankConflictStats.clear();
+  loopLoadBankConflictStats.clear();
+  loopStoreBankConflictStats.clear();
+  loopLoadIterationStats.clear();
+  loopStoreIterationStats.clear();
+  loopLocalLoadIterationStats.clear();
+  loopLocalStoreIterationStats.clear();
+  loopLoadTotalTransactionStats.clear();
+  loopStoreTotalTransactionStats.clear();
+
+  loadTransactionSamples.clear();
+  storeTransactionSamples.clear();
+  loopLoadTransactionSamples.clear();
+  loopStoreTransactionSamples.clear();
+  loadBankConflictSamples.clear();
+  storeBankConflictSamples.clear();
+  loopLoadBankConflictSamples.clear();
+  loopStoreBankConflictSamples.clear();
+  loopLoadIterationSamples.clear();
+  loopStoreIterationSamples.clear();
+  loopLocalLoadIterationSamples.clear();
+  loopLocalStoreIterationSamples.clear();
+  loopLoadTotalTransactionSamples.clear();
+  loopStoreTotalTransactionSamples.clear();
+}
+
+//------------------------------------------------------------------------------
+std::vector<Warp> SymbolicExecution::sampleWarps() {
+  WarpSampler sampler(ndrSpace);
+  switch (warpSampling) {
+  case WarpSampler::FirstWarp:
+    return sampler.getFirst();
+  case WarpSampler::AllWarps:
+    return sampler.getAll(maxWarps);
+  case WarpSampler::StratifiedWarps:
+    return sampler.getStratified(warpSamples);
+  case WarpSampler::ListedWarps: {
+    std::vector<Warp> warps;
+    std::string error;
+    if (!sampler.getListed(warpList, warps, error))
+      report_fatal_error("Invalid -symbolic-warp-list: " + error);
+    return warps;
+  }
+  }
+
+  llvm_unreachable("Unknown warp sampling");
+}
+
+//------------------------------------------------------------------------------
+void SymbolicExecution::analyzeWarps(Function &function,
+                                     const std::vector<Warp> &warps) {
+  // Compile everything the warps need and load the device profile while
+  // there is a single thread: from here on evaluation is read only.
+  subscriptAnalysis->compilePrograms(function, loopInfo);
+  getDeviceProfile();
+
+  ThreadPool pool(threadNumber);
+  std::vector<SubscriptAnalysis> analyses(pool.getThreadNumber(),
+                                          *subscriptAnalysis);
+  std::vector<WarpResults> results(warps.size());
+
+  WarpTask task;
+  task.function = &function;
+  task.loopInfo = loopInfo;
+  task.warps = &warps;
+  task.analyses = &analyses;
+  task.results = &results;
+  pool.run(warps.size(), evaluateWarp, &task);
+
+  // Collect in warp order, the results do not depend on the scheduling.
+  for (std::vector<WarpResults>::iterator iter = results.begin(),
+                                          iterEnd = results.end();
+       iter != iterEnd; ++iter) {
+    collectSamples(*iter);
+  }
+}
+
+//------------------------------------------------------------------------------
+void SymbolicExecution::collectSamples(const WarpResults &results) {
+  collectSamples(results.loadTransactions, loadTransactionSamples);
+  collectSamples(results.storeTransactions, storeTransactionSamples);
+  collectSamples(results.loopLoadTransactions, loopLoadTransactionSamples);
+  collectSamples(results.loopStoreTransactions, loopStoreTransactionSamples);
+  collectSamples(results.loadBankConflicts, loadBankConflictSamples);
+  collectSamples(results.storeBankConflicts, storeBankConflictSamples);
+  collectSamples(results.loopLoadBankConflicts, loopLoadBankConflictSamples);
+  collectSamples(results.loopStoreBankConflicts,
+                 loopStoreBankConflictSamples);
+  collectSamples(results.loopLoadIterations, loopLoadIterationSamples);
+  collectSamples(results.loopStoreIterations, loopStoreIterationSamples);
+  collectSamples(results.loopLocalLoadIterations,
+                 loopLocalLoadIterationSamples);
+  collectSamples(results.loopLocalStoreIterations,
+                 loopLocalStoreIterationSamples);
+  collectSamples(results.loopLoadTotalTransactions,
+                 loopLoadTotalTransactionSamples);
+  collectSamples(results.loopStoreTotalTransactions,
+                 loopStoreTotalTransactionSamples);
+}
+
+//------------------------------------------------------------------------------
+void SymbolicExecution::collectSamples(const std::vector<int> &results,
+                                       SampleMatrix &samples) {
+  // Accesses are visited in the same order for every warp.
+  samples.resize(results.size());
+  for (unsigned int index = 0; index < results.size(); ++index) {
+    samples[index].push_back(results[index]);
+  }
+}
+
+//------------------------------------------------------------------------------
+void SymbolicExecution::aggregateSamples(const SampleMatrix &samples,
+                                         std::vector<int> &means,
+                                         std::vector<AccessStats> &stats,
+                                         bool unbounded) {
+  means.clear();
+  stats.clear();
+  for (SampleMatrix::const_iterator iter = samples.begin(),
+                                    iterEnd = samples.end();
+       iter != iterEnd; ++iter) {
+    AccessStats accessStats = aggregate(*iter, unbounded);
+    means.push_back((int)floor(accessStats.mean + 0.5));
+    stats.push_back(accessStats);
+  }
+}
+
+//------------------------------------------------------------------------------
+void SymbolicExecution::simulateCaches(Function &function,
+                                       const std::vector<Warp> &warps) {
+  // Number the global memory accesses in program order.
+  traceAccesses.clear();
+  for (inst_iterator iter = inst_begin(function), iterEnd = inst_end(function);
+       iter != iterEnd; ++iter) {
+    Instruction *inst = &*iter;
+    if (getGlobalMemoryPointer(inst) != NULL) {
+      int index = traceAccesses.size();
+      traceAccesses[inst] = index;
+    }
+  }
+  tracedIterations = std::max((unsigned int)cacheLoopIterations, 1u);
+
+  std::vector<MemoryTrace> traces(warps.size());
+  for (unsigned int index = 0; index < warps.size(); ++index) {
+    subscriptAnalysis->setWarp(warps[index]);
+    std::vector<char> active(warps[index].size(), 1);
+    SCEVProgram::IterationMap iterations;
+    traceBlocks(function, NULL, 1, active, iterations, traces[index]);
+  }
+
+  unsigned int l1Line = l1LineSize;
+  if (l1Line == 0)
+    l1Line = getDeviceProfile().cachelineSize;
+  CacheSimulator simulator(Cache(l1Size, l1Line, l1Ways),
+                           Cache(l2Size, l2LineSize, l2Ways),
+                           traceAccesses.size());
+
+  // Replay the traces in the scheduling order.
+  std::vector<unsigned int> positions(traces.size(), 0);
+  bool pending = true;
+  while (pending) {
+    pending = false;
+    for (unsigned int index = 0; index < traces.size(); ++index) {
+      MemoryTrace &trace = traces[index];
+      unsigned int &position = positions[index];
+      unsigned int end = trace.size();
+      if (cacheScheduling == RoundRobinScheduling)
+        end = std::min(position + 1, end);
+      for (; position < end; ++position) {
+        const MemoryRequest &request = trace[position];
+        simulator.access(request.access, request.isStore, request.addresses,
+                         request.unknownNumber, request.weight);
+      }
+      pending |= position < trace.size();
+    }
+  }
+
+  // Scale the traffic of the sampled warps to the NDRange.
+  double scale = (double)WarpSampler(ndrSpace).getWarpNumber() / warps.size();
+
+  CacheStats total = simulator.getTotalStats();
+  l1HitRate = total.getL1HitRate();
+  l2HitRate = total.getL2HitRate();
+  dramBytes = total.dramBytes * scale;
+  for (unsigned int index = 0; index < traceAccesses.size(); ++index) {
+    const CacheStats &stats = simulator.getStats(index);
+    accessL1HitRates.push_back(stats.getL1HitRate());
+    accessL2HitRates.push_back(stats.getL2HitRate());
+    accessDramBytes.push_back(stats.dramBytes * scale);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Trace the accesses in traceAccesses of the blocks directly in loop (in the
+// function if loop is NULL) in program order. Loops nested in it are traced
+// when their first block is met.
+void SymbolicExecution::traceBlocks(Function &function, const Loop *loop,
+                                    double weight,
+                                    const std::vector<char> &active,
+                                    SCEVProgram::IterationMap &iterations,
+                                    MemoryTrace &trace) {
+  std::set<const Loop *> tracedLoops;
+  for (Function::iterator iter = function.begin(), iterEnd = function.end();
+       iter != iterEnd; ++iter) {
+    BasicBlock *block = iter;
+    if (loop != NULL && !loop->contains(block))
+      continue;
+
+    const Loop *blockLoop = loopInfo->getLoopFor(block);
+    if (blockLoop == loop) {
+      for (BasicBlock::iterator instIter = block->begin(),
+                                instEnd = block->end();
+           instIter != instEnd; ++instIter) {
+        Instruction *inst = instIter;
+        if (traceAccesses.count(inst) != 0)
+          traceAccess(inst, weight, active, iterations, trace);
+      }
+      continue;
+    }
+
+    const Loop *child = blockLoop;
+    while (child->getParentLoop() != loop)
+      child = child->getParentLoop();
+
+    if (tracedLoops.insert(child).second)
+      traceLoop(function, child, weight, active, iterations, trace);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Consecutive iterations are traced to preserve the reuse between them, up to
+// tracedIterations (all of them if it is 0). The rest is extrapolated.
+void SymbolicExecution::traceLoop(Function &function, const Loop *loop,
+                                  double weight,
+                                  const std::vector<char> &active,
+                                  SCEVProgram::IterationMap &iterations,
+                                  MemoryTrace &trace) {
+  std::vector<int> tripCounts =
+      subscriptAnalysis->getTripCounts(loop, iterations);
+  int maxTripCount = 0;
+  for (unsigned int index = 0; index < tripCounts.size(); ++index) {
+    if (active[index])
+      maxTripCount = std::max(maxTripCount, tripCounts[index]);
+  }
+
+  if (maxTripCount == 0)
+    return;
+
+  int simulated = maxTripCount;
+  if (tracedIterations != 0)
+    simulated = std::min(maxTripCount, (int)tracedIterations);
+  double iterationWeight = weight * maxTripCount / simulated;
+
+  std::vector<char> iterationActive(active.size());
+  for (int iteration = 0; iteration < simulated; ++iteration) {
+    for (unsigned int index = 0; index < active.size(); ++index) {
+      iterationActive[index] = active[index] && iteration < tripCounts[index];
+    }
+
+    iterations[loop] = iteration;
+    traceBlocks(function, loop, iterationWeight, iterationActive, iterations,
+                trace);
+  }
+  iterations.erase(loop);
+}
+
+//------------------------------------------------------------------------------
+void SymbolicExecution::traceAccess(Instruction *inst, double weight,
+                                    const std::vector<char> &active,
+                                    const SCEVProgram::IterationMap &iterations,
+                                    MemoryTrace &trace) {
+  std::vector<int> offsets;
+  const SCEVUnknown *base = subscriptAnalysis->getMemoryOffsets(
+      getMemoryPointer(inst), iterations, offsets);
+
+  MemoryRequest request;
+  request.access = traceAccesses[inst];
+  request.isStore = isa<StoreInst>(inst);
+  request.unknownNumber = 0;
+  request.weight = weight;
+
+  for (unsigned int index = 0; index < offsets.size(); ++index) {
+    if (!active[index])
+      continue;
+
+    if (base == NULL || offsets[index] == OCLEnv::UNKNOWN_MEMORY_LOCATION) {
+      ++request.unknownNumber;
+      request.unknownWorkItems.push_back(index);
+    } else {
+      request.addresses.push_back(getBaseAddress(base->getValue()) +
+                                  offsets[index]);
+      request.workItems.push_back(index);
+    }
+  }
+
+  if (request.addresses.empty() && request.unknownNumber == 0)
+    return;
+  trace.push_back(request);
+}
+
+//------------------------------------------------------------------------------
+// Buffers are placed 4GB apart: offsets are 32 bit integers.
+uint64_t SymbolicExecution::getBaseAddress(Value *base) {
+  std::map<Value *, uint64_t>::iterator iter = baseAddresses.find(base);
+  if (iter != baseAddresses.end())
+    return iter->second;
+
+  uint64_t address = (uint64_t)(baseAddresses.size() + 1) << 32;
+  baseAddresses[base] = address;
+  return address;
+}
+
+//------------------------------------------------------------------------------
+// The trace has the global and local memory accesses of the sampled warps,
+// warp after warp, in program order.
+void SymbolicExecution::exportTrace(Function &function,
+                                    const std::string &fileName) {
+  AccessTraceIndex index;
+  index.trace = fileName;
+  index.kernel = function.getName();
+  index.kernelArguments = kernelArguments;
+  index.recordSize = sizeof(AccessRecord);
+  index.loopIterations = traceLoopIterations;
+  for (int direction = 0; direction < 3; ++direction) {
+    index.localSize.push_back(ndrSpace.getLocalSize(direction));
+    index.numberOfGroups.push_back(ndrSpace.getNumberOfGroups(direction));
+  }
+
+  // Number the accesses in program order.
+  traceAccesses.clear();
+  for (inst_iterator iter = inst_begin(function), iterEnd = inst_end(function);
+       iter != iterEnd; ++iter) {
+    Instruction *inst = &*iter;
+    if (getGlobalMemoryPointer(inst) == NULL && !isLocalMemoryAccess(inst))
+      continue;
+
+    Value *pointer = getMemoryPointer(inst);
+    const Loop *loop = loopInfo->getLoopFor(inst->getParent());
+
+    TraceAccess access;
+    access.id = traceAccesses.size();
+    raw_string_ostream instruction(access.instruction);
+    instruction << *inst;
+    instruction.flush();
+    access.block = inst->getParent()->getName();
+    access.isStore = isa<StoreInst>(inst);
+    access.addressSpace = pointer->getType()->getPointerAddressSpace();
+    access.size = getRegisterBytes(
+        pointer->getType()->getPointerElementType());
+    access.loopDepth = loop == NULL ? 0 : loop->getLoopDepth();
+
+    traceAccesses[inst] = access.id;
+    index.accesses.push_back(access);
+  }
+  tracedIterations = traceLoopIterations;
+
+  AccessTraceWriter writer;
+  std::string error;
+  if (!writer.open(fileName, error))
+    report_fatal_error("Cannot write the trace " + fileName + ": " + error);
+
+  std::vector<Warp> warps = sampleWarps();
+  for (std::vector<Warp>::iterator warpIter = warps.begin(),
+                                   warpEnd = warps.end();
+       warpIter != warpEnd; ++warpIter) {
+    const std::vector<NDRangePoint> &points = warpIter->getPoints();
+    subscriptAnalysis->setWarp(*warpIter);
+
+    MemoryTrace trace;
+    std::vector<char> active(warpIter->size(), 1);
+    SCEVProgram::IterationMap iterations;
+    traceBlocks(function, NULL, 1, active, iterations, trace);
+
+    for (MemoryTrace::iterator iter = trace.begin(), iterEnd = trace.end();
+         iter != iterEnd; ++iter) {
+      const TraceAccess &access = index.accesses[iter->access];
+      AccessRecord record;
+      record.access = access.id;
+      record.size = access.size;
+      record.isStore = access.isStore;
+      record.addressSpace = access.addressSpace;
+
+      for (unsigned int item = 0; item < iter->workItems.size(); ++item) {
+        const NDRangePoint &point = points[iter->workItems[item]];
+        for (int direction = 0; direction < 3; ++direction)
+          record.globalId[direction] = point.getGlobal(direction);
+        record.address = iter->addresses[item];
+        record.flags = 0;
+        writer.write(record);
+      }
+
+      for (unsigned int item = 0; item < iter->unknownWorkItems.size();
+           ++item) {
+        const NDRangePoint &point = points[iter->unknownWorkItems[item]];
+        for (int direction = 0; direction < 3; ++direction)
+          record.globalId[direction] = point.getGlobal(direction);
+        record.address = 0;
+        record.flags = AccessRecord::UnknownAddress;
+        writer.write(record);
+      }
+    }
+  }
+
+  index.recordNumber = writer.getRecordNumber();
+  writer.close();
+
+  for (std::map<Value *, uint64_t>::iterator iter = baseAddresses.begin(),
+                                             iterEnd = baseAddresses.end();
+       iter != iterEnd; ++iter) {
+    TraceBuffer buffer;
+    buffer.name = iter->first->getName();
+    buffer.base = iter->second;
+    index.buffers.push_back(buffer);
+  }
+
+  if (!AccessTraceWriter::writeIndex(fileName + ".yaml", index, error))
+    report_fatal_error("Cannot write the trace index: " + error);
 }
 
 //------------------------------------------------------------------------------
@@ -133,54 +883,86 @@ void SymbolicExecution::getAnalysisUsage(AnalysisUsage &au) const {
 }
 
 //------------------------------------------------------------------------------
-void SymbolicExecution::visitLocalMemoryInst(Value *pointer, 
-                                             std::vector<int> &resultVector) {
-  resultVector.push_back(subscriptAnalysis->getBankConflictNumber(pointer));
+WarpEvaluator::WarpEvaluator(SubscriptAnalysis &subscriptAnalysis,
+                             LoopInfo *loopInfo, WarpResults &results)
+    : subscriptAnalysis(subscriptAnalysis), loopInfo(loopInfo),
+      results(results),
+      localAddressSpace(getDeviceProfile().localAddressSpace) {}
+
+//------------------------------------------------------------------------------
+void WarpEvaluator::visitLocalMemoryInst(Value *pointer,
+                                         std::vector<int> &resultVector) {
+  resultVector.push_back(subscriptAnalysis.getBankConflictNumber(pointer));
+}
+
+void WarpEvaluator::visitMemoryInst(Value *pointer,
+                                    std::vector<int> &resultVector) {
+  resultVector.push_back(subscriptAnalysis.getTransactionNumber(pointer));
 }
 
-void SymbolicExecution::visitMemoryInst(Value *pointer,
-                                        std::vector<int> &resultVector) {
-  resultVector.push_back(subscriptAnalysis->getTransactionNumber(pointer));
+void WarpEvaluator::visitLoopLocalMemoryInst(
+    Instruction &inst, Value *pointer, std::vector<int> &resultVector,
+    std::vector<int> &iterationVector) {
+  const Loop *loop = loopInfo->getLoopFor(inst.getParent());
+  int iterations = 0;
+  int total = 0;
+  resultVector.push_back(subscriptAnalysis.getLoopBankConflictNumber(
+      pointer, loop, iterations, total));
+  iterationVector.push_back(iterations);
 }
 
-void SymbolicExecution::visitStoreInst(StoreInst &storeInst) {
-  errs() << "Store!\n";
+void WarpEvaluator::visitLoopMemoryInst(Instruction &inst, Value *pointer,
+                                        std::vector<int> &resultVector,
+                                        std::vector<int> &iterationVector,
+                                        std::vector<int> &totalVector) {
+  const Loop *loop = loopInfo->getLoopFor(inst.getParent());
+  int iterations = 0;
+  int total = 0;
+  resultVector.push_back(subscriptAnalysis.getLoopTransactionNumber(
+      pointer, loop, iterations, total));
+  iterationVector.push_back(iterations);
+  totalVector.push_back(total);
+}
+
+void WarpEvaluator::visitStoreInst(StoreInst &storeInst) {
   Value *pointer = storeInst.getOperand(1);
 
-  if (const GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(pointer)) {
-    if (gep->getPointerAddressSpace() == OCLEnv::LOCAL_AS) {
-      if (isInLoop(storeInst, loopInfo))
-        visitLocalMemoryInst(pointer, loopStoreBankConflicts);
-      else {
-        visitLocalMemoryInst(pointer, storeBankConflicts);
-      }
-    } else {
-      if (isInLoop(storeInst, loopInfo))
-        visitMemoryInst(pointer, loopStoreTransactions);
-      else {
-        visitMemoryInst(pointer, storeTransactions);
-      }
-    }
+  // Local memory accesses are analyzed whatever their pointer is, global
+  // memory accesses only through GEPs.
+  if (storeInst.getPointerAddressSpace() == localAddressSpace) {
+    if (isInLoop(storeInst, loopInfo))
+      visitLoopLocalMemoryInst(storeInst, pointer,
+                               results.loopStoreBankConflicts,
+                               results.loopLocalStoreIterations);
+    else
+      visitLocalMemoryInst(pointer, results.storeBankConflicts);
+  } else if (isa<GetElementPtrInst>(pointer)) {
+    if (isInLoop(storeInst, loopInfo))
+      visitLoopMemoryInst(storeInst, pointer, results.loopStoreTransactions,
+                          results.loopStoreIterations,
+                          results.loopStoreTotalTransactions);
+    else
+      visitMemoryInst(pointer, results.storeTransactions);
   }
 }
 
-void SymbolicExecution::visitLoadInst(LoadInst &loadInst) {
-  errs() << "Load!\n";
+void WarpEvaluator::visitLoadInst(LoadInst &loadInst) {
   Value *pointer = loadInst.getOperand(0);
 
-  if (const GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(pointer)) {
-    if (gep->getPointerAddressSpace() == OCLEnv::LOCAL_AS) {
-      if (isInLoop(loadInst, loopInfo))
-        visitLocalMemoryInst(pointer, loopLoadBankConflicts);
-      else {
-        visitLocalMemoryInst(pointer, loadBankConflicts);
-      }
-    } else {
-      if (isInLoop(loadInst, loopInfo))
-        visitMemoryInst(pointer, loopLoadTransactions);
-      else
-        visitMemoryInst(pointer, loadTransactions);
-    }
+  if (loadInst.getPointerAddressSpace() == localAddressSpace) {
+    if (isInLoop(loadInst, loopInfo))
+      visitLoopLocalMemoryInst(loadInst, pointer,
+                               results.loopLoadBankConflicts,
+                               results.loopLocalLoadIterations);
+    else
+      visitLocalMemoryInst(pointer, results.loadBankConflicts);
+  } else if (isa<GetElementPtrInst>(pointer)) {
+    if (isInLoop(loadInst, loopInfo))
+      visitLoopMemoryInst(loadInst, pointer, results.loopLoadTransactions,
+                          results.loopLoadIterations,
+                          results.loopLoadTotalTransactions);
+    else
+      visitMemoryInst(pointer, results.loadTransactions);
   }
 }
 
@@ -189,3 +971,88 @@ void SymbolicExecution::dump() {
   Output yout(llvm::outs());
   yout << *this;
 }
+
+// Support functions.
+//------------------------------------------------------------------------------
+AccessStats aggregate(const std::vector<int> &samples, bool unbounded) {
+  AccessStats stats;
+  stats.min = 0;
+  stats.mean = 0;
+  stats.max = 0;
+  stats.unknown = 0;
+  if (samples.empty())
+    return stats;
+
+  float sum = 0;
+  int valid = 0;
+  for (std::vector<int>::const_iterator iter = samples.begin(),
+                                        iterEnd = samples.end();
+       iter != iterEnd; ++iter) {
+    // Negative results mark accesses that could not be analyzed.
+    if (*iter < 0) {
+      ++stats.unknown;
+      continue;
+    }
+
+    stats.min = valid == 0 ? *iter : std::min(stats.min, *iter);
+    stats.max = valid == 0 ? *iter : std::max(stats.max, *iter);
+    sum += *iter;
+    ++valid;
+
+    std::vector<int> &histogram =
+        unbounded ? stats.log2Histogram : stats.histogram;
+    unsigned int bucket = unbounded ? getLog2Bucket(*iter) : *iter;
+    if (bucket >= histogram.size())
+      histogram.resize(bucket + 1, 0);
+    ++histogram[bucket];
+  }
+
+  if (valid == 0) {
+    stats.min = -1;
+    stats.mean = -1;
+    stats.max = -1;
+    return stats;
+  }
+
+  stats.mean = sum / valid;
+  return stats;
+}
+
+//------------------------------------------------------------------------------
+// 0 for 0, k for the values in [2^(k-1), 2^k).
+unsigned int getLog2Bucket(int value) {
+  unsigned int bucket = 0;
+  while (value > 0) {
+    value >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+//------------------------------------------------------------------------------
+// Pointer of loads and stores to global memory, NULL for other instructions.
+Value *getGlobalMemoryPointer(Instruction *inst) {
+  Value *pointer = NULL;
+  if (LoadInst *load = dyn_cast<LoadInst>(inst))
+    pointer = load->getPointerOperand();
+  if (StoreInst *store = dyn_cast<StoreInst>(inst))
+    pointer = store->getPointerOperand();
+
+  GetElementPtrInst *gep = dyn_cast_or_null<GetElementPtrInst>(pointer);
+  if (gep == NULL ||
+      gep->getPointerAddressSpace() == getDeviceProfile().localAddressSpace)
+    return NULL;
+  return gep;
+}
+
+//------------------------------------------------------------------------------
+// Task of the thread pool: evaluate a warp with the analysis of the thread.
+void evaluateWarp(void *context, unsigned int warp, unsigned int thread) {
+  WarpTask *task = (WarpTask *)context;
+  SubscriptAnalysis &subscriptAnalysis = (*task->analyses)[thread];
+  subscriptAnalysis.setWarp((*task->warps)[warp]);
+
+  WarpEvaluator evaluator(subscriptAnalysis, task->loopInfo,
+                          (*task->results)[warp]);
+  evaluator.visit(*task->function);
+}
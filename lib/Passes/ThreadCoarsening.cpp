@@ -84,10 +84,12 @@ bool ThreadCoarsening::runOnFunction(Function &F) {
 
   errs() << "ThreadCoarsening::runOnFunction\n";
 
-  // Get command line options.
+  // Get command line options, unless a configuration has been chosen for the
+  // kernel.
   direction = CoarseningDirectionCL;
   factor = CoarseningFactorCL;
   stride = CoarseningStrideCL;
+  getCoarseningConfiguration(&F, factor, stride, direction);
   divRegionOption = DivRegionOptionCL;
 
   // Perform analysis.
@@ -103,6 +105,10 @@ bool ThreadCoarsening::runOnFunction(Function &F) {
   coarsenFunction();
   replacePlaceholders();
 
+  // Record the transformation: a following -tv pass vectorizes the coarsened
+  // kernel along the vectorizing direction.
+  markAsCoarsened(&F);
+
   return true;
 }
 
@@ -22,6 +22,7 @@
 
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "llvm/Transforms/Utils/Cloning.h"
@@ -42,9 +43,13 @@ Intrinsic::ID getIntrinsicIDForCall(CallInst *callInst);
 cl::opt<unsigned int>
     VectorizingDirectionCL("vectorizing-direction", cl::init(0), cl::Hidden,
                            cl::desc("Thr vectorizing direction"));
-cl::opt<unsigned int> VectorizingWidthCL("vectorizing-width", cl::init(1),
-                                         cl::Hidden,
-                                         cl::desc("The vectorizing width"));
+cl::opt<unsigned int> VectorizingWidthCL(
+    "vectorizing-width", cl::init(1), cl::Hidden,
+    cl::desc("The vectorizing width, 0 to select it for the target device"));
+cl::opt<bool> MaskLoopsCL(
+    "vectorizing-mask-loops", cl::init(true), cl::Hidden,
+    cl::desc("Vectorize divergent loops with an active-lane mask instead "
+             "of replicating them"));
 extern cl::opt<std::string> KernelNameCL;
 extern cl::opt<ThreadVectorizing::DivRegionOption> DivRegionOptionCL;
 
@@ -107,6 +112,15 @@ bool ThreadVectorizing::runOnFunction(Function &function) {
 
   init();
 
+  // Automatic width selection.
+  if (width == 0) {
+    kernelFunction = &function;
+    width = selectWidth();
+    DEBUG(dbgs() << "Selected vectorizing width: " << width << "\n");
+    if (width == 1)
+      return false;
+  }
+
   return performVectorization(function);
 }
 
@@ -116,6 +130,17 @@ void ThreadVectorizing::init() {
   toRemoveInsts.clear();
   vectorPhis.clear();
   phMap.clear();
+  maskedLoops.clear();
+  loopMask = NULL;
+  nextLoopMask = NULL;
+  blendedPhis.clear();
+  promotedInsts.clear();
+  liveOutUsers.clear();
+  liveOutPhis.clear();
+  frozenValues.clear();
+  maskedInsts.clear();
+  affineOffsets.clear();
+  reductionTrees.clear();
   irBuilder->ClearInsertionPoint();
   kernelFunction = NULL;
 }
@@ -124,11 +149,25 @@ void ThreadVectorizing::init() {
 bool ThreadVectorizing::performVectorization(Function &function) {
   kernelFunction = static_cast<Function *>(&function);
 
+  // The analysis follows the coarsening direction until the kernel is marked
+  // as coarsened: vectorizing along another direction would be wrong.
+  if (sdda->getDirection() != direction)
+    report_fatal_error("-tv: the divergence analysis of " +
+                       function.getName().str() +
+                       " is not along the vectorizing direction (is -tc "
+                       "missing for this kernel?)");
+
+  findReductionTrees();
+
+  scaleSizes();
   widenTids();
   vectorizeFunction();
   removeVectorPlaceholders();
   removeScalarInsts();
 
+  // This splits blocks, so it must be the last step.
+  vectorizeReductionTrees();
+
   return true;
 }
 
@@ -217,10 +256,41 @@ void ThreadVectorizing::vectorizeFunction() {
   InstVector &insts = sdda->getOutermostDivInsts();
   RegionVector &regions = sdda->getOutermostDivRegions();
 
+  // Find the divergent loops to be executed under a mask. This must be done
+  // before any vectorization since some of their uniform values are going to
+  // be promoted to vectors.
+  if (MaskLoopsCL) {
+    for (RegionVector::iterator iter = regions.begin(),
+                                iterEnd = regions.end();
+         iter != iterEnd; ++iter) {
+      DivergentRegion *region = *iter;
+      if (isMaskableLoop(region)) {
+        Loop *loop = loopInfo->getLoopFor(region->getHeader());
+        InstVector liveOuts;
+        InstVector users;
+        maskedLoops.push_back(region);
+        findLiveOutChains(loop, liveOuts, users);
+        createLiveOutPhis(loop, liveOuts);
+        for (InstVector::iterator userIter = users.begin(),
+                                  userEnd = users.end();
+             userIter != userEnd; ++userIter) {
+          if (promotedInsts.insert(*userIter).second)
+            liveOutUsers.push_back(*userIter);
+        }
+      }
+    }
+  }
+
+  // Induction variables with a divergent start stay scalar, in uniform and
+  // in masked loops.
+  findAffinePhis();
+
   // Replicate insts.
   for (InstVector::iterator iter = insts.begin(), iterEnd = insts.end();
        iter != iterEnd; ++iter) {
     Instruction *inst = *iter;
+    if (affineOffsets.count(inst))
+      continue;
     setInsertPoint(inst);
     Value *vectorResult = vectorizeInst(inst);
     if (NULL != vectorResult) {
@@ -233,12 +303,35 @@ void ThreadVectorizing::vectorizeFunction() {
     (*iter)->dump();
   }
 
-  // Replicate regions.
-  std::for_each(
-      regions.begin(), regions.end(),
-      std::bind1st(std::mem_fun(&ThreadVectorizing::replicateRegion), this));
+  // Vectorize divergent loops under a mask, replicate the other regions.
+  for (RegionVector::iterator iter = regions.begin(), iterEnd = regions.end();
+       iter != iterEnd; ++iter) {
+    DivergentRegion *region = *iter;
+    if (std::find(maskedLoops.begin(), maskedLoops.end(), region) !=
+        maskedLoops.end())
+      vectorizeLoop(region);
+    else
+      replicateRegion(region);
+  }
+
+  // Uniform instructions depending on the values of masked loops.
+  for (InstVector::iterator iter = liveOutUsers.begin(),
+                            iterEnd = liveOutUsers.end();
+       iter != iterEnd; ++iter) {
+    Instruction *inst = *iter;
+    setInsertPoint(inst);
+    Value *vectorResult = vectorizeInst(inst);
+    if (NULL != vectorResult) {
+      vectorMap[inst] = vectorResult;
+      toRemoveInsts.insert(inst);
+    }
+  }
 
   fixPhiNodes();
+
+  // This splits blocks, so it must be done after all the uses of the
+  // dominator tree.
+  vectorizeMaskedInsts();
 }
 
 //------------------------------------------------------------------------------
@@ -333,12 +426,19 @@ Value *ThreadVectorizing::getVectorValue(Value *scalar) {
   if (true == vectorMap.count(scalar)) {
     return vectorMap[scalar];
   } else {
-    // If the value to widen is a varying instruction that is not in the
-    // map then it is going to be widended in the future.
-    // To prevent dependency cycles create a placeholder and place it
-    // in a map.
     if (Instruction *inst = dyn_cast<Instruction>(scalar)) {
-      if (true == sdda->isDivergent(inst)) {
+      // Affine values are computed in vector form on demand.
+      if (affineOffsets.count(inst)) {
+        Value *vectorValue = materializeAffineValue(inst);
+        vectorMap[scalar] = vectorValue;
+        return vectorValue;
+      }
+
+      // If the value to widen is a varying instruction that is not in the
+      // map then it is going to be widended in the future.
+      // To prevent dependency cycles create a placeholder and place it
+      // in a map.
+      if (true == sdda->isDivergent(inst) || promotedInsts.count(inst)) {
         if (true == phMap.count(scalar)) {
           return phMap[scalar];
         }
@@ -384,18 +484,32 @@ void ThreadVectorizing::fixPhiNodes() {
     PHINode *vectorPhi = dyn_cast<PHINode>(vectorMap[scalarPhi]);
     assert(vectorPhi != NULL && "Phi node mapped to a non-phi");
 
+    // Loop-carried phis of masked loops.
+    std::map<PHINode *, Value *>::iterator blendIter =
+        blendedPhis.find(scalarPhi);
+    Loop *loop = loopInfo->getLoopFor(scalarPhi->getParent());
+
     unsigned int operands_number = scalarPhi->getNumIncomingValues();
     for (unsigned int operand_index = 0; operand_index < operands_number;
          ++operand_index) {
       Value *scalarValue = scalarPhi->getIncomingValue(operand_index);
+      BasicBlock *incomingBlock = scalarPhi->getIncomingBlock(operand_index);
       if (isa<UndefValue>(scalarValue)) {
         vectorPhi->addIncoming(UndefValue::get(vectorPhi->getType()),
-                               scalarPhi->getIncomingBlock(operand_index));
+                               incomingBlock);
+        continue;
+      }
 
-      } else {
-        vectorPhi->addIncoming(getVectorValue(scalarValue),
-                               scalarPhi->getIncomingBlock(operand_index));
+      Value *vectorValue = getVectorValue(scalarValue);
+
+      // On the back edge inactive lanes keep their current value.
+      if (blendIter != blendedPhis.end() && loop->contains(incomingBlock)) {
+        irBuilder->SetInsertPoint(incomingBlock->getTerminator());
+        vectorValue = irBuilder->CreateSelect(blendIter->second, vectorValue,
+                                              vectorPhi, "blended");
       }
+
+      vectorPhi->addIncoming(vectorValue, incomingBlock);
     }
   }
 }
@@ -437,10 +551,7 @@ Value *ThreadVectorizing::vectorizeLoad(LoadInst *loadInst) {
 
   unsigned int operands_number = gep->getNumOperands();
   Value *last_operand = gep->getOperand(operands_number - 1);
-  last_operand = getVectorValue(last_operand);
-
-  last_operand = irBuilder->CreateExtractElement(
-      last_operand, irBuilder->getInt32(0), "extracted");
+  last_operand = getLaneZeroValue(last_operand);
 
   // Create the new gep.
   GetElementPtrInst *newGep = cast<GetElementPtrInst>(gep->clone());
@@ -478,10 +589,7 @@ Value *ThreadVectorizing::vectorizeStore(StoreInst *storeInst) {
 
   unsigned int operands_number = gep->getNumOperands();
   Value *last_operand = gep->getOperand(operands_number - 1);
-  last_operand = getVectorValue(last_operand);
-
-  last_operand = irBuilder->CreateExtractElement(
-      last_operand, irBuilder->getInt32(0), "extracted");
+  last_operand = getLaneZeroValue(last_operand);
 
   // Create the new gep.
   GetElementPtrInst *newGep = cast<GetElementPtrInst>(gep->clone());
@@ -518,7 +626,8 @@ SelectInst *ThreadVectorizing::vectorizeSelect(SelectInst *select_inst) {
 
   bool varying_condition = false;
   if (Instruction *condition_inst = dyn_cast<Instruction>(condition)) {
-    varying_condition = sdda->isDivergent(condition_inst);
+    varying_condition = sdda->isDivergent(condition_inst) ||
+                        promotedInsts.count(condition_inst);
   }
 
   if (true == varying_condition) {
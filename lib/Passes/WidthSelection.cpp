@@ -0,0 +1,221 @@
+#define DEBUG_TYPE "ThreadVectorizing"
+
+#include "thrud/ThreadVectorizing/ThreadVectorizing.h"
+
+#include "thrud/FeatureExtraction/FeatureCollector.h"
+#include "thrud/FeatureExtraction/RegisterPressure.h"
+
+#include "thrud/Support/DeviceProfile.h"
+#include "thrud/Support/SubscriptAnalysis.h"
+#include "thrud/Support/Utils.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+// Support functions.
+// -----------------------------------------------------------------------------
+Intrinsic::ID getIntrinsicIDForCall(CallInst *callInst);
+
+// -----------------------------------------------------------------------------
+// Command line options.
+cl::opt<float> MaxReplicatedCL(
+    "vectorizing-max-replicated", cl::init(0.5), cl::Hidden,
+    cl::desc("Maximum fraction of replicated divergent instructions for "
+             "the automatic selection of the vectorizing width"));
+extern cl::opt<bool> MaskLoopsCL;
+
+// Automatic selection of the vectorizing width (-vectorizing-width 0).
+// The cost of a candidate width W is estimated per original work-item:
+// - uniform instructions are executed once every W work-items;
+// - vectorized instructions of type T take ceil(W / native_width(T))
+//   instructions of the device every W work-items;
+// - replicated instructions take one instruction per work-item.
+// Widths whose vector values do not fit in the register file of the device
+// are discarded, and so are all the widths if too many instructions have to
+// be replicated.
+
+static const unsigned int CANDIDATE_WIDTHS[] = { 2, 4, 8, 16 };
+static const char *TYPE_NAMES[] = { "i8", "i16", "i32", "i64",
+                                    "f16", "f32", "f64" };
+
+//------------------------------------------------------------------------------
+unsigned int ThreadVectorizing::selectWidth() {
+  const DeviceProfile &device = getDeviceProfile();
+
+  // Divergent regions that are replicated rather than vectorized.
+  RegionVector replicatedRegions;
+  RegionVector &regions = sdda->getOutermostDivRegions();
+  for (RegionVector::iterator iter = regions.begin(), iterEnd = regions.end();
+       iter != iterEnd; ++iter) {
+    if (!MaskLoopsCL || !isMaskableLoop(*iter))
+      replicatedRegions.push_back(*iter);
+  }
+
+  // Classify the instructions of the kernel.
+  FeatureCollector collector;
+  unsigned int uniformInsts = 0;
+  unsigned int vectorInsts = 0;
+  unsigned int replicatedInsts = 0;
+  for (Function::iterator blockIter = kernelFunction->begin(),
+                          blockEnd = kernelFunction->end();
+       blockIter != blockEnd; ++blockIter) {
+    for (BasicBlock::iterator iter = blockIter->begin(),
+                              iterEnd = blockIter->end();
+         iter != iterEnd; ++iter) {
+      Instruction *inst = iter;
+      if (isa<TerminatorInst>(inst))
+        continue;
+
+      bool inReplicatedRegion = false;
+      for (RegionVector::iterator regionIter = replicatedRegions.begin(),
+                                  regionEnd = replicatedRegions.end();
+           regionIter != regionEnd; ++regionIter) {
+        if (contains(**regionIter, inst)) {
+          inReplicatedRegion = true;
+          break;
+        }
+      }
+
+      if (inReplicatedRegion || isReplicated(inst)) {
+        ++replicatedInsts;
+      } else if (sdda->isDivergent(inst)) {
+        ++vectorInsts;
+        collector.countTypeMix(*inst);
+      } else {
+        ++uniformInsts;
+      }
+    }
+  }
+
+  if (vectorInsts + replicatedInsts == 0)
+    return 1;
+
+  float replicatedFraction =
+      (float)replicatedInsts / (float)(vectorInsts + replicatedInsts);
+  DEBUG(dbgs() << "Width selection on " << device.name << ": " << uniformInsts
+               << " uniform, " << vectorInsts << " vector, " << replicatedInsts
+               << " replicated instructions\n");
+  if (replicatedFraction > MaxReplicatedCL)
+    return 1;
+
+  // Vectorized instructions on types the device profile does not describe
+  // (eg: i1, pointers) cost one instruction per work-item.
+  unsigned int typedInsts = 0;
+  unsigned int typeNumber = sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]);
+  for (unsigned int index = 0; index < typeNumber; ++index) {
+    std::string typeName = TYPE_NAMES[index];
+    typedInsts += collector.instTypes[typeName + "Insts"];
+  }
+
+  unsigned int bestWidth = 1;
+  float bestCost = uniformInsts + vectorInsts + replicatedInsts;
+  unsigned int candidateNumber =
+      sizeof(CANDIDATE_WIDTHS) / sizeof(CANDIDATE_WIDTHS[0]);
+  for (unsigned int candidateIndex = 0; candidateIndex < candidateNumber;
+       ++candidateIndex) {
+    unsigned int candidate = CANDIDATE_WIDTHS[candidateIndex];
+
+    if (!isLegalWidth(candidate))
+      continue;
+
+    unsigned int registerBytes = estimateRegisterUsage(candidate);
+    if (registerBytes > device.registerFileSize) {
+      DEBUG(dbgs() << "Width " << candidate << " needs " << registerBytes
+                   << " bytes of registers\n");
+      continue;
+    }
+
+    float cost = (float)uniformInsts / candidate + replicatedInsts +
+                 (vectorInsts - typedInsts);
+    for (unsigned int index = 0; index < typeNumber; ++index) {
+      std::string typeName = TYPE_NAMES[index];
+      unsigned int nativeWidth = device.getNativeWidth(typeName);
+      unsigned int deviceInsts = (candidate + nativeWidth - 1) / nativeWidth;
+      cost += (float)collector.instTypes[typeName + "Insts"] * deviceInsts /
+              candidate;
+    }
+
+    DEBUG(dbgs() << "Width " << candidate << " costs " << cost << "\n");
+
+    // Ties go to the widest width: it amortizes the uniform work further.
+    if (cost <= bestCost) {
+      bestCost = cost;
+      bestWidth = candidate;
+    }
+  }
+
+  return bestWidth;
+}
+
+//------------------------------------------------------------------------------
+bool ThreadVectorizing::isReplicated(Instruction *inst) {
+  if (!sdda->isDivergent(inst))
+    return false;
+
+  switch (inst->getOpcode()) {
+  case Instruction::PHI:
+  case Instruction::Select:
+  case Instruction::ICmp:
+  case Instruction::FCmp:
+    return false;
+
+  case Instruction::Load:
+  case Instruction::Store:
+    return !subscriptAnalysis->isConsecutive(getMemoryPointer(inst),
+                                             (int)direction);
+
+  case Instruction::Call: {
+    CallInst *callInst = cast<CallInst>(inst);
+    return getIntrinsicIDForCall(callInst) == Intrinsic::not_intrinsic;
+  }
+
+  default:
+    return !isa<BinaryOperator>(inst) && !isa<CastInst>(inst);
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ThreadVectorizing::isLegalWidth(unsigned int candidate) {
+  InstVector &divInsts = sdda->getDivInsts();
+  for (InstVector::iterator iter = divInsts.begin(), iterEnd = divInsts.end();
+       iter != iterEnd; ++iter) {
+    Instruction *inst = *iter;
+    Type *type = inst->getType();
+    if (isa<TerminatorInst>(inst) || type->isVoidTy())
+      type = NULL;
+
+    // Consecutive loads and stores access memory through a pointer to a
+    // vector of the pointee type (see getVectorPointerType).
+    if ((isa<LoadInst>(inst) || isa<StoreInst>(inst)) && !isReplicated(inst))
+      type = cast<PointerType>(getMemoryPointer(inst)->getType())
+                 ->getElementType();
+
+    if (type == NULL)
+      continue;
+
+    // Vectors of vectors or aggregates do not exist.
+    if (!VectorType::isValidElementType(type))
+      return false;
+
+    // OpenCL vectors are at most 16 elements of 64 bits.
+    if (candidate * type->getPrimitiveSizeInBits() > 16 * 64)
+      return false;
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+unsigned int ThreadVectorizing::estimateRegisterUsage(unsigned int candidate) {
+  // Bytes of the registers live at the same time. Divergent values take a
+  // register per lane, as they take one per copy when coarsening.
+  RegisterPressure pressure(*kernelFunction, sdda, candidate);
+  return pressure.getMaxLiveRegisters() * 4;
+}
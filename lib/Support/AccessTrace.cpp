@@ -0,0 +1,161 @@
+#include "thrud/Support/AccessTrace.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstring>
+
+using namespace llvm;
+
+using yaml::MappingTraits;
+using yaml::SequenceTraits;
+using yaml::IO;
+using yaml::Output;
+
+static const uint32_t TRACE_VERSION = 1;
+
+namespace llvm {
+namespace yaml {
+
+//------------------------------------------------------------------------------
+// Sequence of ints.
+template <> struct SequenceTraits<std::vector<int> > {
+  static size_t size(IO &io, std::vector<int> &seq) { return seq.size(); }
+  static int &element(IO &, std::vector<int> &seq, size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+
+  static const bool flow = true;
+};
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<TraceAccess> {
+  static void mapping(IO &io, TraceAccess &access) {
+    io.mapRequired("id", access.id);
+    io.mapRequired("instruction", access.instruction);
+    io.mapRequired("block", access.block);
+    io.mapRequired("is_store", access.isStore);
+    io.mapRequired("address_space", access.addressSpace);
+    io.mapRequired("size", access.size);
+    io.mapRequired("loop_depth", access.loopDepth);
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct SequenceTraits<std::vector<TraceAccess> > {
+  static size_t size(IO &io, std::vector<TraceAccess> &seq) {
+    return seq.size();
+  }
+  static TraceAccess &element(IO &, std::vector<TraceAccess> &seq,
+                              size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<TraceBuffer> {
+  static void mapping(IO &io, TraceBuffer &buffer) {
+    io.mapRequired("name", buffer.name);
+    io.mapRequired("base", buffer.base);
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct SequenceTraits<std::vector<TraceBuffer> > {
+  static size_t size(IO &io, std::vector<TraceBuffer> &seq) {
+    return seq.size();
+  }
+  static TraceBuffer &element(IO &, std::vector<TraceBuffer> &seq,
+                              size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<AccessTraceIndex> {
+  static void mapping(IO &io, AccessTraceIndex &index) {
+    io.mapRequired("trace", index.trace);
+    io.mapRequired("kernel", index.kernel);
+    io.mapRequired("kernel_arguments", index.kernelArguments);
+    io.mapRequired("record_size", index.recordSize);
+    io.mapRequired("records", index.recordNumber);
+    io.mapRequired("local_size", index.localSize);
+    io.mapRequired("groups", index.numberOfGroups);
+    io.mapRequired("loop_iterations", index.loopIterations);
+    io.mapRequired("accesses", index.accesses);
+    io.mapRequired("buffers", index.buffers);
+  }
+};
+}
+}
+
+//------------------------------------------------------------------------------
+AccessTraceWriter::AccessTraceWriter() : stream(NULL), recordNumber(0) {}
+
+//------------------------------------------------------------------------------
+AccessTraceWriter::~AccessTraceWriter() { close(); }
+
+//------------------------------------------------------------------------------
+bool AccessTraceWriter::open(const std::string &fileName, std::string &error) {
+  close();
+  stream = new raw_fd_ostream(fileName.c_str(), error, sys::fs::F_Binary);
+  if (!error.empty()) {
+    delete stream;
+    stream = NULL;
+    return false;
+  }
+
+  recordNumber = 0;
+  writeHeader();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void AccessTraceWriter::write(const AccessRecord &record) {
+  stream->write((const char *)&record, sizeof(record));
+  ++recordNumber;
+}
+
+//------------------------------------------------------------------------------
+void AccessTraceWriter::close() {
+  if (stream == NULL)
+    return;
+
+  stream->seek(0);
+  writeHeader();
+  delete stream;
+  stream = NULL;
+}
+
+//------------------------------------------------------------------------------
+uint64_t AccessTraceWriter::getRecordNumber() const { return recordNumber; }
+
+//------------------------------------------------------------------------------
+void AccessTraceWriter::writeHeader() {
+  AccessTraceHeader header;
+  memcpy(header.magic, "THRUDTRC", sizeof(header.magic));
+  header.version = TRACE_VERSION;
+  header.recordSize = sizeof(AccessRecord);
+  header.recordNumber = recordNumber;
+  stream->write((const char *)&header, sizeof(header));
+}
+
+//------------------------------------------------------------------------------
+bool AccessTraceWriter::writeIndex(const std::string &fileName,
+                                   AccessTraceIndex &index,
+                                   std::string &error) {
+  raw_fd_ostream stream(fileName.c_str(), error, sys::fs::F_None);
+  if (!error.empty())
+    return false;
+
+  Output yout(stream);
+  yout << index;
+  return true;
+}
@@ -0,0 +1,133 @@
+#include "thrud/Support/CacheSimulator.h"
+
+#include <algorithm>
+#include <cassert>
+
+//------------------------------------------------------------------------------
+Cache::Cache(unsigned int size, unsigned int lineSize, unsigned int ways)
+    : lineSize(std::max(lineSize, 1u)), ways(std::max(ways, 1u)) {
+  unsigned int setNumber = size / (this->lineSize * this->ways);
+  sets.resize(std::max(setNumber, 1u));
+}
+
+//------------------------------------------------------------------------------
+bool Cache::access(uint64_t address, bool allocate) {
+  uint64_t line = address / lineSize;
+  std::vector<uint64_t> &set = sets[line % sets.size()];
+
+  std::vector<uint64_t>::iterator iter =
+      std::find(set.begin(), set.end(), line);
+  if (iter != set.end()) {
+    // Move the line to the front.
+    std::rotate(set.begin(), iter, iter + 1);
+    return true;
+  }
+
+  if (allocate) {
+    if (set.size() == ways)
+      set.pop_back();
+    set.insert(set.begin(), line);
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+unsigned int Cache::getLineSize() const { return lineSize; }
+
+//------------------------------------------------------------------------------
+CacheStats::CacheStats()
+    : l1Accesses(0), l1Hits(0), l2Accesses(0), l2Hits(0), dramBytes(0) {}
+
+//------------------------------------------------------------------------------
+float CacheStats::getL1HitRate() const {
+  return l1Accesses == 0 ? 0 : l1Hits / l1Accesses;
+}
+
+//------------------------------------------------------------------------------
+float CacheStats::getL2HitRate() const {
+  return l2Accesses == 0 ? 0 : l2Hits / l2Accesses;
+}
+
+//------------------------------------------------------------------------------
+CacheSimulator::CacheSimulator(const Cache &l1, const Cache &l2,
+                               int accessNumber)
+    : l1(l1), l2(l2), stats(accessNumber) {}
+
+//------------------------------------------------------------------------------
+void CacheSimulator::access(int accessIndex, bool isStore,
+                            const std::vector<uint64_t> &addresses,
+                            int unknownNumber, double weight) {
+  assert(accessIndex >= 0 && accessIndex < (int)stats.size() &&
+         "Access out of range");
+  CacheStats &accessStats = stats[accessIndex];
+
+  // Coalesce the addresses of the warp into lines of the first level the
+  // request goes to.
+  unsigned int lineSize = isStore ? l2.getLineSize() : l1.getLineSize();
+  std::vector<uint64_t> lines;
+  lines.reserve(addresses.size());
+  for (std::vector<uint64_t>::const_iterator iter = addresses.begin(),
+                                             iterEnd = addresses.end();
+       iter != iterEnd; ++iter) {
+    lines.push_back(*iter / lineSize);
+  }
+  std::sort(lines.begin(), lines.end());
+  lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+
+  for (std::vector<uint64_t>::iterator iter = lines.begin(),
+                                       iterEnd = lines.end();
+       iter != iterEnd; ++iter) {
+    uint64_t address = *iter * lineSize;
+
+    if (isStore) {
+      accessL2(address, weight, accessStats);
+      continue;
+    }
+
+    accessStats.l1Accesses += weight;
+    if (l1.access(address, true)) {
+      accessStats.l1Hits += weight;
+      continue;
+    }
+
+    // Fill the whole L1 line from L2.
+    for (uint64_t offset = 0; offset < lineSize; offset += l2.getLineSize()) {
+      accessL2(address + offset, weight, accessStats);
+    }
+  }
+
+  if (!isStore)
+    accessStats.l1Accesses += weight * unknownNumber;
+  accessStats.l2Accesses += weight * unknownNumber;
+  accessStats.dramBytes += weight * unknownNumber * lineSize;
+}
+
+//------------------------------------------------------------------------------
+void CacheSimulator::accessL2(uint64_t address, double weight,
+                              CacheStats &stats) {
+  stats.l2Accesses += weight;
+  if (l2.access(address, true))
+    stats.l2Hits += weight;
+  else
+    stats.dramBytes += weight * l2.getLineSize();
+}
+
+//------------------------------------------------------------------------------
+const CacheStats &CacheSimulator::getStats(int accessIndex) const {
+  return stats[accessIndex];
+}
+
+//------------------------------------------------------------------------------
+CacheStats CacheSimulator::getTotalStats() const {
+  CacheStats total;
+  for (std::vector<CacheStats>::const_iterator iter = stats.begin(),
+                                               iterEnd = stats.end();
+       iter != iterEnd; ++iter) {
+    total.l1Accesses += iter->l1Accesses;
+    total.l1Hits += iter->l1Hits;
+    total.l2Accesses += iter->l2Accesses;
+    total.l2Hits += iter->l2Hits;
+    total.dramBytes += iter->dramBytes;
+  }
+  return total;
+}
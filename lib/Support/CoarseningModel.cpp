@@ -0,0 +1,373 @@
+#include "thrud/Support/CoarseningModel.h"
+
+#include "llvm/ADT/OwningPtr.h"
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/system_error.h"
+#include "llvm/Support/YAMLTraits.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+using namespace llvm;
+
+using yaml::MappingTraits;
+using yaml::SequenceTraits;
+using yaml::IO;
+
+namespace llvm {
+namespace yaml {
+
+//------------------------------------------------------------------------------
+template <> struct SequenceTraits<std::vector<std::string> > {
+  static size_t size(IO &io, std::vector<std::string> &seq) {
+    return seq.size();
+  }
+  static std::string &element(IO &, std::vector<std::string> &seq,
+                              size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+
+  static const bool flow = true;
+};
+
+//------------------------------------------------------------------------------
+template <> struct SequenceTraits<std::vector<float> > {
+  static size_t size(IO &io, std::vector<float> &seq) { return seq.size(); }
+  static float &element(IO &, std::vector<float> &seq, size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+
+  static const bool flow = true;
+};
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<CoarseningModel::Configuration> {
+  static void mapping(IO &io, CoarseningModel::Configuration &configuration) {
+    io.mapRequired("factor", configuration.factor);
+    io.mapOptional("stride", configuration.stride, 1u);
+    io.mapOptional("direction", configuration.direction, 0u);
+  }
+};
+
+//------------------------------------------------------------------------------
+template <>
+struct SequenceTraits<std::vector<CoarseningModel::Configuration> > {
+  static size_t size(IO &io,
+                     std::vector<CoarseningModel::Configuration> &seq) {
+    return seq.size();
+  }
+  static CoarseningModel::Configuration &
+  element(IO &, std::vector<CoarseningModel::Configuration> &seq,
+          size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<CoarseningModel::TreeNode> {
+  static void mapping(IO &io, CoarseningModel::TreeNode &node) {
+    io.mapOptional("feature", node.feature, -1);
+    io.mapOptional("threshold", node.threshold, 0.0f);
+    io.mapOptional("left", node.left, 0u);
+    io.mapOptional("right", node.right, 0u);
+    io.mapOptional("configuration", node.configuration, 0u);
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct SequenceTraits<std::vector<CoarseningModel::TreeNode> > {
+  static size_t size(IO &io, std::vector<CoarseningModel::TreeNode> &seq) {
+    return seq.size();
+  }
+  static CoarseningModel::TreeNode &
+  element(IO &, std::vector<CoarseningModel::TreeNode> &seq, size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<CoarseningModel::Tree> {
+  static void mapping(IO &io, CoarseningModel::Tree &tree) {
+    io.mapRequired("nodes", tree.nodes);
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct SequenceTraits<std::vector<CoarseningModel::Tree> > {
+  static size_t size(IO &io, std::vector<CoarseningModel::Tree> &seq) {
+    return seq.size();
+  }
+  static CoarseningModel::Tree &
+  element(IO &, std::vector<CoarseningModel::Tree> &seq, size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<CoarseningModel::Layer> {
+  static void mapping(IO &io, CoarseningModel::Layer &layer) {
+    io.mapOptional("activation", layer.activation, std::string("linear"));
+    io.mapRequired("weights", layer.weights);
+    io.mapRequired("biases", layer.biases);
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct SequenceTraits<std::vector<CoarseningModel::Layer> > {
+  static size_t size(IO &io, std::vector<CoarseningModel::Layer> &seq) {
+    return seq.size();
+  }
+  static CoarseningModel::Layer &
+  element(IO &, std::vector<CoarseningModel::Layer> &seq, size_t index) {
+    if (index >= seq.size())
+      seq.resize(index + 1);
+    return seq[index];
+  }
+};
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<CoarseningModel> {
+  static void mapping(IO &io, CoarseningModel &model) {
+    io.mapRequired("kind", model.kind);
+    io.mapRequired("features", model.features);
+    io.mapRequired("configurations", model.configurations);
+    io.mapOptional("trees", model.trees);
+    io.mapOptional("mean", model.mean);
+    io.mapOptional("scale", model.scale);
+    io.mapOptional("layers", model.layers);
+  }
+};
+}
+}
+
+// Support functions.
+//------------------------------------------------------------------------------
+float activate(const std::string &activation, float value);
+bool isActivation(const std::string &activation);
+std::string toString(unsigned int number);
+
+//------------------------------------------------------------------------------
+CoarseningModel::CoarseningModel() {}
+
+//------------------------------------------------------------------------------
+bool CoarseningModel::loadFromFile(const std::string &fileName,
+                                   const std::vector<std::string> &featureNames,
+                                   CoarseningModel &model,
+                                   std::string &error) {
+  OwningPtr<MemoryBuffer> buffer;
+  if (error_code errorCode = MemoryBuffer::getFile(fileName, buffer)) {
+    error = "cannot read " + fileName + ": " + errorCode.message();
+    return false;
+  }
+
+  model = CoarseningModel();
+  yaml::Input yin(buffer->getBuffer());
+  yin >> model;
+  if (yin.error()) {
+    error = "malformed model " + fileName;
+    return false;
+  }
+
+  if (!model.verify(error) || !model.bindFeatures(featureNames, error)) {
+    error = fileName + ": " + error;
+    return false;
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+const CoarseningModel::Configuration &
+CoarseningModel::predict(const std::vector<float> &values) const {
+  std::vector<float> inputs;
+  inputs.reserve(featureIndices.size());
+  for (unsigned int index = 0; index < featureIndices.size(); ++index) {
+    inputs.push_back(values[featureIndices[index]]);
+  }
+
+  if (kind == "mlp")
+    return configurations[evaluatePerceptron(inputs)];
+
+  // Majority vote, ties go to the first configuration.
+  std::vector<unsigned int> votes(configurations.size(), 0);
+  for (std::vector<Tree>::const_iterator iter = trees.begin(),
+                                         iterEnd = trees.end();
+       iter != iterEnd; ++iter) {
+    ++votes[evaluateTree(*iter, inputs)];
+  }
+  return configurations[std::max_element(votes.begin(), votes.end()) -
+                        votes.begin()];
+}
+
+//------------------------------------------------------------------------------
+bool CoarseningModel::bindFeatures(
+    const std::vector<std::string> &featureNames, std::string &error) {
+  featureIndices.clear();
+  for (std::vector<std::string>::iterator iter = features.begin(),
+                                          iterEnd = features.end();
+       iter != iterEnd; ++iter) {
+    std::vector<std::string>::const_iterator position =
+        std::find(featureNames.begin(), featureNames.end(), *iter);
+    if (position == featureNames.end()) {
+      error = "unknown feature " + *iter;
+      return false;
+    }
+    featureIndices.push_back(position - featureNames.begin());
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool CoarseningModel::verify(std::string &error) const {
+  if (kind != "tree" && kind != "forest" && kind != "mlp") {
+    error = "unknown model kind " + kind + " (tree, forest or mlp)";
+    return false;
+  }
+  if (configurations.empty()) {
+    error = "no configurations";
+    return false;
+  }
+  for (unsigned int index = 0; index < configurations.size(); ++index) {
+    if (configurations[index].factor == 0 ||
+        configurations[index].stride == 0 ||
+        configurations[index].direction > 2) {
+      error = "invalid configuration " + toString(index);
+      return false;
+    }
+  }
+
+  if (kind == "mlp") {
+    if (layers.empty()) {
+      error = "perceptron without layers";
+      return false;
+    }
+    if ((!mean.empty() && mean.size() != features.size()) ||
+        (!scale.empty() && scale.size() != features.size())) {
+      error = "normalization does not match the features";
+      return false;
+    }
+
+    unsigned int inputNumber = features.size();
+    for (unsigned int index = 0; index < layers.size(); ++index) {
+      const Layer &layer = layers[index];
+      if (!isActivation(layer.activation) ||
+          layer.weights.size() != layer.biases.size() * inputNumber) {
+        error = "invalid layer " + toString(index);
+        return false;
+      }
+      inputNumber = layer.biases.size();
+    }
+    if (inputNumber != configurations.size()) {
+      error = "the outputs do not match the configurations";
+      return false;
+    }
+    return true;
+  }
+
+  if (trees.empty() || (kind == "tree" && trees.size() != 1)) {
+    error = "a tree model has one tree, a forest at least one";
+    return false;
+  }
+  for (unsigned int treeIndex = 0; treeIndex < trees.size(); ++treeIndex) {
+    const std::vector<TreeNode> &nodes = trees[treeIndex].nodes;
+    // Children come after their parent: evaluation always terminates.
+    for (unsigned int index = 0; index < nodes.size(); ++index) {
+      const TreeNode &node = nodes[index];
+      bool valid =
+          node.feature == -1
+              ? node.configuration < configurations.size()
+              : node.feature >= 0 &&
+                    (unsigned int)node.feature < features.size() &&
+                    node.left > index && node.left < nodes.size() &&
+                    node.right > index && node.right < nodes.size();
+      if (!valid) {
+        error = "invalid node " + toString(index) + " of tree " +
+                toString(treeIndex);
+        return false;
+      }
+    }
+    if (nodes.empty()) {
+      error = "empty tree " + toString(treeIndex);
+      return false;
+    }
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+unsigned int
+CoarseningModel::evaluateTree(const Tree &tree,
+                              const std::vector<float> &inputs) const {
+  const TreeNode *node = &tree.nodes[0];
+  while (node->feature != -1) {
+    unsigned int next =
+        inputs[node->feature] <= node->threshold ? node->left : node->right;
+    node = &tree.nodes[next];
+  }
+  return node->configuration;
+}
+
+//------------------------------------------------------------------------------
+unsigned int
+CoarseningModel::evaluatePerceptron(std::vector<float> inputs) const {
+  for (unsigned int index = 0; index < inputs.size(); ++index) {
+    if (!mean.empty())
+      inputs[index] -= mean[index];
+    if (!scale.empty())
+      inputs[index] *= scale[index];
+  }
+
+  std::vector<float> outputs;
+  for (std::vector<Layer>::const_iterator iter = layers.begin(),
+                                          iterEnd = layers.end();
+       iter != iterEnd; ++iter) {
+    const Layer &layer = *iter;
+    outputs.assign(layer.biases.begin(), layer.biases.end());
+    for (unsigned int output = 0; output < outputs.size(); ++output) {
+      const float *row = &layer.weights[output * inputs.size()];
+      for (unsigned int input = 0; input < inputs.size(); ++input) {
+        outputs[output] += row[input] * inputs[input];
+      }
+      outputs[output] = activate(layer.activation, outputs[output]);
+    }
+    inputs.swap(outputs);
+  }
+
+  return std::max_element(inputs.begin(), inputs.end()) - inputs.begin();
+}
+
+//------------------------------------------------------------------------------
+float activate(const std::string &activation, float value) {
+  if (activation == "relu")
+    return std::max(value, 0.0f);
+  if (activation == "tanh")
+    return std::tanh(value);
+  if (activation == "sigmoid")
+    return 1 / (1 + std::exp(-value));
+  return value;
+}
+
+//------------------------------------------------------------------------------
+bool isActivation(const std::string &activation) {
+  return activation == "relu" || activation == "tanh" ||
+         activation == "sigmoid" || activation == "linear";
+}
+
+//------------------------------------------------------------------------------
+std::string toString(unsigned int number) {
+  std::stringstream stream;
+  stream << number;
+  return stream.str();
+}
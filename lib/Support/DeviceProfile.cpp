@@ -0,0 +1,310 @@
+#include "thrud/Support/DeviceProfile.h"
+
+#include "thrud/Support/Utils.h"
+
+#include "llvm/ADT/OwningPtr.h"
+
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Type.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/system_error.h"
+#include "llvm/Support/YAMLTraits.h"
+
+using namespace llvm;
+
+using yaml::MappingTraits;
+using yaml::IO;
+
+static cl::opt<std::string>
+    DeviceProfileCL("device-profile", cl::init("nvidia-warp32"), cl::Hidden,
+                    cl::desc("Target device: the name of a built-in profile "
+                             "or the path of a YAML profile"));
+
+namespace llvm {
+namespace yaml {
+
+//------------------------------------------------------------------------------
+template <> struct MappingTraits<DeviceProfile> {
+  static void mapping(IO &io, DeviceProfile &profile) {
+    io.mapOptional("name", profile.name);
+    io.mapOptional("char_width", profile.charWidth);
+    io.mapOptional("short_width", profile.shortWidth);
+    io.mapOptional("int_width", profile.intWidth);
+    io.mapOptional("long_width", profile.longWidth);
+    io.mapOptional("half_width", profile.halfWidth);
+    io.mapOptional("float_width", profile.floatWidth);
+    io.mapOptional("double_width", profile.doubleWidth);
+    io.mapOptional("register_file", profile.registerFileSize);
+    io.mapOptional("warp_size", profile.warpSize);
+    io.mapOptional("bank_number", profile.bankNumber);
+    io.mapOptional("bank_width", profile.bankWidth);
+    io.mapOptional("cacheline_size", profile.cachelineSize);
+    io.mapOptional("local_address_space", profile.localAddressSpace);
+    io.mapOptional("global_address_space", profile.globalAddressSpace);
+    io.mapOptional("constant_address_space", profile.constantAddressSpace);
+    io.mapOptional("compute_throughput", profile.computeThroughput);
+    io.mapOptional("memory_bandwidth", profile.memoryBandwidth);
+    io.mapOptional("local_memory_bandwidth", profile.localMemoryBandwidth);
+    io.mapOptional("math_cost", profile.mathCost);
+    io.mapOptional("barrier_cost", profile.barrierCost);
+    io.mapOptional("half_cost", profile.halfCost);
+    io.mapOptional("double_cost", profile.doubleCost);
+    io.mapOptional("long_cost", profile.longCost);
+    io.mapOptional("division_cost", profile.divisionCost);
+    io.mapOptional("compute_unit_registers", profile.computeUnitRegisters);
+    io.mapOptional("max_warps_per_compute_unit",
+                   profile.maxWarpsPerComputeUnit);
+    io.mapOptional("max_groups_per_compute_unit",
+                   profile.maxGroupsPerComputeUnit);
+    io.mapOptional("local_memory_size", profile.localMemorySize);
+  }
+};
+}
+}
+
+//------------------------------------------------------------------------------
+// The roofline, throughput and compute unit figures are those of a Tesla
+// K20: doubles at a third of the float rate, halves computed as floats,
+// 64-bit integers and divisions emulated.
+DeviceProfile::DeviceProfile()
+    : name("nvidia-warp32"), charWidth(1), shortWidth(1), intWidth(1),
+      longWidth(1), halfWidth(1), floatWidth(1), doubleWidth(1),
+      registerFileSize(255 * 4), warpSize(32), bankNumber(32), bankWidth(4),
+      cachelineSize(128), localAddressSpace(3), globalAddressSpace(1),
+      constantAddressSpace(2), computeThroughput(3500),
+      memoryBandwidth(208), localMemoryBandwidth(2500), mathCost(8),
+      barrierCost(32), halfCost(1), doubleCost(3), longCost(2),
+      divisionCost(16), computeUnitRegisters(65536),
+      maxWarpsPerComputeUnit(64), maxGroupsPerComputeUnit(16),
+      localMemorySize(48 * 1024) {}
+
+//------------------------------------------------------------------------------
+bool DeviceProfile::getBuiltin(const std::string &name,
+                               DeviceProfile &profile) {
+  profile = DeviceProfile();
+  profile.name = name;
+
+  // Scalar SIMT machines: every work-item is a lane, no native vectors.
+  if (name == "nvidia-warp32")
+    return true;
+
+  if (name == "amd-wave64") {
+    profile.registerFileSize = 256 * 4;
+    profile.warpSize = 64;
+    profile.cachelineSize = 64;
+    profile.computeThroughput = 3800;
+    profile.memoryBandwidth = 264;
+    profile.localMemoryBandwidth = 3800;
+    profile.mathCost = 4;
+    profile.doubleCost = 4;
+    // Four SIMDs of 64KB of vector registers and 10 waves each.
+    profile.maxWarpsPerComputeUnit = 40;
+    profile.maxGroupsPerComputeUnit = 40;
+    profile.localMemorySize = 64 * 1024;
+    return true;
+  }
+
+  // Intel GPUs share 128 32-byte registers per hardware thread among the
+  // work-items of the SIMD width. Shared local memory has 16 banks.
+  // A compute unit is a subslice of 8 EUs with 7 hardware threads each.
+  unsigned int simdWidth = 0;
+  if (name == "intel-simd8")
+    simdWidth = 8;
+  else if (name == "intel-simd16")
+    simdWidth = 16;
+  else if (name == "intel-simd32")
+    simdWidth = 32;
+
+  if (simdWidth != 0) {
+    profile.registerFileSize = 128 * 32 / simdWidth;
+    profile.warpSize = simdWidth;
+    profile.bankNumber = 16;
+    profile.cachelineSize = 64;
+    profile.computeThroughput = 800;
+    profile.memoryBandwidth = 25.6f;
+    profile.localMemoryBandwidth = 400;
+    profile.doubleCost = 4;
+    profile.computeUnitRegisters = 8 * 7 * 128 * 32 / 4;
+    profile.maxWarpsPerComputeUnit = 8 * 7;
+    profile.maxGroupsPerComputeUnit = 16;
+    profile.localMemorySize = 64 * 1024;
+    return true;
+  }
+
+  // AVX2 CPU: one work-item per core with 16 256-bit registers.
+  // Work-items are packed in the 8 32-bit lanes, local memory is cached
+  // global memory: a 64-byte line is a row of 16 4-byte banks.
+  if (name == "cpu") {
+    profile.charWidth = 32;
+    profile.shortWidth = 16;
+    profile.intWidth = 8;
+    profile.longWidth = 4;
+    profile.halfWidth = 8;
+    profile.floatWidth = 8;
+    profile.doubleWidth = 4;
+    profile.registerFileSize = 16 * 32;
+    profile.warpSize = 8;
+    profile.bankNumber = 16;
+    profile.cachelineSize = 64;
+    profile.computeThroughput = 200;
+    profile.memoryBandwidth = 25.6f;
+    profile.localMemoryBandwidth = 400;
+    profile.mathCost = 16;
+    profile.barrierCost = 256;
+    // Doubles and 64-bit integers are native, at half the lanes.
+    profile.doubleCost = 1;
+    profile.longCost = 1;
+    profile.divisionCost = 8;
+    // A core runs the work-items of a work-group one after the other: only
+    // the local memory of the group has to fit in the L1.
+    profile.computeUnitRegisters = 0;
+    profile.maxWarpsPerComputeUnit = 0;
+    profile.maxGroupsPerComputeUnit = 1;
+    profile.localMemorySize = 32 * 1024;
+    return true;
+  }
+
+  return false;
+}
+
+//------------------------------------------------------------------------------
+std::string DeviceProfile::getBuiltinNames() {
+  return "nvidia-warp32, amd-wave64, intel-simd8, intel-simd16, "
+         "intel-simd32, cpu";
+}
+
+//------------------------------------------------------------------------------
+bool DeviceProfile::loadFromFile(const std::string &fileName,
+                                 DeviceProfile &profile, std::string &error) {
+  OwningPtr<MemoryBuffer> buffer;
+  if (error_code errorCode = MemoryBuffer::getFile(fileName, buffer)) {
+    error = "cannot read " + fileName + ": " + errorCode.message();
+    return false;
+  }
+
+  profile = DeviceProfile();
+  profile.name = fileName;
+
+  yaml::Input yin(buffer->getBuffer());
+  yin >> profile;
+  if (yin.error()) {
+    error = "malformed device profile " + fileName;
+    return false;
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+unsigned int DeviceProfile::getNativeWidth(const Type *type) const {
+  return getNativeWidth(getScalarTypeName(type->getScalarType()));
+}
+
+//------------------------------------------------------------------------------
+unsigned int DeviceProfile::getNativeWidth(const std::string &typeName) const {
+  unsigned int width = 1;
+  if (typeName == "i8")
+    width = charWidth;
+  else if (typeName == "i16")
+    width = shortWidth;
+  else if (typeName == "i32")
+    width = intWidth;
+  else if (typeName == "i64")
+    width = longWidth;
+  else if (typeName == "f16")
+    width = halfWidth;
+  else if (typeName == "f32")
+    width = floatWidth;
+  else if (typeName == "f64")
+    width = doubleWidth;
+
+  return width == 0 ? 1 : width;
+}
+
+//------------------------------------------------------------------------------
+float DeviceProfile::getIssueCost(const Instruction *inst) const {
+  Instruction *instruction = const_cast<Instruction *>(inst);
+  if (const CallInst *call = dyn_cast<CallInst>(inst)) {
+    if (call->getCalledFunction() != NULL && isBarrier(instruction))
+      return barrierCost;
+    if (call->getCalledFunction() == NULL || !isMathFunction(instruction))
+      return 1;
+  }
+
+  switch (inst->getOpcode()) {
+  case Instruction::Load:
+  case Instruction::Store:
+  case Instruction::Alloca:
+  case Instruction::PHI:
+  case Instruction::Ret:
+  case Instruction::Unreachable:
+    return 0;
+  case Instruction::Br:
+  case Instruction::Switch:
+    return 1;
+  default:
+    break;
+  }
+
+  // The full type of the data, vectors included.
+  Type *type = inst->getType();
+  if (const CmpInst *cmp = dyn_cast<CmpInst>(inst))
+    type = cmp->getOperand(0)->getType();
+  else if (isa<ExtractElementInst>(inst))
+    type = inst->getOperand(0)->getType();
+
+  unsigned int elements =
+      type->isVectorTy() ? type->getVectorNumElements() : 1;
+  unsigned int width = getNativeWidth(type->getScalarType());
+  float cost = (elements + width - 1) / width;
+
+  std::string typeName = getScalarTypeName(type->getScalarType());
+  if (typeName == "f16")
+    cost *= halfCost;
+  else if (typeName == "f64")
+    cost *= doubleCost;
+  else if (typeName == "i64")
+    cost *= longCost;
+
+  switch (inst->getOpcode()) {
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+  case Instruction::FDiv:
+  case Instruction::FRem:
+    cost *= divisionCost;
+    break;
+  case Instruction::Call:
+    cost *= mathCost;
+    break;
+  default:
+    break;
+  }
+
+  return cost;
+}
+
+//------------------------------------------------------------------------------
+const DeviceProfile &getDeviceProfile() {
+  static DeviceProfile profile;
+  static std::string loadedName;
+
+  if (loadedName == DeviceProfileCL)
+    return profile;
+
+  if (!DeviceProfile::getBuiltin(DeviceProfileCL, profile)) {
+    std::string error;
+    if (!DeviceProfile::loadFromFile(DeviceProfileCL, profile, error))
+      report_fatal_error("Unknown device profile: " + error +
+                         " (built-in profiles: " +
+                         DeviceProfile::getBuiltinNames() + ")");
+  }
+
+  loadedName = DeviceProfileCL;
+  return profile;
+}
@@ -0,0 +1,205 @@
+#include "thrud/Support/FeatureTable.h"
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringRef.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+
+using namespace llvm;
+
+static const char *STRING_COLUMNS[] = { "module", "kernel", "configuration" };
+static const uint32_t TABLE_VERSION = 2;
+
+//------------------------------------------------------------------------------
+// Quote a CSV field if it contains separators or quotes.
+std::string quoteField(const std::string &field) {
+  if (field.find_first_of(",\"\n") == std::string::npos)
+    return field;
+
+  std::string result = "\"";
+  for (unsigned int index = 0; index < field.size(); ++index) {
+    if (field[index] == '"')
+      result += '"';
+    result += field[index];
+  }
+  return result + "\"";
+}
+
+//------------------------------------------------------------------------------
+void writeString(raw_ostream &stream, const std::string &text) {
+  uint32_t length = text.size();
+  stream.write((const char *)&length, sizeof(length));
+  stream << text;
+}
+
+//------------------------------------------------------------------------------
+bool isEmptyFile(const std::string &fileName) {
+  uint64_t size = 0;
+  if (sys::fs::file_size(fileName, size))
+    return true;
+  return size == 0;
+}
+
+//------------------------------------------------------------------------------
+bool readFile(const std::string &fileName, OwningPtr<MemoryBuffer> &buffer,
+              std::string &error) {
+  if (error_code errorCode = MemoryBuffer::getFile(fileName, buffer)) {
+    error = errorCode.message();
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Read a string written by writeString.
+// Return false if the file is too short.
+bool readString(std::istream &stream, std::string &text) {
+  uint32_t length;
+  if (!stream.read((char *)&length, sizeof(length)))
+    return false;
+
+  text.assign(length, '\0');
+  return length == 0 || stream.read(&text[0], length);
+}
+
+//------------------------------------------------------------------------------
+// Get the column names at the top of a columnar table, without reading the
+// row groups.
+// Return false if the file does not start with a table header.
+bool readNames(const std::string &fileName, std::vector<std::string> &names) {
+  std::ifstream stream(fileName.c_str(), std::ios::in | std::ios::binary);
+  FeatureTableHeader header;
+  if (!stream.read((char *)&header, sizeof(header)) ||
+      memcmp(header.magic, "THRUDTBL", sizeof(header.magic)) != 0 ||
+      header.version != TABLE_VERSION)
+    return false;
+
+  names.clear();
+  std::string text;
+  for (uint32_t column = 0; column < header.featureNumber; ++column) {
+    if (!readString(stream, text))
+      return false;
+    names.push_back(text);
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+FeatureTable::FeatureTable(const std::vector<std::string> &featureNames)
+    : featureNames(featureNames) {}
+
+//------------------------------------------------------------------------------
+void FeatureTable::addRow(const std::string &module, const std::string &kernel,
+                          const std::string &configuration,
+                          const std::vector<float> &features) {
+  assert(features.size() == featureNames.size() &&
+         "Row does not match the table columns");
+  modules.push_back(module);
+  kernels.push_back(kernel);
+  configurations.push_back(configuration);
+  this->features.insert(this->features.end(), features.begin(),
+                        features.end());
+}
+
+//------------------------------------------------------------------------------
+unsigned int FeatureTable::getRowNumber() const { return kernels.size(); }
+
+//------------------------------------------------------------------------------
+bool FeatureTable::appendCSV(const std::string &fileName,
+                             std::string &error) const {
+  unsigned int columnNumber = featureNames.size();
+  std::string names = std::string(STRING_COLUMNS[0]) + "," +
+                      STRING_COLUMNS[1] + "," + STRING_COLUMNS[2];
+  for (unsigned int column = 0; column < columnNumber; ++column)
+    names += "," + quoteField(featureNames[column]);
+
+  // The names are written only once, at the top of the file.
+  bool writeNames = isEmptyFile(fileName);
+  if (!writeNames) {
+    OwningPtr<MemoryBuffer> buffer;
+    if (!readFile(fileName, buffer, error))
+      return false;
+    if (buffer->getBuffer().split('\n').first != names) {
+      error = "the columns of the file differ from the ones of the table";
+      return false;
+    }
+  }
+
+  raw_fd_ostream stream(fileName.c_str(), error, sys::fs::F_Append);
+  if (!error.empty())
+    return false;
+
+  if (writeNames)
+    stream << names << "\n";
+
+  for (unsigned int row = 0; row < getRowNumber(); ++row) {
+    stream << quoteField(modules[row]) << "," << quoteField(kernels[row])
+           << "," << quoteField(configurations[row]);
+    for (unsigned int column = 0; column < columnNumber; ++column)
+      stream << "," << features[row * columnNumber + column];
+    stream << "\n";
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool FeatureTable::appendColumnar(const std::string &fileName,
+                                  std::string &error) const {
+  // The names are written only once, at the top of the file.
+  bool writeNames = isEmptyFile(fileName);
+  if (!writeNames) {
+    std::vector<std::string> names;
+    if (!readNames(fileName, names)) {
+      error = "the file is not a feature table";
+      return false;
+    }
+    if (names != featureNames) {
+      error = "the columns of the file differ from the ones of the table";
+      return false;
+    }
+  }
+
+  raw_fd_ostream stream(fileName.c_str(), error,
+                        sys::fs::F_Append | sys::fs::F_Binary);
+  if (!error.empty())
+    return false;
+
+  if (writeNames) {
+    FeatureTableHeader header;
+    memcpy(header.magic, "THRUDTBL", sizeof(header.magic));
+    header.version = TABLE_VERSION;
+    header.featureNumber = featureNames.size();
+    stream.write((const char *)&header, sizeof(header));
+
+    for (unsigned int column = 0; column < featureNames.size(); ++column)
+      writeString(stream, featureNames[column]);
+  }
+
+  uint64_t rowNumber = getRowNumber();
+  stream.write((const char *)&rowNumber, sizeof(rowNumber));
+
+  const std::vector<std::string> *stringColumns[] = { &modules, &kernels,
+                                                      &configurations };
+  for (unsigned int column = 0; column < 3; ++column) {
+    for (unsigned int row = 0; row < getRowNumber(); ++row)
+      writeString(stream, (*stringColumns[column])[row]);
+  }
+
+  unsigned int columnNumber = featureNames.size();
+  for (unsigned int column = 0; column < columnNumber; ++column) {
+    for (unsigned int row = 0; row < getRowNumber(); ++row) {
+      float value = features[row * columnNumber + column];
+      stream.write((const char *)&value, sizeof(value));
+    }
+  }
+
+  return true;
+}
@@ -1,33 +1,71 @@
 #include "thrud/Support/OCLEnv.h"
 
+#include "thrud/Support/DeviceProfile.h"
+#include "thrud/Support/Utils.h"
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
 #include "llvm/IR/Type.h"
 
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/system_error.h"
+
+#include <set>
+#include <sstream>
+
+static cl::list<std::string>
+    KernelArgsCL("kernel-args", cl::ZeroOrMore, cl::Hidden,
+                 cl::desc("Values of the integer kernel arguments: "
+                          "name=value or position=value, comma separated. "
+                          "Repeat for multiple argument sets"));
+static cl::opt<std::string>
+    KernelArgsFileCL("kernel-args-file", cl::init(""), cl::Hidden,
+                     cl::desc("File with an argument set per line, in the "
+                              "same form as -kernel-args"));
+static cl::opt<int>
+    KernelArgDefaultCL("kernel-arg-default", cl::init(1024), cl::Hidden,
+                       cl::desc("Value of the unbound integer kernel "
+                                "arguments"));
 
-const int OCLEnv::BANK_NUMBER = 32;
-const int OCLEnv::BANK_WIDTH = 4;
-const int OCLEnv::WARP_SIZE = 32;
-const int OCLEnv::CACHELINE_SIZE = 128;
 const int OCLEnv::UNKNOWN_MEMORY_LOCATION = -1;
-const unsigned int OCLEnv::LOCAL_AS = 3;
+
+// Support functions.
+// -----------------------------------------------------------------------------
+bool isBindable(const Argument *argument);
 
 OCLEnv::OCLEnv(Function &function, const NDRange *ndRange, const NDRangeSpace &ndRangeSpace)
     : ndRange(ndRange), ndRangeSpace(ndRangeSpace) {
-  setup(function);
+  setup(function, getArgumentSets().front());
+}
+
+OCLEnv::OCLEnv(Function &function, const NDRange *ndRange,
+               const NDRangeSpace &ndRangeSpace, const ArgumentSet &arguments)
+    : ndRange(ndRange), ndRangeSpace(ndRangeSpace) {
+  setup(function, arguments);
 }
 
-void OCLEnv::setup(Function &function) {
+void OCLEnv::setup(Function &function, const ArgumentSet &arguments) {
+  checkArgumentSets(*function.getParent());
+
   // Go through the function arguements and setup the map.
   for (Function::arg_iterator iter = function.arg_begin(),
                               iterEnd = function.arg_end();
        iter != iterEnd; ++iter) {
-    llvm::Value *argument = iter;
-    llvm::Type *type = argument->getType();
+    Argument *argument = iter;
     // Only set the value of the argument if it is an integer.
-    if (type->isIntegerTy()) {
-      // FIXME! Read the input configuration from a file.
-      argumentMap.insert(std::pair<llvm::Value *, int>(argument, 1024));
-    }
+    if (!argument->getType()->isIntegerTy())
+      continue;
+
+    int value = KernelArgDefaultCL;
+    getBinding(arguments, argument, value);
+    argumentMap.insert(std::pair<llvm::Value *, int>(argument, value));
   }
 }
 
@@ -40,3 +78,167 @@ int OCLEnv::resolveValue(llvm::Value *value) const {
   assert(iter != argumentMap.end() && "Argument is not in argument map!");
   return iter->second;
 }
+
+//------------------------------------------------------------------------------
+const std::vector<OCLEnv::ArgumentSet> &OCLEnv::getArgumentSets() {
+  // The options do not change during a run: parse them only once.
+  static std::vector<ArgumentSet> argumentSets;
+  if (!argumentSets.empty())
+    return argumentSets;
+
+  std::vector<std::string> texts(KernelArgsCL.begin(), KernelArgsCL.end());
+
+  if (!KernelArgsFileCL.empty()) {
+    OwningPtr<MemoryBuffer> buffer;
+    if (error_code errorCode = MemoryBuffer::getFile(KernelArgsFileCL, buffer))
+      report_fatal_error("Cannot read " + KernelArgsFileCL + ": " +
+                         errorCode.message());
+
+    SmallVector<StringRef, 16> lines;
+    buffer->getBuffer().split(lines, "\n", -1, false);
+    for (SmallVector<StringRef, 16>::iterator iter = lines.begin(),
+                                              iterEnd = lines.end();
+         iter != iterEnd; ++iter) {
+      // Skip comments and blank lines.
+      StringRef line = iter->split('#').first.trim();
+      if (!line.empty())
+        texts.push_back(line);
+    }
+  }
+
+  for (std::vector<std::string>::iterator iter = texts.begin(),
+                                          iterEnd = texts.end();
+       iter != iterEnd; ++iter) {
+    ArgumentSet arguments;
+    std::string error;
+    if (!parseArgumentSet(*iter, arguments, error))
+      report_fatal_error("Invalid kernel arguments \"" + *iter + "\": " +
+                         error);
+    argumentSets.push_back(arguments);
+  }
+
+  if (argumentSets.empty())
+    argumentSets.push_back(ArgumentSet());
+  return argumentSets;
+}
+
+//------------------------------------------------------------------------------
+void OCLEnv::checkArgumentSets(const Module &module) {
+  // Environments are built for every kernel: check the module only once.
+  static const Module *checkedModule = NULL;
+  if (checkedModule == &module)
+    return;
+  checkedModule = &module;
+
+  // Names and positions of the bindable arguments of all the kernels.
+  // Modules without kernel metadata use all their functions.
+  std::set<std::string> names;
+  bool hasKernels = false;
+  for (Module::const_iterator iter = module.begin(), iterEnd = module.end();
+       iter != iterEnd; ++iter)
+    hasKernels |= isKernel(iter);
+
+  for (Module::const_iterator iter = module.begin(), iterEnd = module.end();
+       iter != iterEnd; ++iter) {
+    const Function *function = iter;
+    if (hasKernels && !isKernel(function))
+      continue;
+
+    int position = 0;
+    for (Function::const_arg_iterator argIter = function->arg_begin(),
+                                      argEnd = function->arg_end();
+         argIter != argEnd; ++argIter, ++position) {
+      if (!isBindable(argIter))
+        continue;
+      std::stringstream positionName;
+      positionName << position;
+      names.insert(argIter->getName());
+      names.insert(positionName.str());
+    }
+  }
+
+  // A binding that names no bindable argument of any kernel is most likely a
+  // typo: fail rather than silently using the default value.
+  const std::vector<ArgumentSet> &argumentSets = getArgumentSets();
+  for (std::vector<ArgumentSet>::const_iterator setIter = argumentSets.begin(),
+                                                setEnd = argumentSets.end();
+       setIter != setEnd; ++setIter) {
+    for (ArgumentSet::const_iterator iter = setIter->begin(),
+                                     iterEnd = setIter->end();
+         iter != iterEnd; ++iter) {
+      if (names.find(iter->first) == names.end())
+        report_fatal_error("Kernel argument \"" + iter->first +
+                           "\" does not match any integer or local pointer "
+                           "argument of the kernels in " +
+                           module.getModuleIdentifier());
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+bool OCLEnv::getBinding(const ArgumentSet &arguments,
+                        const Argument *argument, int &value) {
+  // Bindings by name take precedence over the ones by position.
+  ArgumentSet::const_iterator binding = arguments.find(argument->getName());
+  if (binding == arguments.end()) {
+    std::stringstream positionName;
+    positionName << argument->getArgNo();
+    binding = arguments.find(positionName.str());
+  }
+
+  if (binding == arguments.end())
+    return false;
+  value = binding->second;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool OCLEnv::parseArgumentSet(const std::string &text, ArgumentSet &arguments,
+                              std::string &error) {
+  SmallVector<StringRef, 8> bindings;
+  StringRef(text).split(bindings, ",", -1, false);
+
+  for (SmallVector<StringRef, 8>::iterator iter = bindings.begin(),
+                                           iterEnd = bindings.end();
+       iter != iterEnd; ++iter) {
+    std::pair<StringRef, StringRef> binding = iter->split('=');
+    StringRef name = binding.first.trim();
+    StringRef valueText = binding.second.trim();
+
+    int value;
+    if (name.empty() || valueText.empty() ||
+        valueText.getAsInteger(0, value)) {
+      error = "expected name=value, found \"" + iter->trim().str() + "\"";
+      return false;
+    }
+
+    arguments[name] = value;
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+std::string OCLEnv::toString(const ArgumentSet &arguments) {
+  std::stringstream stream;
+  for (ArgumentSet::const_iterator iter = arguments.begin(),
+                                   iterEnd = arguments.end();
+       iter != iterEnd; ++iter) {
+    if (iter != arguments.begin())
+      stream << ",";
+    stream << iter->first << "=" << iter->second;
+  }
+  return stream.str();
+}
+
+// Support functions.
+//------------------------------------------------------------------------------
+// Integer arguments take values, local pointers the size of their buffer.
+bool isBindable(const Argument *argument) {
+  Type *type = argument->getType();
+  if (type->isIntegerTy())
+    return true;
+  PointerType *pointerType = dyn_cast<PointerType>(type);
+  return pointerType != NULL && pointerType->getAddressSpace() ==
+                                    getDeviceProfile().localAddressSpace;
+}
@@ -0,0 +1,442 @@
+#include "thrud/Support/SCEVProgram.h"
+
+#include "thrud/Support/NDRange.h"
+#include "thrud/Support/NDRangePoint.h"
+#include "thrud/Support/NDRangeSpace.h"
+#include "thrud/Support/OCLEnv.h"
+#include "thrud/Support/Utils.h"
+
+#include "llvm/IR/Instructions.h"
+
+#include <algorithm>
+#include <limits>
+
+// Support functions.
+// -----------------------------------------------------------------------------
+bool addOverflows(int64_t first, int64_t second);
+bool mulOverflows(int64_t first, int64_t second);
+int64_t truncate(int64_t value, int64_t bits);
+int64_t zeroExtend(int64_t value, int64_t bits);
+
+//------------------------------------------------------------------------------
+SCEVProgram::SCEVProgram()
+    : scalarEvolution(NULL), ocl(NULL), valid(false), base(NULL), result(-1) {}
+
+//------------------------------------------------------------------------------
+SCEVProgram::SCEVProgram(const SCEV *scev, ScalarEvolution *scalarEvolution,
+                         const OCLEnv *ocl, Kind kind)
+    : scalarEvolution(scalarEvolution), ocl(ocl), valid(true), base(NULL),
+      result(-1) {
+  // Value programs compile everything as non-additive: pointers make them
+  // invalid.
+  result = compile(scev, kind == AddressProgram);
+  if (kind == AddressProgram && base == NULL)
+    invalidate();
+
+  slots.clear();
+  visitingPhis.clear();
+}
+
+//------------------------------------------------------------------------------
+bool SCEVProgram::isValid() const { return valid; }
+
+//------------------------------------------------------------------------------
+const SCEVUnknown *SCEVProgram::getBase() const { return base; }
+
+//------------------------------------------------------------------------------
+void SCEVProgram::evaluate(const std::vector<NDRangePoint> &points,
+                           std::vector<int> &offsets) const {
+  evaluate(points, IterationMap(), offsets);
+}
+
+//------------------------------------------------------------------------------
+void SCEVProgram::evaluate(const std::vector<NDRangePoint> &points,
+                           const IterationMap &iterations,
+                           std::vector<int> &offsets) const {
+  size_t pointNumber = points.size();
+  offsets.assign(pointNumber, OCLEnv::UNKNOWN_MEMORY_LOCATION);
+  if (!valid || pointNumber == 0)
+    return;
+
+  std::vector<int64_t> values(operations.size() * pointNumber);
+  std::vector<char> defined(pointNumber, 1);
+
+  for (size_t index = 0, end = operations.size(); index != end; ++index) {
+    const Operation &operation = operations[index];
+    int64_t *out = &values[index * pointNumber];
+    const int64_t *first =
+        operation.first < 0 ? NULL : &values[operation.first * pointNumber];
+    const int64_t *second =
+        operation.second < 0 ? NULL : &values[operation.second * pointNumber];
+    int direction = (int)operation.value;
+
+    switch (operation.opcode) {
+    case Constant:
+      std::fill(out, out + pointNumber, operation.value);
+      break;
+    case LocalId:
+      for (size_t point = 0; point < pointNumber; ++point)
+        out[point] = points[point].getLocal(direction);
+      break;
+    case GlobalId:
+      for (size_t point = 0; point < pointNumber; ++point)
+        out[point] = points[point].getGlobal(direction);
+      break;
+    case GroupId:
+      for (size_t point = 0; point < pointNumber; ++point)
+        out[point] = points[point].getGroup(direction);
+      break;
+    case Iteration: {
+      IterationMap::const_iterator iter = iterations.find(loops[direction]);
+      int64_t iteration = iter == iterations.end() ? 0 : iter->second;
+      std::fill(out, out + pointNumber, iteration);
+      break;
+    }
+    case Binomial:
+      for (size_t point = 0; point < pointNumber; ++point) {
+        // The product of k consecutive integers is divisible by k!.
+        int64_t coefficient = 1;
+        for (int64_t index = 0; index < operation.value; ++index) {
+          if (addOverflows(first[point], -index) ||
+              mulOverflows(coefficient, first[point] - index)) {
+            defined[point] = 0;
+            coefficient = 0;
+            break;
+          }
+          coefficient = coefficient * (first[point] - index) / (index + 1);
+        }
+        out[point] = coefficient;
+      }
+      break;
+    case Add:
+      for (size_t point = 0; point < pointNumber; ++point) {
+        if (addOverflows(first[point], second[point])) {
+          defined[point] = 0;
+          out[point] = 0;
+          continue;
+        }
+        out[point] = first[point] + second[point];
+      }
+      break;
+    case Mul:
+      for (size_t point = 0; point < pointNumber; ++point) {
+        if (mulOverflows(first[point], second[point])) {
+          defined[point] = 0;
+          out[point] = 0;
+          continue;
+        }
+        out[point] = first[point] * second[point];
+      }
+      break;
+    case Trunc:
+      for (size_t point = 0; point < pointNumber; ++point)
+        out[point] = truncate(first[point], operation.value);
+      break;
+    case ZExt:
+      for (size_t point = 0; point < pointNumber; ++point)
+        out[point] = zeroExtend(first[point], operation.value);
+      break;
+    case SMax:
+      for (size_t point = 0; point < pointNumber; ++point)
+        out[point] = std::max(first[point], second[point]);
+      break;
+    case UMax:
+      for (size_t point = 0; point < pointNumber; ++point)
+        out[point] = (uint64_t)first[point] > (uint64_t)second[point]
+                         ? first[point]
+                         : second[point];
+      break;
+    case UDiv:
+      for (size_t point = 0; point < pointNumber; ++point) {
+        if (second[point] == 0) {
+          defined[point] = 0;
+          out[point] = 0;
+          continue;
+        }
+        out[point] = (uint64_t)first[point] / (uint64_t)second[point];
+      }
+      break;
+    case SDiv:
+      for (size_t point = 0; point < pointNumber; ++point) {
+        if (second[point] == 0 ||
+            (second[point] == -1 &&
+             first[point] == std::numeric_limits<int64_t>::min())) {
+          defined[point] = 0;
+          out[point] = 0;
+          continue;
+        }
+        out[point] = first[point] / second[point];
+      }
+      break;
+    case URem:
+      for (size_t point = 0; point < pointNumber; ++point) {
+        if (second[point] == 0) {
+          defined[point] = 0;
+          out[point] = 0;
+          continue;
+        }
+        out[point] = (uint64_t)first[point] % (uint64_t)second[point];
+      }
+      break;
+    }
+  }
+
+  const int64_t *resultValues = &values[result * pointNumber];
+  for (size_t point = 0; point < pointNumber; ++point) {
+    int64_t value = resultValues[point];
+    if (defined[point] && value >= std::numeric_limits<int>::min() &&
+        value <= std::numeric_limits<int>::max())
+      offsets[point] = (int)value;
+  }
+}
+
+//------------------------------------------------------------------------------
+// additive is true if scev contributes to the address with coefficient one:
+// only there the base of the address can appear.
+int SCEVProgram::compile(const SCEV *scev, bool additive) {
+  if (!valid)
+    return -1;
+
+  // Sub-expressions containing the base are not shared: the base must be
+  // counted every time it appears.
+  if (!additive) {
+    std::map<const SCEV *, int>::iterator iter = slots.find(scev);
+    if (iter != slots.end())
+      return iter->second;
+  }
+
+  int slot = -1;
+  if (const SCEVConstant *constant = dyn_cast<SCEVConstant>(scev)) {
+    const APInt &value = constant->getValue()->getValue();
+    if (value.getMinSignedBits() > 64)
+      return invalidate();
+    slot = emit(Constant, value.getSExtValue(), -1, -1);
+  } else if (const SCEVAddRecExpr *addRec = dyn_cast<SCEVAddRecExpr>(scev)) {
+    slot = compileAddRec(addRec, additive);
+  } else if (const SCEVAddExpr *add = dyn_cast<SCEVAddExpr>(scev)) {
+    slot = compileNAry(add, Add, additive);
+  } else if (const SCEVMulExpr *mul = dyn_cast<SCEVMulExpr>(scev)) {
+    slot = compileNAry(mul, Mul, false);
+  } else if (const SCEVSMaxExpr *smax = dyn_cast<SCEVSMaxExpr>(scev)) {
+    slot = compileNAry(smax, SMax, false);
+  } else if (const SCEVUMaxExpr *umax = dyn_cast<SCEVUMaxExpr>(scev)) {
+    slot = compileNAry(umax, UMax, false);
+  } else if (const SCEVUDivExpr *udiv = dyn_cast<SCEVUDivExpr>(scev)) {
+    int lhs = compile(udiv->getLHS(), false);
+    int rhs = compile(udiv->getRHS(), false);
+    if (!valid)
+      return -1;
+    slot = emit(UDiv, 0, lhs, rhs);
+  } else if (const SCEVTruncateExpr *trunc =
+                 dyn_cast<SCEVTruncateExpr>(scev)) {
+    int operand = compile(trunc->getOperand(), false);
+    if (!valid)
+      return -1;
+    slot = emit(Trunc, scalarEvolution->getTypeSizeInBits(trunc->getType()),
+                operand, -1);
+  } else if (const SCEVZeroExtendExpr *zext =
+                 dyn_cast<SCEVZeroExtendExpr>(scev)) {
+    const SCEV *operand = zext->getOperand();
+    int value = compile(operand, false);
+    if (!valid)
+      return -1;
+    slot = emit(ZExt, scalarEvolution->getTypeSizeInBits(operand->getType()),
+                value, -1);
+  } else if (const SCEVSignExtendExpr *sext =
+                 dyn_cast<SCEVSignExtendExpr>(scev)) {
+    // Values are kept sign extended to 64 bits.
+    slot = compile(sext->getOperand(), additive);
+  } else if (const SCEVUnknown *unknown = dyn_cast<SCEVUnknown>(scev)) {
+    slot = compileUnknown(unknown, additive);
+  } else {
+    return invalidate();
+  }
+
+  if (!valid)
+    return -1;
+
+  if (!additive)
+    slots[scev] = slot;
+  return slot;
+}
+
+//------------------------------------------------------------------------------
+// The value of {a0,+,a1,+,...,an} at iteration i is the sum of
+// ak * (i choose k).
+int SCEVProgram::compileAddRec(const SCEVAddRecExpr *expr, bool additive) {
+  const Loop *loop = expr->getLoop();
+  int loopIndex = std::find(loops.begin(), loops.end(), loop) - loops.begin();
+  if (loopIndex == (int)loops.size())
+    loops.push_back(loop);
+
+  int slot = compile(expr->getStart(), additive);
+  if (!valid)
+    return -1;
+
+  int iteration = emit(Iteration, loopIndex, -1, -1);
+  for (unsigned int index = 1, end = expr->getNumOperands(); index != end;
+       ++index) {
+    // Only the start can contain the base.
+    int operand = compile(expr->getOperand(index), false);
+    if (!valid)
+      return -1;
+
+    int coefficient =
+        index == 1 ? iteration : emit(Binomial, index, iteration, -1);
+    int term = emit(Mul, 0, operand, coefficient);
+    slot = emit(Add, 0, slot, term);
+  }
+
+  return slot;
+}
+
+//------------------------------------------------------------------------------
+int SCEVProgram::compileNAry(const SCEVNAryExpr *expr, Opcode opcode,
+                             bool additive) {
+  int slot = -1;
+  for (SCEVNAryExpr::op_iterator iter = expr->op_begin(),
+                                 iterEnd = expr->op_end();
+       iter != iterEnd; ++iter) {
+    int operand = compile(*iter, additive);
+    if (!valid)
+      return -1;
+    slot = slot == -1 ? operand : emit(opcode, 0, slot, operand);
+  }
+  return slot;
+}
+
+//------------------------------------------------------------------------------
+int SCEVProgram::compileUnknown(const SCEVUnknown *expr, bool additive) {
+  Value *value = expr->getValue();
+
+  if (Instruction *inst = dyn_cast<Instruction>(value))
+    return compileInstruction(inst, additive);
+
+  // Integer arguments of the kernel are bound by OCLEnv.
+  if (isa<Argument>(value) && value->getType()->isIntegerTy())
+    return emit(Constant, ocl->resolveValue(value), -1, -1);
+
+  // Pointer arguments and global variables: the base of the address.
+  if (!additive || base != NULL)
+    return invalidate();
+  base = expr;
+  return emit(Constant, 0, -1, -1);
+}
+
+//------------------------------------------------------------------------------
+int SCEVProgram::compileInstruction(Instruction *inst, bool additive) {
+  // Binary operations scalar evolution does not model.
+  if (BinaryOperator *binOp = dyn_cast<BinaryOperator>(inst)) {
+    Opcode opcode;
+    switch (binOp->getOpcode()) {
+    case Instruction::URem:
+      opcode = URem;
+      break;
+    case Instruction::SDiv:
+      opcode = SDiv;
+      break;
+    default:
+      return invalidate();
+    }
+
+    int first = compile(scalarEvolution->getSCEV(binOp->getOperand(0)), false);
+    int second =
+        compile(scalarEvolution->getSCEV(binOp->getOperand(1)), false);
+    if (!valid)
+      return -1;
+    return emit(opcode, 0, first, second);
+  }
+
+  // Reinterpreting casts.
+  if (IsIntCast(inst)) {
+    Value *argument = cast<CallInst>(inst)->getArgOperand(0);
+    if (!scalarEvolution->isSCEVable(argument->getType()))
+      return invalidate();
+    return compile(scalarEvolution->getSCEV(argument), additive);
+  }
+
+  // FIXME: Pick the first argument of the phi node.
+  if (PHINode *phi = dyn_cast<PHINode>(inst)) {
+    Value *incoming = phi->getIncomingValue(0);
+    if (!scalarEvolution->isSCEVable(incoming->getType()) ||
+        !visitingPhis.insert(phi).second)
+      return invalidate();
+    int slot = compile(scalarEvolution->getSCEV(incoming), additive);
+    visitingPhis.erase(phi);
+    return slot;
+  }
+
+  const NDRange *ndr = ocl->getNDRange();
+  std::string type = ndr->getType(inst);
+
+  if (ndr->isCoordinate(inst)) {
+    int direction = ndr->getDirection(inst);
+    if (type == NDRange::GET_LOCAL_ID)
+      return emit(LocalId, direction, -1, -1);
+    if (type == NDRange::GET_GLOBAL_ID)
+      return emit(GlobalId, direction, -1, -1);
+    return emit(GroupId, direction, -1, -1);
+  }
+
+  if (ndr->isSize(inst)) {
+    int direction = ndr->getDirection(inst);
+    return emit(Constant, ocl->getNDRangeSpace().getSize(type, direction), -1,
+                -1);
+  }
+
+  return invalidate();
+}
+
+//------------------------------------------------------------------------------
+int SCEVProgram::emit(Opcode opcode, int64_t value, int first, int second) {
+  Operation operation;
+  operation.opcode = opcode;
+  operation.value = value;
+  operation.first = first;
+  operation.second = second;
+  operations.push_back(operation);
+  return operations.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+int SCEVProgram::invalidate() {
+  valid = false;
+  return -1;
+}
+
+// Support functions.
+//------------------------------------------------------------------------------
+bool addOverflows(int64_t first, int64_t second) {
+  if (second > 0)
+    return first > std::numeric_limits<int64_t>::max() - second;
+  return first < std::numeric_limits<int64_t>::min() - second;
+}
+
+//------------------------------------------------------------------------------
+bool mulOverflows(int64_t first, int64_t second) {
+  if (first == 0 || second == 0)
+    return false;
+  int64_t max = std::numeric_limits<int64_t>::max();
+  int64_t min = std::numeric_limits<int64_t>::min();
+  if (first > 0)
+    return second > 0 ? first > max / second : second < min / first;
+  return second > 0 ? first < min / second : first < max / second;
+}
+
+//------------------------------------------------------------------------------
+// Keep the low bits of value, sign extended.
+int64_t truncate(int64_t value, int64_t bits) {
+  if (bits >= 64)
+    return value;
+  uint64_t sign = (uint64_t)1 << (bits - 1);
+  uint64_t low = (uint64_t)value & ((sign << 1) - 1);
+  return (int64_t)((low ^ sign) - sign);
+}
+
+//------------------------------------------------------------------------------
+// Keep the low bits of value, zero extended.
+int64_t zeroExtend(int64_t value, int64_t bits) {
+  if (bits >= 64)
+    return value;
+  return (int64_t)((uint64_t)value & (((uint64_t)1 << bits) - 1));
+}
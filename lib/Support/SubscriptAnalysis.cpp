@@ -2,38 +2,55 @@
 
 #include "llvm/IR/Instructions.h"
 
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InstIterator.h"
 #include "llvm/Support/raw_ostream.h"
 
-#include "thrud/Support/NDRange.h"
+#include "thrud/Support/DeviceProfile.h"
 #include "thrud/Support/NDRangePoint.h"
 #include "thrud/Support/OCLEnv.h"
 #include "thrud/Support/Warp.h"
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <iterator>
+#include <limits>
+#include <set>
 
 int getTypeWidth(const Type *type);
+int getAccessWidth(const Value *pointer);
+int clampToInt(double value);
+int floorDivide(int dividend, int divisor);
+
+static cl::opt<unsigned int> LoopIterationsCL(
+    "symbolic-loop-iterations", cl::init(16), cl::Hidden,
+    cl::desc("Maximum number of iterations of each loop accesses in loops "
+             "are evaluated on"));
+static cl::opt<unsigned int> DefaultTripCountCL(
+    "symbolic-default-trip-count", cl::init(16), cl::Hidden,
+    cl::desc("Trip count of loops scalar evolution cannot compute"));
+static cl::opt<unsigned int> BankWidthCL(
+    "symbolic-bank-width", cl::init(0), cl::Hidden,
+    cl::desc("Width of the local memory banks in bytes, 0 for the bank width "
+             "of the device (eg: 8 for the 64-bit mode of Kepler)"));
 
 //------------------------------------------------------------------------------
 SubscriptAnalysis::SubscriptAnalysis(ScalarEvolution *scalarEvolution,
                                      OCLEnv *ocl, const Warp &warp)
-    : scalarEvolution(scalarEvolution), ocl(ocl), warp(warp) {}
+    : scalarEvolution(scalarEvolution), ocl(ocl), warp(warp), accessWidth(0) {}
 
 //------------------------------------------------------------------------------
-int SubscriptAnalysis::getBankConflictNumber(Value *value) {
-  //errs() << "SubscriptAnalysis::getBankConflictNumber\n";
-  if (!isa<GetElementPtrInst>(value)) {
-    return 0;
-  }
+void SubscriptAnalysis::setWarp(const Warp &warp) { this->warp = warp; }
 
-  if (!scalarEvolution->isSCEVable(value->getType())) {
-    return -1;
-  }
+//------------------------------------------------------------------------------
+int SubscriptAnalysis::getBankConflictNumber(Value *value) {
+  // Any pointer is accepted: accesses to the first element of a __local
+  // array or through a constant GEP do not go through a GEP instruction.
+  accessWidth = getAccessWidth(value);
 
-  const SCEV *scev = scalarEvolution->getSCEV(value);
-  std::vector<const SCEV *> addressesVector = analyzeSubscript(scev);
-  return computeBankConflictNumber(addressesVector);
+  std::vector<int> offsets = getMemoryOffsets(value, warp.getPoints());
+  return computeBankConflictNumber(offsets);
 }
 
 //------------------------------------------------------------------------------
@@ -50,11 +67,9 @@ bool SubscriptAnalysis::isConsecutive(Value *value, int direction) {
     return -1;
   }
 
-  const SCEV *scev = scalarEvolution->getSCEV(value);
-
   const int TEST_NUMBER = 64;
-  std::vector<const SCEV *> addresses;
-  addresses.reserve(OCLEnv::WARP_SIZE);
+  std::vector<NDRangePoint> points;
+  points.reserve(TEST_NUMBER);
   
   NDRangeSpace ndrSpace(1024, 1024, 1024, 1024, 1024, 1024);
 
@@ -65,24 +80,11 @@ bool SubscriptAnalysis::isConsecutive(Value *value, int direction) {
   // Increment along direction. 
   for (int index = 0; index < TEST_NUMBER; ++index) {
     NDRangePoint point(isFirst * index, isSecond * index, isThird * index, 0, 0, 0, ndrSpace);
-    SCEVMap processed;
-    const SCEV *expr = replaceInExpr(scev, point, processed);
-    addresses.push_back(expr);
-  }
-
-  assert((int)addresses.size() == TEST_NUMBER && "Missing addresses");
-
-  const SCEV *first = addresses[0];
-  int typeWidth = getTypeWidth(first->getType());
-
-  const SCEV *unknown = getUnknownSCEV(first);
-  if (unknown == NULL) {
-    return OCLEnv::WARP_SIZE;
+    points.push_back(point);
   }
 
-  verifyUnknown(addresses, unknown);
-
-  std::vector<int> indices = getMemoryOffsets(addresses, unknown);
+  int typeWidth = getTypeWidth(value->getType());
+  std::vector<int> indices = getMemoryOffsets(value, points);
 
   // If any of the indices is UNKNOWN_MEMORY_LOCATION do something special.
   std::vector<int>::iterator unknownMemoryLocationPosition = std::find(
@@ -110,449 +112,294 @@ int SubscriptAnalysis::getTransactionNumber(Value *value) {
     return -1;
   }
 
-  const SCEV *scev = scalarEvolution->getSCEV(value);
-  std::vector<const SCEV *> addressesVector = analyzeSubscript(scev);
-  return computeTransactionNumber(addressesVector);
+  std::vector<int> offsets = getMemoryOffsets(value, warp.getPoints());
+  return computeTransactionNumber(offsets);
 }
 
 //------------------------------------------------------------------------------
-std::vector<const SCEV *>
-SubscriptAnalysis::analyzeSubscript(const SCEV *scev) {
-  std::vector<const SCEV *> resultVector;
-  resultVector.reserve(OCLEnv::WARP_SIZE);
-
-  // Iterate over threads in a warp.
-  for (Warp::iterator iter = warp.begin(), iterEnd = warp.end();
-       iter != iterEnd; ++iter) {
-    NDRangePoint point = *iter;
-    SCEVMap processed;
-    const SCEV *expr = replaceInExpr(scev, point, processed);
-    resultVector.push_back(expr);
-  }
-
-  assert((int)resultVector.size() == OCLEnv::WARP_SIZE &&
-         "Missing expressions");
-  return resultVector;
+int SubscriptAnalysis::getLoopBankConflictNumber(Value *value,
+                                                 const Loop *loop,
+                                                 int &iterations, int &total) {
+  accessWidth = getAccessWidth(value);
+  return evaluateInLoop(value, loop,
+                        &SubscriptAnalysis::computeBankConflictNumber,
+                        iterations, total);
 }
 
 //------------------------------------------------------------------------------
-int SubscriptAnalysis::computeBankConflictNumber(
-    const std::vector<const SCEV *> &scevs) {
-
-  const SCEV *first = scevs[0];
-  const SCEV *unknown = getUnknownSCEV(first);
-  if (unknown == NULL) {
-    // FIXME It don't know how to deal with this case. Yet.
-    assert(false);
-    return OCLEnv::BANK_NUMBER;
-  }
-
-  verifyUnknown(scevs, unknown);
-  assert((int)scevs.size() == OCLEnv::WARP_SIZE && "Wrong number of SCEVs");
-
-  std::vector<int> indices = getMemoryOffsets(scevs, unknown);
-
-  // If any of the indices is UNKNOWN_MEMORY_LOCATION do something special.
-  std::vector<int>::iterator unknownMemoryLocationPosition = std::find(
-      indices.begin(), indices.end(), OCLEnv::UNKNOWN_MEMORY_LOCATION);
-
-  if (unknownMemoryLocationPosition != indices.end()) {
-    // FIXME It don't know how to deal with this case. Yet.
-    assert(false);
-    return OCLEnv::BANK_NUMBER;
+int SubscriptAnalysis::getLoopTransactionNumber(Value *value, const Loop *loop,
+                                                int &iterations, int &total) {
+  if (!isa<GetElementPtrInst>(value)) {
+    iterations = 0;
+    total = 0;
+    return 0;
   }
 
-  std::vector<int> rows;
-  std::vector<int> columns;
-
-  rows.reserve(OCLEnv::WARP_SIZE);
-  columns.reserve(OCLEnv::WARP_SIZE);
-
-  const int LOCAL_MEMORY_WIDTH = OCLEnv::BANK_NUMBER * OCLEnv::BANK_WIDTH;
+  return evaluateInLoop(value, loop,
+                        &SubscriptAnalysis::computeTransactionNumber,
+                        iterations, total);
+}
 
-  // This is the actual computation of the number of bank conflicts.
-  for (std::vector<int>::iterator iter = indices.begin(),
-                                  iterEnd = indices.end();
-       iter != iterEnd; ++iter) {
-    columns.push_back(*iter % (OCLEnv::BANK_NUMBER));
+//------------------------------------------------------------------------------
+int SubscriptAnalysis::evaluateInLoop(Value *value, const Loop *loop,
+                                      ComputeFunction compute, int &iterations,
+                                      int &total) {
+  iterations = 0;
+  total = 0;
+
+  // Addresses that cannot be analyzed are unknown on every iteration.
+  const SCEVProgram &program = getProgram(value);
+
+  // Outermost loop first: the trip count of inner loops can depend on the
+  // iteration of the outer ones.
+  std::vector<const Loop *> nest;
+  for (const Loop *current = loop; current != NULL;
+       current = current->getParentLoop()) {
+    nest.insert(nest.begin(), current);
   }
 
-  std::transform(indices.begin(), indices.end(), std::back_inserter(rows),
-                 std::bind2nd(std::divides<int>(), LOCAL_MEMORY_WIDTH));
+  SCEVProgram::IterationMap iterationMap;
+  std::vector<char> active(warp.size(), 1);
+  double nestIterations = 0;
+  double nestTotal = 0;
+  evaluateNest(program, nest, 0, 1, active, iterationMap, compute,
+               nestIterations, nestTotal);
 
-  assert((int)rows.size() == OCLEnv::WARP_SIZE && "Wrong number of rows");
-  assert(rows.size() == columns.size() && "Rows and Columns don't match");
+  iterations = clampToInt(nestIterations);
+  total = clampToInt(nestTotal);
+  if (nestIterations == 0)
+    return 0;
+  return clampToInt(nestTotal / nestIterations);
+}
 
-  std::map<int, std::vector<int> > localMemory;
+//------------------------------------------------------------------------------
+// Evaluate the iterations of the loop at the given level of the nest.
+// weight is the number of iterations of the enclosing loops each evaluated
+// iteration stands for, active marks the work items still in the loop.
+void SubscriptAnalysis::evaluateNest(const SCEVProgram &program,
+                                     const std::vector<const Loop *> &nest,
+                                     unsigned int level, double weight,
+                                     const std::vector<char> &active,
+                                     SCEVProgram::IterationMap &iterationMap,
+                                     ComputeFunction compute,
+                                     double &iterations, double &total) {
+  const std::vector<NDRangePoint> &points = warp.getPoints();
+
+  if (level == nest.size()) {
+    std::vector<int> offsets;
+    program.evaluate(points, iterationMap, offsets);
+
+    std::vector<int> activeOffsets;
+    for (unsigned int index = 0; index < offsets.size(); ++index) {
+      if (active[index])
+        activeOffsets.push_back(offsets[index]);
+    }
 
-  for (int index = 0; index < OCLEnv::WARP_SIZE; ++index) {
-    int row = rows[index];
-    int column = columns[index];
+    if (activeOffsets.empty())
+      return;
 
-    localMemory[column].push_back(row); 
+    iterations += weight;
+    total += weight * (this->*compute)(activeOffsets);
+    return;
   }
 
-  for (std::map<int, std::vector<int> >::iterator iter = localMemory.begin(),
-                                                  iterEnd = localMemory.end();
-       iter != iterEnd; ++iter) {
-    errs() << iter->first << " -- ";
-    dumpIntVector(iter->second);
-    errs() << "\n";
+  // The warp runs the loop until the last of its work items leaves it.
+  const Loop *loop = nest[level];
+  std::vector<int> tripCounts = getTripCounts(loop, iterationMap);
+  int maxTripCount = 0;
+  for (unsigned int index = 0; index < tripCounts.size(); ++index) {
+    if (active[index])
+      maxTripCount = std::max(maxTripCount, tripCounts[index]);
   }
 
-  int conflictNumber = 0;
+  if (maxTripCount == 0)
+    return;
 
-  for (std::map<int, std::vector<int> >::iterator iter = localMemory.begin(),
-                                                  iterEnd = localMemory.end();
-       iter != iterEnd; ++iter) {
+  // Sample iterations evenly, the first and the last are always included.
+  unsigned int samples = std::min(std::max((unsigned int)LoopIterationsCL, 1u),
+                                  (unsigned int)maxTripCount);
+  double sampleWeight = weight * maxTripCount / samples;
 
-    std::vector<int> &currentRows = iter->second;
-    std::sort(currentRows.begin(), currentRows.end());
+  std::vector<char> iterationActive(active.size());
+  for (unsigned int sample = 0; sample < samples; ++sample) {
+    int iteration =
+        samples == 1 ? 0 : (int64_t)sample * (maxTripCount - 1) / (samples - 1);
 
-    std::vector<int>::iterator uniqueEnd =
-        std::unique(currentRows.begin(), currentRows.end());
-  
-    int uniqueRows = std::distance(currentRows.begin(), uniqueEnd);
-    --uniqueRows;
-
-    conflictNumber = std::max(conflictNumber, uniqueRows);
+    for (unsigned int index = 0; index < active.size(); ++index) {
+      iterationActive[index] = active[index] && iteration < tripCounts[index];
+    }
 
+    iterationMap[loop] = iteration;
+    evaluateNest(program, nest, level + 1, sampleWeight, iterationActive,
+                 iterationMap, compute, iterations, total);
   }
-
-  return conflictNumber;
+  iterationMap.erase(loop);
 }
 
 //------------------------------------------------------------------------------
-int SubscriptAnalysis::computeTransactionNumber(
-    const std::vector<const SCEV *> &scevs) {
-  const SCEV *first = scevs[0];
-
-  const SCEV *unknown = getUnknownSCEV(first);
-  if (unknown == NULL) {
-    return OCLEnv::WARP_SIZE;
-  }
-
-  verifyUnknown(scevs, unknown);
-
-  assert((int)scevs.size() == OCLEnv::WARP_SIZE && "Wrong number of SCEVs");
-
-  std::vector<int> indices = getMemoryOffsets(scevs, unknown);
-
-  // If any of the indices is UNKNOWN_MEMORY_LOCATION do something special.
-  std::vector<int>::iterator unknownMemoryLocationPosition = std::find(
-      indices.begin(), indices.end(), OCLEnv::UNKNOWN_MEMORY_LOCATION);
-
-  if (unknownMemoryLocationPosition != indices.end()) {
-    return OCLEnv::WARP_SIZE;
-  }
-
-  // This is the actual computation of the number of transactions. 
-  std::transform(indices.begin(), indices.end(), indices.begin(),
-                 std::bind2nd(std::divides<int>(), OCLEnv::CACHELINE_SIZE));
-
-  std::sort(indices.begin(), indices.end());
-  std::vector<int>::iterator uniqueEnd =
-      std::unique(indices.begin(), indices.end());
-
-  int uniqueCacheLines = std::distance(indices.begin(), uniqueEnd);
-
-  return uniqueCacheLines;
+const SCEVUnknown *
+SubscriptAnalysis::getMemoryOffsets(Value *value,
+                                    const SCEVProgram::IterationMap &iterations,
+                                    std::vector<int> &offsets) {
+  const SCEVProgram &program = getProgram(value);
+  program.evaluate(warp.getPoints(), iterations, offsets);
+  return program.isValid() ? program.getBase() : NULL;
 }
 
 //------------------------------------------------------------------------------
-const SCEVUnknown *SubscriptAnalysis::getUnknownSCEV(const SCEV *scev) {
-  if (const SCEVUnknown *unknown = dyn_cast<SCEVUnknown>(scev)) {
-    return unknown;
-  }
-
-  if (const SCEVAddExpr *add = dyn_cast<SCEVAddExpr>(scev)) {
-    if (add->getNumOperands() != 2)
-      return NULL;
-
-    if (isa<SCEVConstant>(add->getOperand(0)) &&
-        isa<SCEVUnknown>(add->getOperand(1))) {
-      return dyn_cast<SCEVUnknown>(add->getOperand(1));
-    }
-
-    if (isa<SCEVConstant>(add->getOperand(1)) &&
-        isa<SCEVUnknown>(add->getOperand(0))) {
-      return dyn_cast<SCEVUnknown>(add->getOperand(0));
-    }
-
-    return NULL;
+std::vector<int> SubscriptAnalysis::getTripCounts(
+    const Loop *loop, const SCEVProgram::IterationMap &iterationMap) {
+  std::vector<int> tripCounts;
+  getTripCountProgram(loop).evaluate(warp.getPoints(), iterationMap,
+                                     tripCounts);
+  for (unsigned int index = 0; index < tripCounts.size(); ++index) {
+    if (tripCounts[index] < 0 ||
+        tripCounts[index] == std::numeric_limits<int>::max())
+      tripCounts[index] = DefaultTripCountCL;
+    else
+      ++tripCounts[index];
   }
 
-  return NULL;
+  return tripCounts;
 }
 
-bool SubscriptAnalysis::verifyUnknown(const SCEV *scev, const SCEV *unknown) {
-  if (const SCEVAddExpr *add = dyn_cast<SCEVAddExpr>(scev)) {
-    return std::find(add->op_begin(), add->op_end(), unknown) != add->op_end();
-  }
-  return false;
-}
-
-bool SubscriptAnalysis::verifyUnknown(const std::vector<const SCEV *> &scevs,
-                                      const SCEV *unknown) {
-  bool ok = true;
-  for (std::vector<const SCEV *>::const_iterator iter = scevs.begin(),
-                                                 iterEnd = scevs.end();
+//------------------------------------------------------------------------------
+void SubscriptAnalysis::compilePrograms(Function &function,
+                                        LoopInfo *loopInfo) {
+  for (inst_iterator iter = inst_begin(function), iterEnd = inst_end(function);
        iter != iterEnd; ++iter) {
-    ok &= verifyUnknown(*iter, unknown);
+    Instruction *inst = &*iter;
+    if (LoadInst *load = dyn_cast<LoadInst>(inst))
+      getProgram(load->getPointerOperand());
+    if (StoreInst *store = dyn_cast<StoreInst>(inst))
+      getProgram(store->getPointerOperand());
   }
-  return ok;
-}
 
-//------------------------------------------------------------------------------
-const SCEV *SubscriptAnalysis::replaceInExpr(const SCEV *expr,
-                                             const NDRangePoint &point,
-                                             SCEVMap &processed) {
-  SCEVMap::iterator iter = processed.find(expr);
-  if (iter != processed.end()) {
-    return processed[expr];
+  std::vector<const Loop *> loops(loopInfo->begin(), loopInfo->end());
+  while (!loops.empty()) {
+    const Loop *loop = loops.back();
+    loops.pop_back();
+    getTripCountProgram(loop);
+    loops.insert(loops.end(), loop->begin(), loop->end());
   }
-
-  const SCEV *result = NULL;
-
-  // FIXME: This is ugly.
-  if (const SCEVCommutativeExpr *tmp = dyn_cast<SCEVCommutativeExpr>(expr))
-    result = replaceInExpr(tmp, point, processed);
-  if (const SCEVConstant *tmp = dyn_cast<SCEVConstant>(expr))
-    result = replaceInExpr(tmp, point, processed);
-  if (const SCEVUnknown *tmp = dyn_cast<SCEVUnknown>(expr))
-    result = replaceInExpr(tmp, point, processed);
-  if (const SCEVUDivExpr *tmp = dyn_cast<SCEVUDivExpr>(expr))
-    result = replaceInExpr(tmp, point, processed);
-  if (const SCEVAddRecExpr *tmp = dyn_cast<SCEVAddRecExpr>(expr))
-    result = replaceInExpr(tmp, point, processed);
-  if (const SCEVCastExpr *tmp = dyn_cast<SCEVCastExpr>(expr))
-    result = replaceInExpr(tmp, point, processed);
-
-  processed[expr] = result;
-
-  return result;
 }
 
 //------------------------------------------------------------------------------
-const SCEV *SubscriptAnalysis::replaceInExpr(const SCEVAddRecExpr *expr,
-                                             const NDRangePoint &point,
-                                             SCEVMap &processed) {
-  //expr->dump();
-  const SCEV *start = expr->getStart();
-  // const SCEV* step = addRecExpr->getStepRecurrence(*scalarEvolution);
-  // Check that the step is independent of the TID. TODO.
-  return replaceInExpr(start, point, processed);
+// Pointers scalar evolution cannot handle get an invalid program: their
+// offsets are unknown.
+const SCEVProgram &SubscriptAnalysis::getProgram(Value *value) {
+  std::map<const Value *, SCEVProgram>::iterator iter = programs.find(value);
+  if (iter != programs.end())
+    return iter->second;
+
+  if (!scalarEvolution->isSCEVable(value->getType()))
+    return programs[value] = SCEVProgram();
+  return programs[value] =
+             SCEVProgram(scalarEvolution->getSCEV(value), scalarEvolution, ocl);
 }
 
 //------------------------------------------------------------------------------
-const SCEV *SubscriptAnalysis::replaceInExpr(const SCEVCommutativeExpr *expr,
-                                             const NDRangePoint &point,
-                                             SCEVMap &processed) {
-  //llvm::errs() << "SCEVCommutativeExpr:";
-  //expr->dump();
-  SmallVector<const SCEV *, 8> operands;
-  for (SCEVNAryExpr::op_iterator I = expr->op_begin(), E = expr->op_end();
-       I != E; ++I) {
-    const SCEV *NewOperand = replaceInExpr(*I, point, processed);
-    if (isa<SCEVCouldNotCompute>(NewOperand))
-      return scalarEvolution->getCouldNotCompute();
-    operands.push_back(NewOperand);
-  }
-  const SCEV *result = NULL;
-
-  //for (SmallVector<const SCEV *, 8>::iterator iter = operands.begin(),
-  //                                            iterEnd = operands.end();
-  //     iter != iterEnd; ++iter) {
-  //  (*iter)->dump();
-  //}
-
-  if (isa<SCEVAddExpr>(expr))
-    result = scalarEvolution->getAddExpr(operands);
-  if (isa<SCEVMulExpr>(expr))
-    result = scalarEvolution->getMulExpr(operands);
-  if (isa<SCEVSMaxExpr>(expr))
-    result = scalarEvolution->getSMaxExpr(operands);
-  if (isa<SCEVUMaxExpr>(expr))
-    result = scalarEvolution->getUMaxExpr(operands);
-
-  return result;
+const SCEVProgram &SubscriptAnalysis::getTripCountProgram(const Loop *loop) {
+  std::map<const Loop *, SCEVProgram>::iterator iter =
+      tripCountPrograms.find(loop);
+  if (iter != tripCountPrograms.end())
+    return iter->second;
+
+  const SCEV *backedgeTakenCount =
+      scalarEvolution->getBackedgeTakenCount(const_cast<Loop *>(loop));
+  return tripCountPrograms[loop] =
+             SCEVProgram(backedgeTakenCount, scalarEvolution, ocl,
+                         SCEVProgram::ValueProgram);
 }
 
 //------------------------------------------------------------------------------
-const SCEV *SubscriptAnalysis::replaceInExpr(const SCEVConstant *expr,
-                                             const NDRangePoint &point,
-                                             SCEVMap &processed) {
-  return expr;
+std::vector<int>
+SubscriptAnalysis::getMemoryOffsets(Value *value,
+                                    const std::vector<NDRangePoint> &points) {
+  std::vector<int> offsets;
+  getProgram(value).evaluate(points, offsets);
+  assert(offsets.size() == points.size() && "Wrong number of offsets");
+  return offsets;
 }
 
 //------------------------------------------------------------------------------
-const SCEV *SubscriptAnalysis::replaceInExpr(const SCEVUnknown *expr,
-                                             const NDRangePoint &point,
-                                             SCEVMap &processed) {
-  Value *value = expr->getValue();
-  // Implement actual replacement.
-  if (Instruction *instruction = dyn_cast<Instruction>(value)) {
-
-    // Manage binary operations.
-    if (BinaryOperator *BinOp = dyn_cast<BinaryOperator>(instruction)) {
-      //llvm::errs() << "BinaryOperator: ";
-      //BinOp->dump();
-
-      // Modulo.
-      if (BinOp->getOpcode() == Instruction::URem) {
-        const SCEV *Arg = scalarEvolution->getSCEV(BinOp->getOperand(0));
-        const SCEV *Modulo = scalarEvolution->getSCEV(BinOp->getOperand(1));
-        const SCEV *Result = scalarEvolution->getMinusSCEV(
-            Arg, scalarEvolution->getMulExpr(
-                     scalarEvolution->getUDivExpr(Arg, Modulo), Modulo));
-        return replaceInExpr(Result, point, processed);
-      }
-
-      // Signed division.
-      if (BinOp->getOpcode() == Instruction::SDiv) {
-        const SCEV *First = scalarEvolution->getSCEV(BinOp->getOperand(0));
-        const SCEV *Second = scalarEvolution->getSCEV(BinOp->getOperand(1));
-        const SCEV *Div = scalarEvolution->getUDivExpr(First, Second);
-        return replaceInExpr(Div, point, processed);
-      }
-
-      //llvm::errs() << "Could not compute!\n";
-      // All the rest.
-      return scalarEvolution->getCouldNotCompute();
+// Local memory is made of banks of bankWidth bytes: consecutive words go to
+// consecutive banks. Each bank serves one word per cycle, work items reading
+// the same word get it at once (broadcast). The access takes as many
+// wavefronts as the distinct words of the busiest bank: the conflicts are the
+// wavefronts after the first one.
+// Accesses wider than a bank take more wavefronts, and so do work items
+// whose address is unknown: each of them is assumed to take wavefronts of
+// its own.
+// Bases are assumed to be aligned to a full row of banks.
+int SubscriptAnalysis::computeBankConflictNumber(std::vector<int> &offsets) {
+  assert((int)offsets.size() <= warp.size() && "Wrong number of offsets");
+
+  const DeviceProfile &device = getDeviceProfile();
+  const int bankNumber = std::max(device.bankNumber, 1u);
+  const int bankWidth = getBankWidth();
+  const int width = accessWidth == 0 ? bankWidth : accessWidth;
+  const int wordsPerAccess = (width + bankWidth - 1) / bankWidth;
+
+  std::vector<std::set<int> > bankWords(bankNumber);
+  int unknownNumber = 0;
+  for (std::vector<int>::iterator iter = offsets.begin(),
+                                  iterEnd = offsets.end();
+       iter != iterEnd; ++iter) {
+    if (*iter == OCLEnv::UNKNOWN_MEMORY_LOCATION) {
+      ++unknownNumber;
+      continue;
     }
 
-    // Manage casts.
-    if (IsIntCast(instruction)) {
-      CallInst *Call = dyn_cast<CallInst>(instruction);
-      const SCEV *ArgSCEV = scalarEvolution->getSCEV(Call->getArgOperand(0));
-      return replaceInExpr(ArgSCEV, point, processed);
+    int firstWord = floorDivide(*iter, bankWidth);
+    for (int word = firstWord; word < firstWord + wordsPerAccess; ++word) {
+      int bank = word - floorDivide(word, bankNumber) * bankNumber;
+      bankWords[bank].insert(word);
     }
-
-    // Manage phi nodes.
-    if (PHINode *phi = dyn_cast<PHINode>(value))
-      return replaceInPhi(phi, point, processed);
-
-    return resolveInstruction(instruction, point);
-  }
-
-  // If the value is a function argument query OCL.
-  if (isa<Argument>(value) && value->getType()->isIntegerTy())
-    return scalarEvolution->getConstant(APInt(32, ocl->resolveValue(value)));
-
-  return expr;
-}
-
-//------------------------------------------------------------------------------
-const SCEV *
-SubscriptAnalysis::resolveInstruction(llvm::Instruction *instruction,
-                                      const NDRangePoint &point) {
-  const NDRange *ndr = ocl->getNDRange();
-  const NDRangeSpace &ndrSpace = ocl->getNDRangeSpace();
-  std::string type = ndr->getType(instruction);
-
-  // Check if the instruction is a coordinate querying the NDRangePoint class.
-  if (ndr->isCoordinate(instruction)) {
-    int direction = ndr->getDirection(instruction);
-    int coordinate = point.getCoordinate(type, direction);
-    return scalarEvolution->getConstant(APInt(32, coordinate));
   }
 
-  // Check if the instruction is a size querying the NDRange class.
-  if (ndr->isSize(instruction)) {
-    int direction = ndr->getDirection(instruction);
-    int size = ndrSpace.getSize(type, direction);
-    return scalarEvolution->getConstant(APInt(32, size));
+  int wavefronts = 0;
+  for (std::vector<std::set<int> >::iterator iter = bankWords.begin(),
+                                             iterEnd = bankWords.end();
+       iter != iterEnd; ++iter) {
+    wavefronts = std::max(wavefronts, (int)iter->size());
   }
+  wavefronts += unknownNumber * wordsPerAccess;
 
-  // If the instruction is neither a coordinate nor a size return
-  // CouldNotCompute.
-  return scalarEvolution->getCouldNotCompute();
-}
-
-//------------------------------------------------------------------------------
-const SCEV *SubscriptAnalysis::replaceInExpr(const SCEVUDivExpr *expr,
-                                             const NDRangePoint &point,
-                                             SCEVMap &processed) {
-
-  //  llvm::errs() << "SCEVUDiv: ";
-  //  Expr->dump();
-  const SCEV *newLHS = replaceInExpr(expr->getLHS(), point, processed);
-  if (isa<SCEVCouldNotCompute>(newLHS))
-    return scalarEvolution->getCouldNotCompute();
-  const SCEV *newRHS = replaceInExpr(expr->getRHS(), point, processed);
-  if (isa<SCEVCouldNotCompute>(newRHS))
-    return scalarEvolution->getCouldNotCompute();
-
-  return scalarEvolution->getUDivExpr(newLHS, newRHS);
+  return std::max(wavefronts - 1, 0);
 }
 
 //------------------------------------------------------------------------------
-const SCEV *SubscriptAnalysis::replaceInExpr(const SCEVCastExpr *expr,
-                                             const NDRangePoint &point,
-                                             SCEVMap &processed) {
-  return replaceInExpr(expr->getOperand(), point, processed);
+int SubscriptAnalysis::getBankWidth() const {
+  unsigned int bankWidth =
+      BankWidthCL == 0 ? getDeviceProfile().bankWidth : BankWidthCL;
+  return std::max(bankWidth, 1u);
 }
 
 //------------------------------------------------------------------------------
-const SCEV *SubscriptAnalysis::replaceInPhi(PHINode *Phi,
-                                            const NDRangePoint &point,
-                                            SCEVMap &processed) {
-  //llvm::errs() << "Phi: ";
-  //Phi->dump();
-  // FIXME: Pick the first argument of the phi node.
-  Value *param = Phi->getIncomingValue(0);
-  assert(scalarEvolution->isSCEVable(param->getType()) &&
-         "PhiNode argument non-SCEVable");
-
-  const SCEV *scev = scalarEvolution->getSCEV(param);
-
-  processed[scalarEvolution->getSCEV(Phi)] = scev;
+int SubscriptAnalysis::computeTransactionNumber(std::vector<int> &indices) {
+  assert((int)indices.size() <= warp.size() && "Wrong number of offsets");
 
-  return replaceInExpr(scev, point, processed);
-}
+  // If any of the indices is UNKNOWN_MEMORY_LOCATION do something special.
+  std::vector<int>::iterator unknownMemoryLocationPosition = std::find(
+      indices.begin(), indices.end(), OCLEnv::UNKNOWN_MEMORY_LOCATION);
 
-//------------------------------------------------------------------------------
-std::vector<int>
-SubscriptAnalysis::getMemoryOffsets(std::vector<const SCEV *> scevs,
-                                    const SCEV *unknown) {
-  std::vector<const SCEV *> offsets;
-  for (std::vector<const SCEV *>::const_iterator iter = scevs.begin(),
-                                                 iterEnd = scevs.end();
-       iter != iterEnd; ++iter) {
-    const SCEV *currentSCEV = *iter;
-    offsets.push_back(scalarEvolution->getMinusSCEV(currentSCEV, unknown));
+  if (unknownMemoryLocationPosition != indices.end()) {
+    return indices.size();
   }
 
-  assert(offsets.size() == scevs.size() && "Wrong number of offsets");
-
-  std::vector<int> indices;
-  // This is a std::transform, again.
-  for (std::vector<const SCEV *>::const_iterator iter = offsets.begin(),
-                                                 iterEnd = offsets.end();
-       iter != iterEnd; ++iter) {
-
-    const SCEV *currentSCEV = *iter;
+  // This is the actual computation of the number of transactions. 
+  std::transform(indices.begin(), indices.end(), indices.begin(),
+                 std::bind2nd(std::divides<int>(),
+                              (int)getDeviceProfile().cachelineSize));
 
-    if (const SCEVAddRecExpr *AddRecSCEV =
-            dyn_cast<SCEVAddRecExpr>(currentSCEV)) {
-      currentSCEV = AddRecSCEV->getStart();
-    }
+  std::sort(indices.begin(), indices.end());
+  std::vector<int>::iterator uniqueEnd =
+      std::unique(indices.begin(), indices.end());
 
-    if (const SCEVConstant *ConstSCEV = dyn_cast<SCEVConstant>(currentSCEV)) {
-      const ConstantInt *value = ConstSCEV->getValue();
-      indices.push_back((int)value->getValue().roundToDouble());
-    } else {
-      // The SCEV is not constant. I don't know which element is accessed.
-      indices.push_back(OCLEnv::UNKNOWN_MEMORY_LOCATION);
-    }
-  }
-  
-//  for (std::vector<int>::iterator iter = indices.begin(), iterEnd = indices.end(); iter != iterEnd; ++iter) {
-//    errs() << *iter << "\n";
-//  }
+  int uniqueCacheLines = std::distance(indices.begin(), uniqueEnd);
 
-  assert(indices.size() == scevs.size() && "Wrong number of indices");
-  return indices;
+  return uniqueCacheLines;
 }
 
 //------------------------------------------------------------------------------
@@ -565,3 +412,27 @@ int getTypeWidth(const Type *type) {
   }
   return result / 8;
 }
+
+//------------------------------------------------------------------------------
+int getAccessWidth(const Value *pointer) {
+  const Type *type = pointer->getType();
+  if (!type->isPointerTy())
+    return 0;
+  unsigned int bits = type->getPointerElementType()->getPrimitiveSizeInBits();
+  return (bits + 7) / 8;
+}
+
+//------------------------------------------------------------------------------
+int floorDivide(int dividend, int divisor) {
+  int quotient = dividend / divisor;
+  if (dividend % divisor != 0 && (dividend < 0) != (divisor < 0))
+    --quotient;
+  return quotient;
+}
+
+//------------------------------------------------------------------------------
+int clampToInt(double value) {
+  if (value >= std::numeric_limits<int>::max())
+    return std::numeric_limits<int>::max();
+  return (int)floor(value + 0.5);
+}
@@ -0,0 +1,82 @@
+#include "thrud/Support/ThreadPool.h"
+
+#include "llvm/Support/ErrorHandling.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace llvm;
+
+//------------------------------------------------------------------------------
+ThreadPool::ThreadPool(unsigned int threadNumber)
+    : threadNumber(threadNumber), task(NULL), context(NULL), taskNumber(0),
+      nextTask(0) {
+  if (this->threadNumber == 0)
+    this->threadNumber = getProcessorNumber();
+  pthread_mutex_init(&mutex, NULL);
+}
+
+//------------------------------------------------------------------------------
+ThreadPool::~ThreadPool() { pthread_mutex_destroy(&mutex); }
+
+//------------------------------------------------------------------------------
+void ThreadPool::run(unsigned int taskNumber, Task task, void *context) {
+  this->task = task;
+  this->context = context;
+  this->taskNumber = taskNumber;
+  nextTask = 0;
+
+  // Do not start more threads than tasks, and run on the calling thread if
+  // a single one is needed.
+  unsigned int workerNumber = std::min(threadNumber, taskNumber);
+  if (workerNumber <= 1) {
+    for (unsigned int index = 0; index < taskNumber; ++index)
+      task(context, index, 0);
+    return;
+  }
+
+  std::vector<Worker> workers(workerNumber);
+  std::vector<pthread_t> threads(workerNumber);
+  for (unsigned int index = 0; index < workerNumber; ++index) {
+    workers[index].pool = this;
+    workers[index].thread = index;
+    if (pthread_create(&threads[index], NULL, work, &workers[index]) != 0)
+      report_fatal_error("Cannot create a worker thread");
+  }
+
+  for (unsigned int index = 0; index < workerNumber; ++index)
+    pthread_join(threads[index], NULL);
+}
+
+//------------------------------------------------------------------------------
+unsigned int ThreadPool::getThreadNumber() const { return threadNumber; }
+
+//------------------------------------------------------------------------------
+unsigned int ThreadPool::getProcessorNumber() {
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  return processors < 1 ? 1 : processors;
+}
+
+//------------------------------------------------------------------------------
+void *ThreadPool::work(void *argument) {
+  Worker *worker = (Worker *)argument;
+  ThreadPool *pool = worker->pool;
+
+  unsigned int task;
+  while (pool->getNextTask(task))
+    pool->task(pool->context, task, worker->thread);
+
+  return NULL;
+}
+
+//------------------------------------------------------------------------------
+bool ThreadPool::getNextTask(unsigned int &task) {
+  pthread_mutex_lock(&mutex);
+  bool available = nextTask < taskNumber;
+  if (available)
+    task = nextTask++;
+  pthread_mutex_unlock(&mutex);
+  return available;
+}
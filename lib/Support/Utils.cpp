@@ -2,6 +2,7 @@
 
 #include "thrud/Support/DivergentRegion.h"
 #include "thrud/Support/RegionBounds.h"
+#include "thrud/Support/DeviceProfile.h"
 #include "thrud/Support/OCLEnv.h"
 
 #include "llvm/ADT/STLExtras.h"
@@ -11,6 +12,7 @@
 #include "llvm/Analysis/PostDominators.h"
 
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Metadata.h"
@@ -27,6 +29,11 @@
 // OpenCL function names.
 const char *BARRIER = "barrier";
 
+// Metadata listing the kernels already transformed by thread coarsening.
+const char *COARSENED_MD = "thrud.coarsened";
+// Metadata with the coarsening factor, stride and direction of the kernels.
+const char *COARSENING_CONFIGURATION_MD = "thrud.coarsening";
+
 //------------------------------------------------------------------------------
 bool isInLoop(const Instruction &inst, LoopInfo *loopInfo) {
   const BasicBlock *block = inst.getParent();
@@ -44,24 +51,122 @@ bool isInLoop(const BasicBlock *block, LoopInfo *loopInfo) {
 }
 
 //------------------------------------------------------------------------------
-bool isKernel(const Function *function) {
+bool isInNamedMetadata(const Function *function, const char *name) {
   const Module *module = function->getParent();
-  const llvm::NamedMDNode *kernelsMD =
-      module->getNamedMetadata("opencl.kernels");
+  const llvm::NamedMDNode *namedMD = module->getNamedMetadata(name);
 
-  if (!kernelsMD)
+  if (!namedMD)
     return false;
 
-  for (int index = 0, end = kernelsMD->getNumOperands(); index != end;
+  for (int index = 0, end = namedMD->getNumOperands(); index != end;
        ++index) {
-    const llvm::MDNode &kernelMD = *kernelsMD->getOperand(index);
-    if (kernelMD.getOperand(0) == function)
+    const llvm::MDNode &functionMD = *namedMD->getOperand(index);
+    if (functionMD.getOperand(0) == function)
       return true;
   }
 
   return false;
 }
 
+//------------------------------------------------------------------------------
+bool isKernel(const Function *function) {
+  return isInNamedMetadata(function, "opencl.kernels");
+}
+
+//------------------------------------------------------------------------------
+bool isCoarsened(const Function *function) {
+  return isInNamedMetadata(function, COARSENED_MD);
+}
+
+//------------------------------------------------------------------------------
+void markAsCoarsened(Function *function) {
+  if (isCoarsened(function))
+    return;
+
+  Module *module = function->getParent();
+  NamedMDNode *coarsenedMD = module->getOrInsertNamedMetadata(COARSENED_MD);
+  Value *operands[] = { function };
+  coarsenedMD->addOperand(MDNode::get(function->getContext(), operands));
+}
+
+//------------------------------------------------------------------------------
+void setCoarseningConfiguration(Function *function, unsigned int factor,
+                                unsigned int stride, unsigned int direction) {
+  Module *module = function->getParent();
+  NamedMDNode *configurationMD =
+      module->getOrInsertNamedMetadata(COARSENING_CONFIGURATION_MD);
+  Type *intType = Type::getInt32Ty(function->getContext());
+  Value *operands[] = { function, ConstantInt::get(intType, factor),
+                        ConstantInt::get(intType, stride),
+                        ConstantInt::get(intType, direction) };
+  configurationMD->addOperand(MDNode::get(function->getContext(), operands));
+}
+
+//------------------------------------------------------------------------------
+// Named metadata operands cannot be replaced: the last configuration recorded
+// for the function is the current one.
+void getCoarseningConfiguration(const Function *function,
+                                unsigned int &factor, unsigned int &stride,
+                                unsigned int &direction) {
+  const Module *module = function->getParent();
+  const NamedMDNode *configurationMD =
+      module->getNamedMetadata(COARSENING_CONFIGURATION_MD);
+  if (configurationMD == NULL)
+    return;
+
+  for (unsigned int index = configurationMD->getNumOperands(); index > 0;
+       --index) {
+    const MDNode *node = configurationMD->getOperand(index - 1);
+    if (node->getOperand(0) != function)
+      continue;
+
+    factor = cast<ConstantInt>(node->getOperand(1))->getZExtValue();
+    stride = cast<ConstantInt>(node->getOperand(2))->getZExtValue();
+    direction = cast<ConstantInt>(node->getOperand(3))->getZExtValue();
+    return;
+  }
+}
+
+//------------------------------------------------------------------------------
+Type *getDataType(const Instruction *inst) {
+  Type *type = inst->getType();
+  if (const StoreInst *store = dyn_cast<StoreInst>(inst))
+    type = store->getValueOperand()->getType();
+  else if (const CmpInst *cmp = dyn_cast<CmpInst>(inst))
+    type = cmp->getOperand(0)->getType();
+
+  return type->getScalarType();
+}
+
+//------------------------------------------------------------------------------
+std::string getScalarTypeName(const Type *type) {
+  if (type->isHalfTy())
+    return "f16";
+  if (type->isFloatTy())
+    return "f32";
+  if (type->isDoubleTy())
+    return "f64";
+
+  if (type->isIntegerTy(8))
+    return "i8";
+  if (type->isIntegerTy(16))
+    return "i16";
+  if (type->isIntegerTy(32))
+    return "i32";
+  if (type->isIntegerTy(64))
+    return "i64";
+
+  return "";
+}
+
+//------------------------------------------------------------------------------
+unsigned int getRegisterBytes(const Type *type) {
+  if (type->isPointerTy())
+    return 8;
+  unsigned int bits = type->getPrimitiveSizeInBits();
+  return bits < 8 ? 1 : bits / 8;
+}
+
 //------------------------------------------------------------------------------
 void applyMapToPhiBlocks(PHINode *Phi, Map &map) {
   // FIXME:
@@ -507,7 +612,8 @@ bool isLocalMemoryAccess(Instruction *I) {
 //------------------------------------------------------------------------------
 bool isLocalMemoryStore(Instruction *I) {
   if (StoreInst *S = dyn_cast<StoreInst>(I)) {
-    return (S->getPointerAddressSpace() == OCLEnv::LOCAL_AS);
+    return (S->getPointerAddressSpace() ==
+            getDeviceProfile().localAddressSpace);
   }
   return false;
 }
@@ -515,11 +621,75 @@ bool isLocalMemoryStore(Instruction *I) {
 //------------------------------------------------------------------------------
 bool isLocalMemoryLoad(Instruction *I) {
   if (LoadInst *L = dyn_cast<LoadInst>(I)) {
-    return (L->getPointerAddressSpace() == OCLEnv::LOCAL_AS);
+    return (L->getPointerAddressSpace() ==
+            getDeviceProfile().localAddressSpace);
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+Value *getMemoryPointer(Instruction *inst) {
+  if (LoadInst *load = dyn_cast<LoadInst>(inst))
+    return load->getPointerOperand();
+  return cast<StoreInst>(inst)->getPointerOperand();
+}
+
+//------------------------------------------------------------------------------
+// Check if the value is used by an instruction of the function, directly or
+// through constant expressions.
+static bool isUsedIn(const Value *value, const Function *function) {
+  for (Value::const_use_iterator iter = value->use_begin(),
+                                 iterEnd = value->use_end();
+       iter != iterEnd; ++iter) {
+    const User *user = *iter;
+    if (const Instruction *inst = dyn_cast<Instruction>(user)) {
+      if (inst->getParent()->getParent() == function)
+        return true;
+    } else if (isa<Constant>(user) && isUsedIn(user, function)) {
+      return true;
+    }
   }
   return false;
 }
 
+//------------------------------------------------------------------------------
+unsigned int getLocalMemorySize(const Function *function,
+                                unsigned int &unboundArgs) {
+  const Module *module = function->getParent();
+  DataLayout dataLayout(module);
+  unsigned int localAddressSpace = getDeviceProfile().localAddressSpace;
+
+  unsigned int size = 0;
+  for (Module::const_global_iterator iter = module->global_begin(),
+                                     iterEnd = module->global_end();
+       iter != iterEnd; ++iter) {
+    const GlobalVariable *variable = iter;
+    if (variable->getType()->getAddressSpace() != localAddressSpace)
+      continue;
+    if (isUsedIn(variable, function)) {
+      Type *type = variable->getType()->getElementType();
+      size += dataLayout.getTypeAllocSize(type);
+    }
+  }
+
+  const OCLEnv::ArgumentSet &arguments = OCLEnv::getArgumentSets().front();
+  unboundArgs = 0;
+  for (Function::const_arg_iterator iter = function->arg_begin(),
+                                    iterEnd = function->arg_end();
+       iter != iterEnd; ++iter) {
+    PointerType *type = dyn_cast<PointerType>(iter->getType());
+    if (type == NULL || type->getAddressSpace() != localAddressSpace)
+      continue;
+
+    int bytes = 0;
+    if (OCLEnv::getBinding(arguments, iter, bytes) && bytes >= 0)
+      size += bytes;
+    else
+      ++unboundArgs;
+  }
+  return size;
+}
+
 //------------------------------------------------------------------------------
 bool isMathFunction(Instruction *I) {
   if (CallInst *Inst = dyn_cast<CallInst>(I)) {
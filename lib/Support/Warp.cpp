@@ -1,11 +1,16 @@
 #include "thrud/Support/Warp.h"
 
-#include "thrud/Support/OCLEnv.h"
+#include "thrud/Support/DeviceProfile.h"
 
 Warp::Warp(int groupX, int groupY, int groupZ, int warpIndex,
-           const NDRangeSpace &ndrSpace) {
+           const NDRangeSpace &ndrSpace)
+    : warpIndex(warpIndex) {
+  group[0] = groupX;
+  group[1] = groupY;
+  group[2] = groupZ;
 
-  points.reserve(OCLEnv::WARP_SIZE);
+  int warpSize = getDeviceProfile().warpSize;
+  points.reserve(warpSize);
 
 //  int numberOfGroupsX = ndrSpace.getNumberOfGroupsX();
 //  int numberOfGroupsY = ndrSpace.getNumberOfGroupsY();
@@ -13,17 +18,20 @@ Warp::Warp(int groupX, int groupY, int groupZ, int warpIndex,
   int localSizeY = ndrSpace.getLocalSizeY();
   int localSizeZ = ndrSpace.getLocalSizeZ();
   int localArea = localSizeX * localSizeY;
-//  int localVolume = localArea * localSizeZ;
+  int localVolume = localArea * localSizeZ;
 
   // Compute global_id of first thread in the work group.
 //  int firstThreadInGroup =
 //      groupZ * numberOfGroupsX * numberOfGroupsY * localVolume +
 //      groupY * numberOfGroupsX * localArea + groupX * localSizeX;
 
-  int firstThreadLocalPosition = warpIndex * OCLEnv::WARP_SIZE;
+  int firstThreadLocalPosition = warpIndex * warpSize;
 
-  for (int index = 0; index < OCLEnv::WARP_SIZE; ++index) {
+  for (int index = 0; index < warpSize; ++index) {
     int threadPosition = firstThreadLocalPosition + index;
+    // Partial warp at the end of the group.
+    if (threadPosition >= localVolume)
+      break;
 
     // Compute local coordinates of the first warp in the
     int localZ = threadPosition / localArea;
@@ -40,6 +48,19 @@ Warp::Warp(int groupX, int groupY, int groupZ, int warpIndex,
   }
 }
 
+int Warp::size() const { return points.size(); }
+
+const std::vector<NDRangePoint> &Warp::getPoints() const { return points; }
+
+int Warp::getGroup(int direction) const { return group[direction]; }
+
+int Warp::getWarpIndex() const { return warpIndex; }
+
+int Warp::getWarpsPerGroup(const NDRangeSpace &ndrSpace) {
+  int warpSize = getDeviceProfile().warpSize;
+  return (ndrSpace.getGroupSize() + warpSize - 1) / warpSize;
+}
+
 Warp::iterator Warp::begin() {
   return Warp::iterator(this);
 }
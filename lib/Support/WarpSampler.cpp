@@ -0,0 +1,134 @@
+#include "thrud/Support/WarpSampler.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+//------------------------------------------------------------------------------
+WarpSampler::WarpSampler(const NDRangeSpace &ndrSpace)
+    : ndrSpace(ndrSpace), warpsPerGroup(Warp::getWarpsPerGroup(ndrSpace)) {}
+
+//------------------------------------------------------------------------------
+uint64_t WarpSampler::getGroupNumber() const {
+  return (uint64_t)ndrSpace.getNumberOfGroupsX() *
+         ndrSpace.getNumberOfGroupsY() * ndrSpace.getNumberOfGroupsZ();
+}
+
+//------------------------------------------------------------------------------
+uint64_t WarpSampler::getWarpNumber() const {
+  return getGroupNumber() * warpsPerGroup;
+}
+
+//------------------------------------------------------------------------------
+std::vector<Warp> WarpSampler::getFirst() const {
+  return std::vector<Warp>(1, getWarp(0, 0));
+}
+
+//------------------------------------------------------------------------------
+std::vector<Warp> WarpSampler::getAll(unsigned int maxWarps) const {
+  if (getWarpNumber() > maxWarps) {
+    errs() << "The NDRange has " << getWarpNumber() << " warps, sampling "
+           << maxWarps << " of them\n";
+    return getStratified(maxWarps);
+  }
+
+  std::vector<Warp> warps;
+  warps.reserve(getWarpNumber());
+  for (uint64_t groupIndex = 0, groupEnd = getGroupNumber();
+       groupIndex < groupEnd; ++groupIndex) {
+    for (int warpIndex = 0; warpIndex < warpsPerGroup; ++warpIndex) {
+      warps.push_back(getWarp(groupIndex, warpIndex));
+    }
+  }
+  return warps;
+}
+
+//------------------------------------------------------------------------------
+std::vector<Warp> WarpSampler::getStratified(unsigned int samples) const {
+  samples = std::max(samples, 1u);
+
+  // Strata: the warp indices within a group. Each stratum gets the same
+  // number of groups.
+  unsigned int indexNumber =
+      std::min(samples, static_cast<unsigned int>(warpsPerGroup));
+  uint64_t groupSamples = std::min<uint64_t>(
+      std::max(samples / indexNumber, 1u), getGroupNumber());
+  uint64_t lastGroup = getGroupNumber() - 1;
+
+  std::vector<Warp> warps;
+  warps.reserve(indexNumber * groupSamples);
+  for (unsigned int index = 0; index < indexNumber; ++index) {
+    int warpIndex = indexNumber == 1
+                        ? 0
+                        : index * (warpsPerGroup - 1) / (indexNumber - 1);
+    for (uint64_t sample = 0; sample < groupSamples; ++sample) {
+      uint64_t groupIndex =
+          groupSamples == 1 ? 0 : sample * lastGroup / (groupSamples - 1);
+      warps.push_back(getWarp(groupIndex, warpIndex));
+    }
+  }
+  return warps;
+}
+
+//------------------------------------------------------------------------------
+bool WarpSampler::getListed(const std::string &list, std::vector<Warp> &warps,
+                            std::string &error) const {
+  SmallVector<StringRef, 16> entries;
+  StringRef(list).split(entries, ";", -1, false);
+
+  for (SmallVector<StringRef, 16>::iterator iter = entries.begin(),
+                                            iterEnd = entries.end();
+       iter != iterEnd; ++iter) {
+    SmallVector<StringRef, 4> fields;
+    iter->trim().split(fields, ",");
+
+    int coordinates[4];
+    bool malformed = fields.size() != 4;
+    for (unsigned int index = 0; !malformed && index < 4; ++index) {
+      malformed = fields[index].trim().getAsInteger(10, coordinates[index]);
+    }
+
+    if (malformed) {
+      error = "malformed warp \"" + iter->str() + "\", expected gx,gy,gz,w";
+      return false;
+    }
+
+    if (coordinates[0] < 0 ||
+        coordinates[0] >= ndrSpace.getNumberOfGroupsX() ||
+        coordinates[1] < 0 ||
+        coordinates[1] >= ndrSpace.getNumberOfGroupsY() ||
+        coordinates[2] < 0 ||
+        coordinates[2] >= ndrSpace.getNumberOfGroupsZ() ||
+        coordinates[3] < 0 || coordinates[3] >= warpsPerGroup) {
+      error = "warp \"" + iter->str() + "\" is outside of the NDRange";
+      return false;
+    }
+
+    warps.push_back(Warp(coordinates[0], coordinates[1], coordinates[2],
+                         coordinates[3], ndrSpace));
+  }
+
+  if (warps.empty()) {
+    error = "empty warp list";
+    return false;
+  }
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+Warp WarpSampler::getWarp(uint64_t groupIndex, int warpIndex) const {
+  uint64_t groupsX = ndrSpace.getNumberOfGroupsX();
+  uint64_t groupsY = ndrSpace.getNumberOfGroupsY();
+
+  int groupX = groupIndex % groupsX;
+  int groupY = (groupIndex / groupsX) % groupsY;
+  int groupZ = groupIndex / (groupsX * groupsY);
+
+  return Warp(groupX, groupY, groupZ, warpIndex, ndrSpace);
+}
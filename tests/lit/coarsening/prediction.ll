@@ -0,0 +1,52 @@
+; RUN: %opt -coarsening-prediction -coarsening-model %S/Inputs/tree.yaml -S < %s | FileCheck %s
+; RUN: %opt -coarsening-prediction -coarsening-model %S/Inputs/mlp.yaml -S < %s | FileCheck %s
+
+; Each kernel gets its own configuration: the small one is not coarsened, the
+; large one is coarsened by 4 along y.
+
+; CHECK: !thrud.coarsening = !{![[SMALL:[0-9]+]], ![[LARGE:[0-9]+]]}
+; CHECK-DAG: ![[SMALL]] = metadata !{void (float addrspace(1)*)* @small, i32 1, i32 1, i32 0}
+; CHECK-DAG: ![[LARGE]] = metadata !{void (float addrspace(1)*)* @large, i32 4, i32 2, i32 1}
+
+; Malformed models are rejected.
+; RUN: not %opt -coarsening-prediction -coarsening-model %S/Inputs/bad-tree.yaml -disable-output < %s 2>&1 | FileCheck %s --check-prefix=BAD-TREE
+; RUN: not %opt -coarsening-prediction -coarsening-model %S/Inputs/bad-layer.yaml -disable-output < %s 2>&1 | FileCheck %s --check-prefix=BAD-LAYER
+; RUN: not %opt -coarsening-prediction -coarsening-model %S/Inputs/bad-feature.yaml -disable-output < %s 2>&1 | FileCheck %s --check-prefix=BAD-FEATURE
+; RUN: not %opt -coarsening-prediction -coarsening-model %S/Inputs/missing.yaml -disable-output < %s 2>&1 | FileCheck %s --check-prefix=MISSING
+
+; BAD-TREE: Invalid coarsening model: {{.*}}bad-tree.yaml: invalid node 0 of tree 0
+; BAD-LAYER: Invalid coarsening model: {{.*}}bad-layer.yaml: invalid layer 0
+; BAD-FEATURE: Invalid coarsening model: {{.*}}bad-feature.yaml: unknown feature instructions
+; MISSING: Invalid coarsening model: cannot read
+
+; 4 instructions.
+define void @small(float addrspace(1)* %out) {
+entry:
+  %gid = call i64 @get_global_id(i32 0)
+  %p = getelementptr inbounds float addrspace(1)* %out, i64 %gid
+  store float 1.000000e+00, float addrspace(1)* %p, align 4
+  ret void
+}
+
+; 12 instructions.
+define void @large(float addrspace(1)* %out) {
+entry:
+  %gid = call i64 @get_global_id(i32 0)
+  %p = getelementptr inbounds float addrspace(1)* %out, i64 %gid
+  %x = load float addrspace(1)* %p, align 4
+  %a = fmul float %x, %x
+  %b = fadd float %a, %x
+  %c = fmul float %b, %a
+  %d = fadd float %c, %b
+  %e = fmul float %d, %c
+  %f = fadd float %e, %d
+  %g = fmul float %f, %e
+  store float %g, float addrspace(1)* %p, align 4
+  ret void
+}
+
+declare i64 @get_global_id(i32)
+
+!opencl.kernels = !{!0, !1}
+!0 = metadata !{void (float addrspace(1)*)* @small}
+!1 = metadata !{void (float addrspace(1)*)* @large}
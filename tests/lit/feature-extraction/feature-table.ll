@@ -0,0 +1,46 @@
+; Appending to the same tables twice writes the column names once and checks
+; them before the second append.
+; RUN: rm -f %t.csv %t.columns
+; RUN: %opt -opencl-instcount -count-kernel-name table -feature-table %t.csv -feature-columns %t.columns -feature-configuration first -disable-output < %s
+; RUN: %opt -opencl-instcount -count-kernel-name table -feature-table %t.csv -feature-columns %t.columns -feature-configuration second -disable-output < %s
+; RUN: FileCheck %s < %t.csv
+
+; CHECK: {{^}}module,kernel,configuration,
+; CHECK-NEXT: {{^}}<stdin>,table,first,
+; CHECK-NEXT: {{^}}<stdin>,table,second,
+; CHECK-NOT: module
+
+; -feature-module replaces the module identifier in the rows.
+; RUN: rm -f %t.module.csv
+; RUN: %opt -opencl-instcount -count-kernel-name table -feature-table %t.module.csv -feature-module kernels/table.cl -disable-output < %s
+; RUN: FileCheck %s --check-prefix=MODULE < %t.module.csv
+
+; MODULE: {{^}}kernels/table.cl,table,,
+
+; Tables with other columns are not appended to.
+; RUN: echo "module,kernel,configuration,other" > %t.other.csv
+; RUN: not %opt -opencl-instcount -count-kernel-name table -feature-table %t.other.csv -disable-output < %s 2>&1 | FileCheck %s --check-prefix=OTHER
+
+; A table with the single column "other" and no row groups.
+; RUN: printf 'THRUDTBL\002\000\000\000\001\000\000\000\005\000\000\000other' > %t.other.columns
+; RUN: not %opt -opencl-instcount -count-kernel-name table -feature-columns %t.other.columns -disable-output < %s 2>&1 | FileCheck %s --check-prefix=OTHER
+
+; OTHER: the columns of the file differ from the ones of the table
+
+; RUN: echo "module,kernel" > %t.bad.columns
+; RUN: not %opt -opencl-instcount -count-kernel-name table -feature-columns %t.bad.columns -disable-output < %s 2>&1 | FileCheck %s --check-prefix=BAD
+
+; BAD: the file is not a feature table
+
+define void @table(float addrspace(1)* %out) {
+entry:
+  %gid = call i64 @get_global_id(i32 0)
+  %p = getelementptr inbounds float addrspace(1)* %out, i64 %gid
+  store float 1.000000e+00, float addrspace(1)* %p, align 4
+  ret void
+}
+
+declare i64 @get_global_id(i32)
+
+!opencl.kernels = !{!0}
+!0 = metadata !{void (float addrspace(1)*)* @table}
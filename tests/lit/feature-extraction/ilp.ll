@@ -0,0 +1,47 @@
+; RUN: %opt -opencl-instcount -count-kernel-name ilp -disable-output < %s | FileCheck %s
+; RUN: %opt -opencl-instcount -count-kernel-name ilp -ilp-latency -disable-output < %s | FileCheck %s --check-prefix=LATENCY
+
+; Without -ilp-latency the ILP of each block is its instructions over its
+; longest dependency chain, as computed on the dense dependency graph:
+; - entry: 6 instructions, chain gid -> p -> x -> y -> z.
+; - loop: 9 instructions, chain acc -> a -> c -> acc.next. The phis do not
+;   depend on their incoming values, which come from the previous iteration.
+; - exit: 3 instructions, chain out.ptr -> store.
+
+; CHECK: ilpPerBlock:{{ +}}[ 1.2, 2.25, 1.5 ]
+
+; With -ilp-latency the global memory accesses dominate entry and exit, the
+; loop is 19 cycles over a chain of 12.
+
+; LATENCY: ilpPerBlock:{{ +}}[ 1.00235, 1.58333, 1.00249 ]
+
+define void @ilp(float addrspace(1)* %in, float addrspace(1)* %out) {
+entry:
+  %gid = call i64 @get_global_id(i32 0)
+  %p = getelementptr inbounds float addrspace(1)* %in, i64 %gid
+  %x = load float addrspace(1)* %p, align 4
+  %y = fmul float %x, %x
+  %z = fadd float %y, %x
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi float [ %z, %entry ], [ %acc.next, %loop ]
+  %a = fadd float %acc, 1.000000e+00
+  %b = fmul float %acc, 2.000000e+00
+  %c = fadd float %a, %b
+  %acc.next = fadd float %c, %acc
+  %i.next = add i32 %i, 1
+  %cond = icmp slt i32 %i.next, 10
+  br i1 %cond, label %loop, label %exit
+
+exit:
+  %out.ptr = getelementptr inbounds float addrspace(1)* %out, i64 %gid
+  store float %acc.next, float addrspace(1)* %out.ptr, align 4
+  ret void
+}
+
+declare i64 @get_global_id(i32)
+
+!opencl.kernels = !{!0}
+!0 = metadata !{void (float addrspace(1)*, float addrspace(1)*)* @ilp}
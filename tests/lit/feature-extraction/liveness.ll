@@ -0,0 +1,42 @@
+; RUN: %opt -opencl-instcount -count-kernel-name live -disable-output < %s | FileCheck %s
+
+; Live values at the boundaries of entry, loop and exit:
+; - exit uses out, gid and acc.next.
+; - loop uses x and n. The phis take i.next and acc.next on the back edge and
+;   x on the edge from entry: those uses are live out of the predecessor,
+;   not live in the loop.
+; - x and n are live out of loop only through the back edge, once the
+;   fixed point is reached.
+; - entry has the arguments out and n live in.
+
+; CHECK: liveIn:{{ +}}[ 2, 4, 3 ]
+; CHECK: liveOut:{{ +}}[ 4, 6, 0 ]
+; CHECK: liveInScalarFloat:{{ +}}[ 0, 1, 1 ]
+; CHECK: liveInScalarInt:{{ +}}[ 2, 3, 2 ]
+; CHECK: liveOutScalarFloat:{{ +}}[ 1, 2, 0 ]
+; CHECK: liveOutScalarInt:{{ +}}[ 3, 4, 0 ]
+
+define void @live(float addrspace(1)* %out, i32 %n) {
+entry:
+  %gid = call i64 @get_global_id(i32 0)
+  %x = sitofp i64 %gid to float
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi float [ %x, %entry ], [ %acc.next, %loop ]
+  %acc.next = fmul float %acc, %x
+  %i.next = add i32 %i, 1
+  %cond = icmp slt i32 %i.next, %n
+  br i1 %cond, label %loop, label %exit
+
+exit:
+  %p = getelementptr inbounds float addrspace(1)* %out, i64 %gid
+  store float %acc.next, float addrspace(1)* %p, align 4
+  ret void
+}
+
+declare i64 @get_global_id(i32)
+
+!opencl.kernels = !{!0}
+!0 = metadata !{void (float addrspace(1)*, i32)* @live}
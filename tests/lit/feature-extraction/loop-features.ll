@@ -0,0 +1,52 @@
+; RUN: %opt -opencl-loop-instcount -count-loop-kernel-name loop -disable-output < %s | FileCheck %s
+
+; The loop extractor counts only the blocks in loops: the dynamic counts are
+; the 11 instructions of the loop times its trip count (the backedge-taken
+; count, 15), without entry and exit.
+;
+; The issue cost of the loop on the default profile: 4 cycles for each of the
+; fmul and the extractelement on <4 x float>, 8 for sqrt, 1 for gep, fadd,
+; add, icmp and br, nothing for phis and loads.
+
+; CHECK: computeCycles:{{ +}}21
+; CHECK: globalLoads:{{ +}}1
+; CHECK: globalStores:{{ +}}0
+; CHECK: vector4:{{ +}}2
+; CHECK: dynamicComputeCycles:{{ +}}315
+; CHECK: dynamicInsts:{{ +}}165
+; CHECK: typedInsts:
+; CHECK: Call.sqrt.f32:{{ +}}1
+; CHECK: ExtractElement.f32:{{ +}}1
+; CHECK: FMul.v4f32:{{ +}}1
+; CHECK: Load.global.v4f32:{{ +}}1
+; CHECK-NOT: Store.global
+
+define void @loop(<4 x float> addrspace(1)* %in, float addrspace(1)* %out) {
+entry:
+  %gid = call i64 @get_global_id(i32 0)
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi float [ 0.000000e+00, %entry ], [ %acc.next, %loop ]
+  %v.ptr = getelementptr inbounds <4 x float> addrspace(1)* %in, i64 %gid
+  %v = load <4 x float> addrspace(1)* %v.ptr, align 16
+  %w = fmul <4 x float> %v, %v
+  %e = extractelement <4 x float> %w, i32 0
+  %s = call float @_Z4sqrtf(float %e)
+  %acc.next = fadd float %acc, %s
+  %i.next = add i32 %i, 1
+  %cond = icmp eq i32 %i.next, 16
+  br i1 %cond, label %exit, label %loop
+
+exit:
+  %out.ptr = getelementptr inbounds float addrspace(1)* %out, i64 %gid
+  store float %acc.next, float addrspace(1)* %out.ptr, align 4
+  ret void
+}
+
+declare i64 @get_global_id(i32)
+declare float @_Z4sqrtf(float)
+
+!opencl.kernels = !{!0}
+!0 = metadata !{void (<4 x float> addrspace(1)*, float addrspace(1)*)* @loop}
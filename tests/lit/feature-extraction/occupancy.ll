@@ -0,0 +1,43 @@
+; RUN: %opt -occupancy -occupancy-kernel-name occupancy -occupancy-factors 1 -disable-output < %s | FileCheck %s --check-prefix=WARPS
+; RUN: %opt -occupancy -occupancy-kernel-name occupancy -occupancy-factors 1 -localSizeX 32 -disable-output < %s | FileCheck %s --check-prefix=GROUPS
+; RUN: %opt -occupancy -occupancy-kernel-name occupancy -occupancy-factors 1 -kernel-args tile=16384 -disable-output < %s | FileCheck %s --check-prefix=LOCAL
+
+; The default profile holds 64 warps and 16 groups per compute unit, with
+; 48KB of local memory.
+; - Groups of 128 work items have 4 warps: 16 groups fill the warps first.
+; - Groups of 32 work items have 1 warp: the group limit comes first.
+; - With the tile bound to 16KB only 3 groups fit in the local memory.
+; Without a binding the size of the tile is unknown and not counted.
+
+; WARPS: local_bytes:{{ +}}0
+; WARPS: unbound_local_args:{{ +}}1
+; WARPS: resident_groups:{{ +}}16
+; WARPS: occupancy:{{ +}}1
+; WARPS: limiter:{{ +}}warps
+
+; GROUPS: resident_groups:{{ +}}16
+; GROUPS: occupancy:{{ +}}0.25
+; GROUPS: limiter:{{ +}}groups
+
+; LOCAL: local_bytes:{{ +}}16384
+; LOCAL: unbound_local_args:{{ +}}0
+; LOCAL: resident_groups:{{ +}}3
+; LOCAL: occupancy:{{ +}}0.1875
+; LOCAL: limiter:{{ +}}local-memory
+
+define void @occupancy(float addrspace(1)* %out, float addrspace(3)* %tile) {
+entry:
+  %lid = call i64 @get_local_id(i32 0)
+  %gid = call i64 @get_global_id(i32 0)
+  %t.ptr = getelementptr inbounds float addrspace(3)* %tile, i64 %lid
+  %t = load float addrspace(3)* %t.ptr, align 4
+  %out.ptr = getelementptr inbounds float addrspace(1)* %out, i64 %gid
+  store float %t, float addrspace(1)* %out.ptr, align 4
+  ret void
+}
+
+declare i64 @get_local_id(i32)
+declare i64 @get_global_id(i32)
+
+!opencl.kernels = !{!0}
+!0 = metadata !{void (float addrspace(1)*, float addrspace(3)*)* @occupancy}
@@ -0,0 +1,49 @@
+; RUN: %opt -symbolic-execution -symbolic-kernel-name bank -disable-output < %s | FileCheck %s
+; RUN: %opt -symbolic-execution -symbolic-kernel-name bank -symbolic-bank-width 8 -disable-output < %s | FileCheck %s --check-prefix=WIDE
+
+; Bank conflicts of the first warp on 32 banks:
+;
+;   float a = l[0];         // broadcast
+;   float b = l[lid];       // one word per bank
+;   float c = l[lid * 32];  // 32 words in bank 0
+;   float d = l[lid / 2];   // pairs of work items share a word
+;   float e = l[lid * 2];   // two words in each even bank
+;
+; With 8-byte banks two floats share a word and l[lid * 32] spreads over
+; banks 0 and 16.
+
+; CHECK: kernel:{{ +}}bank
+; CHECK: load_bank_conflicts:{{ +}}[ 0, 0, 31, 0, 1 ]
+
+; WIDE: load_bank_conflicts:{{ +}}[ 0, 0, 15, 0, 0 ]
+
+define void @bank(float addrspace(3)* %l, float addrspace(1)* %out) {
+entry:
+  %lid = call i64 @get_local_id(i32 0)
+  %gid = call i64 @get_global_id(i32 0)
+  %a = load float addrspace(3)* %l, align 4
+  %b.ptr = getelementptr inbounds float addrspace(3)* %l, i64 %lid
+  %b = load float addrspace(3)* %b.ptr, align 4
+  %c.index = mul i64 %lid, 32
+  %c.ptr = getelementptr inbounds float addrspace(3)* %l, i64 %c.index
+  %c = load float addrspace(3)* %c.ptr, align 4
+  %d.index = udiv i64 %lid, 2
+  %d.ptr = getelementptr inbounds float addrspace(3)* %l, i64 %d.index
+  %d = load float addrspace(3)* %d.ptr, align 4
+  %e.index = mul i64 %lid, 2
+  %e.ptr = getelementptr inbounds float addrspace(3)* %l, i64 %e.index
+  %e = load float addrspace(3)* %e.ptr, align 4
+  %ab = fadd float %a, %b
+  %cd = fadd float %c, %d
+  %abcd = fadd float %ab, %cd
+  %sum = fadd float %abcd, %e
+  %out.ptr = getelementptr inbounds float addrspace(1)* %out, i64 %gid
+  store float %sum, float addrspace(1)* %out.ptr, align 4
+  ret void
+}
+
+declare i64 @get_local_id(i32)
+declare i64 @get_global_id(i32)
+
+!opencl.kernels = !{!0}
+!0 = metadata !{void (float addrspace(3)*, float addrspace(1)*)* @bank}
@@ -0,0 +1,42 @@
+; RUN: %opt -symbolic-execution -symbolic-all-kernels -kernel-args n=64 -disable-output < %s | FileCheck %s
+; RUN: not %opt -symbolic-execution -symbolic-all-kernels -kernel-args size=64 -disable-output < %s 2>&1 | FileCheck %s --check-prefix=TYPO
+
+; Bindings are checked against all the kernels of the module: n binds the
+; argument of @bounded and leaves @unbounded alone, a name no kernel has is
+; an error.
+
+; CHECK: kernel:{{ +}}bounded
+; CHECK: kernel_arguments:{{ +}}n=64
+; CHECK: kernel:{{ +}}unbounded
+; CHECK: kernel_arguments:{{ +}}n=64
+
+; TYPO: Kernel argument "size" does not match any integer or local pointer argument of the kernels
+
+define void @bounded(float addrspace(1)* %in, float addrspace(1)* %out,
+                     i32 %n) {
+entry:
+  %gid = call i64 @get_global_id(i32 0)
+  %n.ext = sext i32 %n to i64
+  %index = add i64 %gid, %n.ext
+  %in.ptr = getelementptr inbounds float addrspace(1)* %in, i64 %index
+  %value = load float addrspace(1)* %in.ptr, align 4
+  %out.ptr = getelementptr inbounds float addrspace(1)* %out, i64 %gid
+  store float %value, float addrspace(1)* %out.ptr, align 4
+  ret void
+}
+
+define void @unbounded(float addrspace(1)* %in, float addrspace(1)* %out) {
+entry:
+  %gid = call i64 @get_global_id(i32 0)
+  %in.ptr = getelementptr inbounds float addrspace(1)* %in, i64 %gid
+  %value = load float addrspace(1)* %in.ptr, align 4
+  %out.ptr = getelementptr inbounds float addrspace(1)* %out, i64 %gid
+  store float %value, float addrspace(1)* %out.ptr, align 4
+  ret void
+}
+
+declare i64 @get_global_id(i32)
+
+!opencl.kernels = !{!0, !1}
+!0 = metadata !{void (float addrspace(1)*, float addrspace(1)*, i32)* @bounded}
+!1 = metadata !{void (float addrspace(1)*, float addrspace(1)*)* @unbounded}
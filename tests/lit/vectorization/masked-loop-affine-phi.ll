@@ -0,0 +1,49 @@
+; RUN: %opt -tv -vectorizing-width 4 -vectorizing-direction 0 -S < %s | FileCheck %s
+
+; The induction variable of a masked loop stays scalar:
+;
+;   for (int i = get_global_id(0); i < n; i += stride)
+;     out[i] = i;
+;
+; The exit test depends on i, so the loop is a divergent region executed
+; under an active-lane mask. i is the value of the first lane, the other
+; lanes add a fixed offset computed before the loop.
+
+; CHECK-LABEL: define void @strided(
+; CHECK: entry:
+; CHECK: %i.start = extractelement <4 x i32> %{{.*}}, i32 0
+; CHECK: %i.offset = sub <4 x i32>
+; CHECK: cond:
+; CHECK-DAG: %active_mask = phi <4 x i1>
+; CHECK-DAG: %i = phi i32 [ %i.start, %entry ], [ %i.next, %{{.*}} ]
+; CHECK-NOT: phi <4 x i32>
+; CHECK: %i.next = add nsw i32 %i, %stride
+; CHECK-NOT: phi <4 x i32>
+; CHECK: ret void
+
+define void @strided(i32 addrspace(1)* %out, i32 %n, i32 %stride) {
+entry:
+  %call = call i64 @get_global_id(i32 0)
+  %tid = trunc i64 %call to i32
+  br label %cond
+
+cond:
+  %i = phi i32 [ %tid, %entry ], [ %i.next, %body ]
+  %cmp = icmp slt i32 %i, %n
+  br i1 %cmp, label %body, label %exit
+
+body:
+  %idxprom = sext i32 %i to i64
+  %ptr = getelementptr inbounds i32 addrspace(1)* %out, i64 %idxprom
+  store i32 %i, i32 addrspace(1)* %ptr, align 4
+  %i.next = add nsw i32 %i, %stride
+  br label %cond
+
+exit:
+  ret void
+}
+
+declare i64 @get_global_id(i32)
+
+!opencl.kernels = !{!0}
+!0 = metadata !{void (i32 addrspace(1)*, i32, i32)* @strided}
@@ -0,0 +1,73 @@
+; RUN: %opt -tv -vectorizing-width 4 -vectorizing-direction 0 -S < %s | FileCheck %s
+
+; Lanes that left a masked loop still execute its body. A divergent divisor
+; can be zero for them, so the loop is not masked:
+;
+;   for (int i = get_global_id(0); i < n; ++i)
+;     out[i] = 1024 / (n - i);
+
+; CHECK-LABEL: define void @divergent_divisor(
+; CHECK-NOT: active_mask
+; CHECK: ret void
+
+define void @divergent_divisor(i32 addrspace(1)* %out, i32 %n) {
+entry:
+  %call = call i64 @get_global_id(i32 0)
+  %tid = trunc i64 %call to i32
+  br label %cond
+
+cond:
+  %i = phi i32 [ %tid, %entry ], [ %i.next, %body ]
+  %cmp = icmp slt i32 %i, %n
+  br i1 %cmp, label %body, label %exit
+
+body:
+  %left = sub nsw i32 %n, %i
+  %quotient = sdiv i32 1024, %left
+  %idxprom = sext i32 %i to i64
+  %ptr = getelementptr inbounds i32 addrspace(1)* %out, i64 %idxprom
+  store i32 %quotient, i32 addrspace(1)* %ptr, align 4
+  %i.next = add nsw i32 %i, 1
+  br label %cond
+
+exit:
+  ret void
+}
+
+; A uniform divisor is the same for all the lanes, the loop is masked:
+;
+;   for (int i = get_global_id(0); i < n; ++i)
+;     out[i] = i / m;
+
+; CHECK-LABEL: define void @uniform_divisor(
+; CHECK: %active_mask = phi <4 x i1>
+; CHECK: ret void
+
+define void @uniform_divisor(i32 addrspace(1)* %out, i32 %n, i32 %m) {
+entry:
+  %call = call i64 @get_global_id(i32 0)
+  %tid = trunc i64 %call to i32
+  br label %cond
+
+cond:
+  %i = phi i32 [ %tid, %entry ], [ %i.next, %body ]
+  %cmp = icmp slt i32 %i, %n
+  br i1 %cmp, label %body, label %exit
+
+body:
+  %quotient = sdiv i32 %i, %m
+  %idxprom = sext i32 %i to i64
+  %ptr = getelementptr inbounds i32 addrspace(1)* %out, i64 %idxprom
+  store i32 %quotient, i32 addrspace(1)* %ptr, align 4
+  %i.next = add nsw i32 %i, 1
+  br label %cond
+
+exit:
+  ret void
+}
+
+declare i64 @get_global_id(i32)
+
+!opencl.kernels = !{!0, !1}
+!0 = metadata !{void (i32 addrspace(1)*, i32)* @divergent_divisor}
+!1 = metadata !{void (i32 addrspace(1)*, i32, i32)* @uniform_divisor}
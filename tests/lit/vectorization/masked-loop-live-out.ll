@@ -0,0 +1,65 @@
+; RUN: %opt -tv -vectorizing-width 4 -vectorizing-direction 0 -S < %s | FileCheck %s
+
+; Values of a masked loop used after it are frozen lane by lane:
+;
+;   int tid = get_global_id(0);
+;   int i = 0, idx, v;
+;   do {
+;     idx = tid + i;
+;     v = a[idx];
+;     ++i;
+;   } while (v != 0);
+;   out[tid] = v + idx + i * 2;
+;
+; The load is masked, idx is divergent and i is uniform in the loop: all of
+; them take the value of the last iteration of each lane. i * 2 is uniform
+; but is computed on the frozen vector of i.
+
+; CHECK-LABEL: define void @live_out(
+; CHECK: loop:
+; CHECK-DAG: %active_mask = phi <4 x i1> [ <i1 true, i1 true, i1 true, i1 true>, %entry ]
+; CHECK-DAG: %v.frozen = phi <4 x i32> [ undef, %entry ], [ %v.frozen.next,
+; CHECK-DAG: %idx.frozen = phi <4 x i32> [ undef, %entry ], [ %idx.frozen.next,
+; CHECK-DAG: %i.frozen = phi <4 x i32> [ undef, %entry ], [ %i.frozen.next,
+
+; CHECK-DAG: %v.frozen.next = select <4 x i1> %active_mask, <4 x i32> %{{.*}}, <4 x i32> %v.frozen
+; CHECK-DAG: %idx.frozen.next = select <4 x i1> %active_mask, <4 x i32> %{{.*}}, <4 x i32> %idx.frozen
+; CHECK-DAG: %i.frozen.next = select <4 x i1> %active_mask, <4 x i32> %{{.*}}, <4 x i32> %i.frozen
+
+; CHECK: exit:
+; CHECK-NOT: .lcssa
+; CHECK-DAG: = mul <4 x i32> %i.frozen.next,
+; CHECK-DAG: = add <4 x i32> %v.frozen.next, %idx.frozen.next
+; CHECK: store <4 x i32>
+; CHECK: ret void
+
+define void @live_out(i32 addrspace(1)* %a, i32 addrspace(1)* %out) {
+entry:
+  %call = call i64 @get_global_id(i32 0)
+  %tid = trunc i64 %call to i32
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %idx = add nsw i32 %tid, %i
+  %idxprom = sext i32 %idx to i64
+  %ptr = getelementptr inbounds i32 addrspace(1)* %a, i64 %idxprom
+  %v = load i32 addrspace(1)* %ptr, align 4
+  %i.next = add nsw i32 %i, 1
+  %cmp = icmp ne i32 %v, 0
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %y = mul nsw i32 %i, 2
+  %sum1 = add nsw i32 %v, %idx
+  %sum = add nsw i32 %sum1, %y
+  %outidx = sext i32 %tid to i64
+  %outptr = getelementptr inbounds i32 addrspace(1)* %out, i64 %outidx
+  store i32 %sum, i32 addrspace(1)* %outptr, align 4
+  ret void
+}
+
+declare i64 @get_global_id(i32)
+
+!opencl.kernels = !{!0}
+!0 = metadata !{void (i32 addrspace(1)*, i32 addrspace(1)*)* @live_out}
@@ -0,0 +1,88 @@
+; RUN: %opt -tv -vectorizing-width 4 -vectorizing-direction 0 -S < %s | FileCheck %s
+
+; The last steps of a local-memory reduction tree are folded in registers:
+;
+;   int lid = get_local_id(0);
+;   l[lid] = in[get_global_id(0)];
+;   barrier(CLK_LOCAL_MEM_FENCE);
+;   for (int s = get_local_size(0) / 2; s > 0; s >>= 1) {
+;     if (lid < s)
+;       l[lid] += l[lid + s];
+;     barrier(CLK_LOCAL_MEM_FENCE);
+;   }
+;
+; The loop stops once the stride gets below the width, then the first work
+; item reduces the first 4 elements, which hold the whole buffer.
+
+; CHECK-LABEL: define void @reduce(
+; CHECK: cond:
+; CHECK: %tree_stay = icmp uge i32 %s, 4
+; CHECK-NEXT: br i1 %tree_stay, label %{{.*}}, label %exit
+
+; CHECK: exit:
+; CHECK-NEXT: %reduction_base = getelementptr inbounds float addrspace(3)* %l, i64 0
+; CHECK-NEXT: %item_id = call i64 @get_local_id(i32 0)
+; CHECK-NEXT: %is_first_item = icmp eq i64 %item_id, 0
+; CHECK: %reduction_ptr = bitcast float addrspace(3)* %reduction_base to <4 x float> addrspace(3)*
+; CHECK-NEXT: %partials = load <4 x float> addrspace(3)* %reduction_ptr, align 4
+; CHECK-NEXT: %upper = shufflevector <4 x float> %partials, <4 x float> undef, <4 x i32> <i32 2, i32 3, i32 undef, i32 undef>
+; CHECK-NEXT: %reduced = fadd <4 x float> %partials, %upper
+; CHECK-NEXT: %[[UPPER:[a-z0-9]+]] = shufflevector <4 x float> %reduced, <4 x float> undef, <4 x i32> <i32 1, i32 undef, i32 undef, i32 undef>
+; CHECK-NEXT: %[[REDUCED:[a-z0-9]+]] = fadd <4 x float> %reduced, %[[UPPER]]
+; CHECK-NEXT: %total = extractelement <4 x float> %[[REDUCED]], i32 0
+; CHECK-NEXT: store float %total, float addrspace(3)* %reduction_base, align 4
+; CHECK: call void @barrier(i32 1)
+; CHECK-NEXT: ret void
+
+define void @reduce(float addrspace(1)* %in, float addrspace(1)* %out,
+                    float addrspace(3)* %l) {
+entry:
+  %call = call i64 @get_local_id(i32 0)
+  %lid = trunc i64 %call to i32
+  %gid = call i64 @get_global_id(i32 0)
+  %inptr = getelementptr inbounds float addrspace(1)* %in, i64 %gid
+  %value = load float addrspace(1)* %inptr, align 4
+  %lidx = sext i32 %lid to i64
+  %lptr = getelementptr inbounds float addrspace(3)* %l, i64 %lidx
+  store float %value, float addrspace(3)* %lptr, align 4
+  call void @barrier(i32 1)
+  %size = call i64 @get_local_size(i32 0)
+  %size32 = trunc i64 %size to i32
+  %start = lshr i32 %size32, 1
+  br label %cond
+
+cond:
+  %s = phi i32 [ %start, %entry ], [ %s.next, %latch ]
+  %more = icmp sgt i32 %s, 0
+  br i1 %more, label %body, label %exit
+
+body:
+  %active = icmp slt i32 %lid, %s
+  br i1 %active, label %update, label %latch
+
+update:
+  %other = add nsw i32 %lid, %s
+  %otheridx = sext i32 %other to i64
+  %otherptr = getelementptr inbounds float addrspace(3)* %l, i64 %otheridx
+  %b = load float addrspace(3)* %otherptr, align 4
+  %a = load float addrspace(3)* %lptr, align 4
+  %sum = fadd float %a, %b
+  store float %sum, float addrspace(3)* %lptr, align 4
+  br label %latch
+
+latch:
+  call void @barrier(i32 1)
+  %s.next = ashr i32 %s, 1
+  br label %cond
+
+exit:
+  ret void
+}
+
+declare i64 @get_local_id(i32)
+declare i64 @get_global_id(i32)
+declare i64 @get_local_size(i32)
+declare void @barrier(i32)
+
+!opencl.kernels = !{!0}
+!0 = metadata !{void (float addrspace(1)*, float addrspace(1)*, float addrspace(3)*)* @reduce}
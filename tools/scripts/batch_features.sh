@@ -0,0 +1,55 @@
+#! /bin/bash
+
+CLANG=clang
+OPT=opt
+
+LIB_THRUD=$HOME/root/lib/libThrud.so
+THRUD_DIR=$HOME/src/thrud/tools/scripts
+
+TMP_DIR=/tmp/batch_features${RANDOM}
+
+OCLDEF=$THRUD_DIR/opencl_spir.h
+OPTIMIZATION=-O3
+
+if [ $# -lt 4 ]
+then
+  echo "Must specify 1) output CSV table, 2) output columnar table, 3) configuration label and 4) input files"
+  exit 1;
+fi
+
+CSV_TABLE=$1
+COLUMNAR_TABLE=$2
+CONFIGURATION=$3
+shift 3
+
+mkdir -p $TMP_DIR
+
+# Extract the features of all the kernels of each file, appending a row for
+# each kernel to the tables. The module column is the input file, not the
+# temporary one opt reads.
+for INPUT_FILE in "$@"
+do
+  TMP_NAME=$TMP_DIR/$(basename $INPUT_FILE .cl).ll
+  $CLANG -x cl \
+         -target spir \
+         -include $OCLDEF \
+         -O0 \
+         $INPUT_FILE \
+         -S -emit-llvm -fno-builtin -o $TMP_NAME || continue
+
+  $OPT $TMP_NAME \
+       -instnamer \
+       -mem2reg \
+       -inline -inline-threshold=10000 \
+       $OPTIMIZATION \
+       -load $LIB_THRUD -opencl-instcount -count-all-kernels \
+       -feature-table $CSV_TABLE -feature-columns $COLUMNAR_TABLE \
+       -feature-module "$INPUT_FILE" \
+       -feature-configuration "$CONFIGURATION" \
+       -coarsening-direction 0 \
+       -o /dev/null
+  rm -f $TMP_NAME
+done
+
+# Delete tmp files.
+rm -rf $TMP_DIR
@@ -0,0 +1,43 @@
+#! /bin/bash
+
+CLANG=clang
+OPT=opt
+
+LIB_THRUD=$HOME/root/lib/libThrud.so
+THRUD_DIR=$HOME/src/thrud/tools/scripts
+
+OCLDEF=$THRUD_DIR/opencl_spir.h
+OPTIMIZATION=-O3
+TARGET=spir
+
+if [ $# -ne 5 ]
+then
+  echo "Must specify: input file, kernel name, cd, cf, st"
+exit 1;
+fi
+
+INPUT_FILE=$1
+KERNEL_NAME=$2
+COARSENING_DIRECTION=$3
+COARSENING_FACTOR=$4
+COARSENING_STRIDE=$5
+
+# Features of the original and of the coarsened kernel, and their difference,
+# in a single run: no round trip through axtor.
+$CLANG -x cl \
+       -target $TARGET \
+       -include $OCLDEF \
+       -O0 \
+       $INPUT_FILE \
+       -S -emit-llvm -fno-builtin -o - | \
+$OPT -mem2reg \
+     -inline -inline-threshold=10000 \
+     $OPTIMIZATION \
+     -instnamer -load ${LIB_THRUD} \
+     -feature-snapshot -snapshot-kernel-name ${KERNEL_NAME} \
+     -be -tc -kernel-name ${KERNEL_NAME} \
+     -coarsening-factor ${COARSENING_FACTOR} \
+     -coarsening-direction ${COARSENING_DIRECTION} \
+     -coarsening-stride ${COARSENING_STRIDE} \
+     -feature-snapshot \
+     -o /dev/null
@@ -0,0 +1,52 @@
+#! /bin/bash
+
+CLANG=clang
+OPT=opt
+
+LIB_THRUD=$HOME/root/lib/libThrud.so
+THRUD_DIR=$HOME/src/thrud/tools/scripts
+
+OCLDEF=$THRUD_DIR/opencl_spir.h
+TARGET=spir
+
+if [ $# -ne 12 ]
+then
+  echo "Must specify: input file, kernel name, groups x y z, local x y z, cd, cf, st, device profile"
+exit 1;
+fi
+
+inputFile=$1
+kernelName=$2
+numberOfGroupsX=$3
+numberOfGroupsY=$4
+numberOfGroupsZ=$5
+localX=$6
+localY=$7
+localZ=$8
+coarseningDirection=$9
+coarseningFactor=${10}
+coarseningStride=${11}
+deviceProfile=${12}
+
+# Compile kernel.
+$CLANG -x cl \
+       -target $TARGET \
+       -include $OCLDEF \
+       -O0 \
+       $inputFile \
+       -S -emit-llvm -fno-builtin -o - | \
+$OPT -mem2reg \
+     -inline -inline-threshold=10000 \
+     -instnamer -load ${LIB_THRUD} -be -tc \
+     -coarsening-factor ${coarseningFactor} \
+     -coarsening-direction ${coarseningDirection} \
+     -coarsening-stride ${coarseningStride} -o - |
+$OPT -instnamer \
+     -mem2reg \
+     -inline -inline-threshold=100000 \
+     -load $LIB_THRUD -performance-prediction \
+     -prediction-kernel-name ${kernelName} \
+     -device-profile ${deviceProfile} \
+     -localSizeX ${localX} -localSizeY ${localY} -localSizeZ ${localZ} \
+     -numberOfGroupsX ${numberOfGroupsX} -numberOfGroupsY ${numberOfGroupsY} -numberOfGroupsZ ${numberOfGroupsZ} \
+     -o /dev/null
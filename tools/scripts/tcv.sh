@@ -0,0 +1,42 @@
+#! /bin/bash
+
+# Coarsen and then vectorize a kernel.
+# The kernel is first coarsened by COARSENING_FACTOR along COARSENING_DIRECTION
+# and the coarsened kernel is then vectorized by VECTORIZING_WIDTH along
+# VECTORIZING_DIRECTION.
+# When the two directions are the same, a coarsening stride equal to the
+# vectorizing width keeps the lanes of each vector consecutive.
+
+CLANG=clang
+OPT=opt
+LLVM_DIS=llvm-dis
+LIB_THRUD=$HOME/root/lib/libThrud.so
+OCL_DEF=opencl_spir.h
+TARGET=spir
+
+INPUT_FILE=$1
+KERNEL_NAME=$2
+COARSENING_DIRECTION=${3:-0}
+COARSENING_FACTOR=${4:-2}
+VECTORIZING_DIRECTION=${5:-0}
+VECTORIZING_WIDTH=${6:-4}
+COARSENING_STRIDE=${7:-1}
+OPTIMIZATION=-O0
+
+$CLANG -x cl \
+       -target $TARGET \
+       -include $OCL_DEF \
+       ${OPTIMIZATION} \
+       ${INPUT_FILE} \
+       -S -emit-llvm -fno-builtin -o - | \
+$OPT -mem2reg -instnamer \
+     -load $LIB_THRUD -be -tc -be -tv \
+     -kernel-name ${KERNEL_NAME} \
+     -coarsening-factor ${COARSENING_FACTOR} \
+     -coarsening-direction ${COARSENING_DIRECTION} \
+     -coarsening-stride ${COARSENING_STRIDE} \
+     -vectorizing-width ${VECTORIZING_WIDTH} \
+     -vectorizing-direction ${VECTORIZING_DIRECTION} \
+     -div-region-mgt=classic \
+     -o - | \
+${LLVM_DIS} -o -